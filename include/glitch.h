@@ -16,10 +16,22 @@
 #define GLI_EMSCRIPTEN
 #endif
 
+// Where a Window gets its OpenGL context from. Set it in the first ecs_set() of the Window, it can't be changed later.
+typedef enum gli_backend_t {
+  // A regular, visible window.
+  GLI_BACKEND_WINDOW,
+  // No display server needed, renders into an offscreen framebuffer of Window::size. Ignored in Emscripten.
+  GLI_BACKEND_HEADLESS,
+  // No context at all, every OpenGL function is a stub that does nothing but hand out object names and pretend that
+  // shaders compile. Measures the CPU cost of everything around the driver. Ignored in Emscripten.
+  GLI_BACKEND_NULL,
+} gli_backend_t;
+
 #ifdef GLI_LINUX
 #include <X11/Xlib.h>
 #include <GL/gl.h>
 #include <GL/glx.h>
+#include <EGL/egl.h>
 
 typedef GLXContext(*glXCreateContextAttribsARBProc)(
   Display* display,
@@ -28,6 +40,9 @@ typedef GLXContext(*glXCreateContextAttribsARBProc)(
   Bool direct,
   const int* attrib_list
 );
+// From GLX_EXT_swap_control and GLX_MESA_swap_control.
+typedef void (*glXSwapIntervalEXTProc)(Display* display, GLXDrawable drawable, int interval);
+typedef int (*glXSwapIntervalMESAProc)(unsigned interval);
 
 // Huh, X11 already took the Window identifier.
 typedef struct GLitchWindow {
@@ -35,6 +50,13 @@ typedef struct GLitchWindow {
   Display* display;
   Window window;
   Atom wm_delete;
+  // The headless backend uses EGL instead of GLX and X11.
+  EGLDisplay egl_display;
+  EGLContext egl_context;
+  EGLSurface egl_surface;
+  GLuint framebuffer, color_renderbuffer, depth_renderbuffer;
+  vkm_usvec2 framebuffer_size;
+  gli_backend_t backend;
   char* name;
   vkm_usvec2 size;
 } GLitchWindow;
@@ -50,16 +72,24 @@ typedef HGLRC(WINAPI* PFNWGLCREATECONTEXTATTRIBSARBPROC)(
   HGLRC gl_rendering_context_handle,
   const int* attribute_list
 );
+// From WGL_EXT_swap_control.
+typedef BOOL(WINAPI* PFNWGLSWAPINTERVALEXTPROC)(int interval);
 
 typedef struct GLitchWindow {
   HGLRC context;
   HWND window_handle;
   HDC device_context_handle;
+  // The headless backend uses a hidden window.
+  GLuint framebuffer, color_renderbuffer, depth_renderbuffer;
+  vkm_usvec2 framebuffer_size;
+  gli_backend_t backend;
   char* name;
   vkm_usvec2 size;
 } GLitchWindow;
 
 typedef char GLchar;
+typedef uint64_t GLuint64;
+typedef struct __GLsync* GLsync;
 typedef intptr_t GLsizeiptr;
 typedef intptr_t GLintptr;
 
@@ -92,12 +122,44 @@ typedef intptr_t GLintptr;
 #define GL_UNSIGNED_INT_VEC4 0x8DC8
 #define GL_FLOAT_MAT4 0x8B5C
 #define GL_PROGRAM_POINT_SIZE 0x8642
+#define GL_NUM_EXTENSIONS 0x821D
+#define GL_ANY_SAMPLES_PASSED 0x8C2F
+#define GL_QUERY_RESULT 0x8866
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#define GL_QUERY_NO_WAIT 0x8E14
+#define GL_TIME_ELAPSED 0x88BF
+#define GL_TIMESTAMP 0x8E28
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_RENDERBUFFER 0x8D41
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#define GL_DEPTH_COMPONENT24 0x81A6
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#define GL_STREAM_READ 0x88E1
+#define GL_MAP_READ_BIT 0x0001
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_CONDITION_SATISFIED 0x911C
+#define GL_WAIT_FAILED 0x911D
+#define GL_TEXTURE_2D_ARRAY 0x8C1A
+#define GL_SAMPLER_2D_ARRAY 0x8DC1
+#define GL_CLAMP_TO_EDGE 0x812F
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#define GL_TEXTURE_BASE_LEVEL 0x813C
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#define GL_SRGB8_ALPHA8 0x8C43
 #elif defined(GLI_EMSCRIPTEN)
 #include <emscripten/html5.h>
 #include <GLES3/gl3.h>
 
 typedef struct GLitchWindow {
   EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context;
+  gli_backend_t backend;
   char* name;
   vkm_usvec2 size;
 } GLitchWindow;
@@ -110,6 +172,12 @@ typedef struct GLitchWindow {
 #define GLI_COUNTOF(array) (sizeof(array) / sizeof(array[0]))
 #define GLI_MAX_ATTRIBUTES 16
 #define GLI_MAX_UNIFORMS 23
+#define GLI_MAX_LODS 8
+#define GLI_GPU_TIMER_FRAMES 4
+#define GLI_CAPTURE_FRAMES 3
+#define GLI_PACING_FRAMES 32
+#define GLI_ATLAS_PADDING 4
+#define GLI_STREAMING_TAIL_SIZE 64
 
 typedef enum gli_data_type_t {
   GLI_BYTE = 1,
@@ -154,10 +222,18 @@ typedef enum gli_primitive_t {
   GLI_TRIANGLE_FAN   = GL_TRIANGLE_FAN + 1,
 } gli_primitive_t;
 
+// Gives back the memory of a MeshData that doesn't own it, once the component is done with it.
+typedef void (*gli_release_mesh_data_t)(const void* data, const unsigned* indices, void* context);
+
 typedef struct MeshData {
-  // This memory is owned by this component.
-  void* data;
-  unsigned* indices;
+  // This memory is owned by this component and freed with free(), unless there's a release callback. It's only read,
+  // so it can be anywhere, even read-only: static const arrays, memory-mapped files, arenas, etc.
+  const void* data;
+  const unsigned* indices;
+  // Optional, called instead of free() exactly once, when the component is removed or replaced, after MakeMeshes
+  // uploaded the memory. gli_keep_mesh_data does nothing, for memory that outlives the component.
+  gli_release_mesh_data_t release;
+  void* release_context;
   int vertices_count, indices_count;
   gli_primitive_t primitive;
   // Zero-terminated array, with count up to GLI_MAX_ATTRIBUTES.
@@ -166,17 +242,100 @@ typedef struct MeshData {
     int8_t type;
     bool normalize;
   } vertex_attributes[GLI_MAX_ATTRIBUTES];
+  // How many simplified versions of the mesh to generate, each one with about half the triangles of the previous one.
+  // Only for indexed GLI_TRIANGLES whose first attribute is the position, as a GLI_VEC3. Up to GLI_MAX_LODS - 1.
+  int lods_count;
+  // The maximum geometric error the simplified versions can have, relative to the size of the mesh. Simplification
+  // stops earlier if it can't go further within this bound. Zero means 0.1.
+  float lod_max_error;
 } MeshData;
 
 typedef struct Mesh {
   GLuint vertex_buffer, index_buffer, vertex_array;
   gli_primitive_t primitive;
   int vertices_count, indices_count;
+  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+  GLenum index_type;
+  // Bounding box of the first vertex attribute, if it is a GLI_VEC2 or GLI_VEC3.
+  vkm_vec3 bounds_min, bounds_max;
+  // The levels of detail, all of them stored in the index buffer and sharing the vertices. The first one is the full
+  // mesh. The error is the maximum distance the surface of each level may deviate from the full mesh.
+  struct mesh_lod {
+    int first_index, indices_count;
+    float error;
+  } lods[GLI_MAX_LODS];
+  int lods_count;
 } Mesh;
 
+// A mesh that changes after it's made, in place, like terrain regenerated on every frame. Gets a Mesh with buffers as
+// big as the capacities. Change the vertices, the indices or the counts here, marking what changed with
+// gli_update_dynamic_vertices and gli_update_dynamic_indices: before rendering, only those ranges are uploaded, or the
+// buffers are orphaned if all that's drawn changed, so the driver doesn't wait for the GPU to be done with them. What
+// comes into the counts when they grow is uploaded too. Has no levels of detail, and can't be an Occluder.
+typedef struct DynamicMesh {
+  // Owned by this component. The vertices are planar like in MeshData, each attribute taking room for
+  // vertices_capacity vertices.
+  void* data;
+  unsigned* indices;
+  int vertices_capacity, indices_capacity;
+  // What's drawn, up to the capacities. No indices for a mesh that isn't indexed.
+  int vertices_count, indices_count;
+  gli_primitive_t primitive;
+  // Zero-terminated array, with count up to GLI_MAX_ATTRIBUTES.
+  struct attribute vertex_attributes[GLI_MAX_ATTRIBUTES];
+  // What's left to upload, from begin to before end.
+  struct dirty_range {
+    int begin, end;
+  } dirty_vertices, dirty_indices;
+} DynamicMesh;
+
+// A binary glTF (GLB) file to load. The file is memory-mapped, its JSON parsed once and its accessors decoded by worker
+// threads straight into the MeshData of a child entity for each primitive of its meshes. Vertex attributes keep the
+// types of the file and come in this order, skipping those missing: POSITION, NORMAL, TEXCOORD_0, TEXCOORD_1, TANGENT
+// and COLOR_0. Each node of the scene becomes an entity, child of its parent node or of this one, that uses the
+// primitives of its mesh, with Position3D, Rotation3D and Scale3D already composed with those of its parents. Only the
+// buffer embedded in the file is supported. Accessors that are already laid out like MeshData, tightly packed and next
+// to each other, aren't copied at all: the MeshData points into the file, which stays mapped until it's released.
+// Removed once loaded.
+typedef struct ModelFile {
+  // Owned by this component.
+  char* path;
+  // Optional, used by the nodes with a mesh too.
+  ecs_entity_t program;
+} ModelFile;
+
+#define GLI_MESH_FILE_MAGIC 0x48534D47
+#define GLI_MESH_FILE_VERSION 1
+
+// How the files of MeshFile start, in little-endian. The vertices, planar like in MeshData, and the indices, those of
+// every level of detail one after another, follow at the offsets given.
+typedef struct gli_mesh_file_header_t {
+  uint32_t magic, version;
+  // The type is actually gli_primitive_t
+  uint32_t primitive;
+  uint32_t vertices_count, indices_count;
+  // 2 or 4, or 0 if the mesh isn't indexed.
+  uint32_t index_size;
+  struct attribute vertex_attributes[GLI_MAX_ATTRIBUTES];
+  vkm_vec3 bounds_min, bounds_max;
+  struct mesh_lod lods[GLI_MAX_LODS];
+  uint32_t lods_count, padding;
+  uint64_t vertices_offset, vertices_size, indices_offset, indices_size;
+} gli_mesh_file_header_t;
+
+// A mesh file written by gli_cook_mesh, to load without any conversion: the file is memory-mapped and its vertices and
+// indices handed to the driver from there. Replaced by the Mesh once loaded.
+typedef struct MeshFile {
+  // Owned by this component.
+  char* path;
+} MeshFile;
+
 typedef struct ShaderProgramSource {
   // Those buffers are owned by this component.
   char* vertex_shader, *fragment_shader;
+  // Optional files to read the sources from instead, also owned by this component. On Linux, they are watched and the
+  // program is recompiled in place whenever any of them changes.
+  char* vertex_shader_path, *fragment_shader_path;
 } ShaderProgramSource;
 
 typedef struct gli_shader_input_data {
@@ -185,15 +344,110 @@ typedef struct gli_shader_input_data {
   GLenum type;
 } gli_shader_input_data;
 
+// Sets a uniform of the program in use from a value laid out like its component.
+typedef void (*gli_upload_uniform_t)(GLint location, const void* value);
+
+// How a uniform is set from its component, resolved when the program is linked.
+typedef struct gli_uniform_upload_t {
+  gli_upload_uniform_t upload;
+  GLint location;
+  // Bytes of the value.
+  int size;
+} gli_uniform_upload_t;
+
 typedef struct ShaderProgram {
   ecs_query_t* rendered_entities_query;
   gli_shader_input_data* uniforms, *attributes;
   int uniforms_count, attributes_count;
   GLuint program;
+  // A new version of the program that is being compiled in the background. It replaces the current one once it links.
+  GLuint pending_program;
   // The type of this one is actually gli_data_type_t
   uint8_t ecs_uniform_types[GLI_MAX_UNIFORMS];
+  // One for each of the uniforms, those provided by each entity first, then those provided by the program itself.
+  gli_uniform_upload_t uploads[GLI_MAX_UNIFORMS];
+  // The index in uniforms of each upload.
+  uint8_t upload_uniforms[GLI_MAX_UNIFORMS];
+  int entity_uploads_count;
+  // The bytes that the values of the uploads of an entity, and of all the uploads, take together.
+  int entity_values_size, uniform_values_size;
+  // The values last uploaded to the uniforms, packed the same way, to skip the glUniform* calls that change nothing.
+  // Only touched by the thread that executes the commands.
+  uint8_t* uniform_shadow;
 } ShaderProgram;
 
+// An array texture that images are packed into, so that everything showing any of them is drawn without changing
+// textures. Shader programs with (Uses, atlas) read it from their `uniform sampler2DArray`. Images go on shelves,
+// filling a layer before moving on to the next one, with their edges repeated GLI_ATLAS_PADDING pixels around them so
+// that filtering and mipmaps don't mix them up. Set it before its first image is uploaded, it can't be resized later.
+typedef struct TextureAtlas {
+  // Of every layer, in pixels. Zero means 2048x2048.
+  vkm_ivec2 size;
+  // Zero means 1.
+  int layers;
+  GLuint texture;
+  // Where the next image goes: the layer, and the corner and height of the shelf being filled.
+  int layer, shelf_x, shelf_y, shelf_height;
+} TextureAtlas;
+
+// The pixels of an image to pack into the TextureAtlas that it Uses, 8 bits per RGBA channel, with its first row at
+// the lowest v texture coordinate. Replaced by TextureRegion and TextureLayer once uploaded, which entities that are
+// IsA the image inherit. Each image then has a table of its own, so for many entities showing many images, set copies
+// of the two on the entities instead. Images uploaded together share a pixel buffer, and their atlas generates its
+// mipmaps once.
+typedef struct ImageData {
+  // Owned by this component.
+  uint8_t* pixels;
+  vkm_ivec2 size;
+} ImageData;
+
+// Where an image is in its atlas, in texture coordinates: the offset in xy and the size in zw. Map a coordinate from 0
+// to 1 across the image with `entityTextureRegion.xy + uv * entityTextureRegion.zw`.
+typedef vkm_vec4 TextureRegion;
+// The layer of the atlas that an image is in, for the third texture coordinate.
+typedef float TextureLayer;
+
+// A KTX or KTX2 file to load into a TextureAtlas of its own, one layer per layer of the file, with the mip levels that
+// it has. The file is memory-mapped and its levels handed to the driver from there: S3TC, BPTC, ETC2 and EAC blocks as
+// they are when the driver supports them, RGBA8 always. S3TC and ETC2 are decoded to RGBA8 when it doesn't, BPTC
+// can't be, and supercompressed files aren't supported. Replaced by the atlas, a TextureRegion covering a whole layer
+// and TextureLayer 0 once loaded, so that entities IsA the file show its first layer. The atlas is full from the start.
+typedef struct TextureFile {
+  // Owned by this component.
+  char* path;
+} TextureFile;
+
+// As a singleton, streams the mip levels of the textures loaded from a TextureFile afterwards. Each texture wants the
+// level whose texels match the pixels of the entities that are IsA it, measured every frame from their Scale2D and
+// Camera2D::zoom, or from their Scale3D and distance to Camera3D. When everything wanted doesn't fit in the budget,
+// every texture drops the same number of levels until it does. A background thread reads the missing levels from the
+// mapped files, the finer ones are evicted, and GL_TEXTURE_BASE_LEVEL follows the finest level resident. Levels are
+// read on the main thread with Emscripten.
+typedef struct TextureStreaming {
+  // In bytes, for the levels of every streamed texture. Zero means 256 MiB.
+  int64_t budget;
+  // Counts for the last frame: the streamed textures, what their resident levels take, and what the levels that they
+  // want would take without a budget.
+  int textures;
+  int64_t resident_bytes, wanted_bytes;
+  // The levels dropped from every texture to fit in the budget.
+  int bias;
+  // Levels waiting for the background thread, and levels uploaded and evicted in the last frame.
+  int pending_levels, loaded_levels, evicted_levels;
+} TextureStreaming;
+
+typedef struct gli_texture_source_t gli_texture_source_t;
+
+// Added to the entities of a TextureFile loaded while TextureStreaming is there, if the file has levels bigger than
+// GLI_STREAMING_TAIL_SIZE. Levels are numbered from the finest, zero, to the coarsest.
+typedef struct StreamedTexture {
+  // The finest level that the entities showing the texture need, the finest that the budget leaves it, and the finest
+  // resident one. The levels from tail_level on, the first no bigger than GLI_STREAMING_TAIL_SIZE, are never evicted.
+  int wanted_level, target_level, resident_level, tail_level;
+  // The mapped file, owned by this component and shared with the background thread.
+  gli_texture_source_t* source;
+} StreamedTexture;
+
 typedef struct Camera2D {
   vkm_mat4 view, projection;
   float zoom;
@@ -207,17 +461,232 @@ typedef struct Camera3D {
 typedef vkm_vec4 Color;
 typedef Color ClearColor;
 
+// Makes 3D entities render their mesh with the simplest level of detail that looks the same under Camera3D.
+typedef struct LevelOfDetail {
+  // The maximum size on screen, in pixels, that simplification errors are allowed to have.
+  float max_screen_error;
+  // Chosen every frame, zero being the full mesh.
+  uint8_t level;
+} LevelOfDetail;
+
+// As a singleton, enables occlusion culling on the GPU: the bounding boxes of 3D entities are tested against the depth
+// buffer after rendering, and entities found hidden are skipped on the next frames. Results arrive at least a frame
+// late, so entities coming into view may show up a frame late too.
+typedef struct OcclusionCulling {
+  // Counts for the last frame.
+  int tested, culled;
+} OcclusionCulling;
+
+// Added by OcclusionCulling to the 3D entities it tests.
+typedef struct OcclusionQuery {
+  GLuint query;
+  // Whether the query is still waiting for its result, and what the last result was.
+  bool pending, visible;
+} OcclusionQuery;
+
+// A copy of the geometry of Occluder meshes kept around for the CPU, owned by this component.
+typedef struct OccluderGeometry {
+  vkm_vec3* positions;
+  // If NULL, the vertices are drawn in order.
+  unsigned* indices;
+  int vertices_count, indices_count;
+} OccluderGeometry;
+
+// As a singleton, enables occlusion culling on the CPU. Every frame, the entities using Occluder meshes are rasterized
+// into a small depth buffer, split in bands among the worker threads of the world if it has any, and the bounding boxes
+// of 3D entities are tested against it before drawing them. Unlike OcclusionCulling, results are never late.
+typedef struct SoftwareOcclusion {
+  // Width of the depth buffer; its height follows the aspect ratio of the window. Zero means 256.
+  int width;
+  // Counts for the last frame.
+  int occluder_triangles, tested, culled;
+} SoftwareOcclusion;
+
+// As a singleton, enables measuring how long the GPU takes to do its work. Results are read back GLI_GPU_TIMER_FRAMES
+// frames late, so that the CPU never waits for them. Not available with Emscripten.
+typedef struct GpuFrameTime {
+  // In milliseconds. The frame spans from the clear to the swap.
+  float clear, frame;
+  // A ring of queries, one slot per frame in flight.
+  GLuint clear_queries[GLI_GPU_TIMER_FRAMES], start_queries[GLI_GPU_TIMER_FRAMES], end_queries[GLI_GPU_TIMER_FRAMES];
+} GpuFrameTime;
+
+// Added by GpuFrameTime to shader programs, with the time taken by the GPU to draw everything with them.
+typedef struct GpuTime {
+  float milliseconds;
+  GLuint queries[GLI_GPU_TIMER_FRAMES];
+} GpuTime;
+
+// As a singleton, gets the counts of the work done to render the last frame.
+typedef struct RenderStats {
+  int draw_calls, instances, triangles, vertices;
+  int program_binds, vertex_array_binds, buffer_binds;
+  // Textures and uniform values recorded. The executor skips the textures bound already and the values that a program
+  // has already, so CommandStream tells how many calls were made.
+  int texture_binds, uniform_values;
+  // Tables of entities iterated by Render.
+  int tables;
+  int64_t uploaded_bytes;
+} RenderStats;
+
+// Added by RenderStats to shader programs, with the counts of the work done with each of them alone.
+typedef RenderStats ShaderProgramStats;
+
+// As a singleton, gets what the OpenGL stubs of GLI_BACKEND_NULL were asked to do in the last frame, the last one that
+// the render thread executed with a RenderThread.
+typedef struct NullBackendStats {
+  int calls, draw_calls;
+  // Names handed out by the glGen* and glCreate* stubs.
+  int objects;
+} NullBackendStats;
+
+typedef enum gli_capture_format_t {
+  // 4 bytes per pixel.
+  GLI_CAPTURE_RGBA,
+  // Planar BT.601 with limited range: Y at full resolution, then U and V at half of it in both axes, rounded up.
+  GLI_CAPTURE_YUV420,
+} gli_capture_format_t;
+
+typedef struct FrameCapture FrameCapture;
+// Gets every captured frame, from the main thread. The pixels are only valid until the next frame is delivered.
+typedef void (*gli_frame_captured_t)(ecs_world_t* world, const FrameCapture* capture, void* context);
+
+// As a singleton, reads back every frame through a ring of pixel buffers and delivers it GLI_CAPTURE_FRAMES frames
+// later, once the GPU is surely done with it. Converting to the format is split among the worker threads of the world
+// if it has any. Not available with Emscripten.
+struct FrameCapture {
+  gli_capture_format_t format;
+  // Optional. Without it, just check the pixels here.
+  gli_frame_captured_t callback;
+  void* callback_context;
+
+  // The last delivered frame, rows from top to bottom, owned by this component.
+  uint8_t* pixels;
+  size_t size;
+  vkm_usvec2 frame_size;
+  // Number of the delivered frame, counting from when the capture began.
+  int64_t frame;
+  // Times that a frame wasn't ready after GLI_CAPTURE_FRAMES frames and had to be waited for.
+  int stalls;
+
+  // The ring, one slot per frame in flight.
+  GLuint buffers[GLI_CAPTURE_FRAMES];
+  GLsync fences[GLI_CAPTURE_FRAMES];
+  vkm_usvec2 sizes[GLI_CAPTURE_FRAMES];
+  int64_t issued;
+};
+
+// As a singleton, draws frames only when something changed since the last one: a window event, a made mesh or shader
+// program, or a change detected by flecs in ClearColor, the cameras or the components that programs render with. Make
+// those with ecs_set, ecs_modified or [inout] terms before EcsPreStore. Otherwise, the frame is skipped and the thread
+// blocks until a window event arrives, or for max_wait milliseconds if there's no window to wait on.
+typedef struct RenderOnDemand {
+  // Zero means waiting for window events with no limit, and 16 milliseconds without a window.
+  int max_wait;
+  // Set to draw the next frame anyway.
+  bool redraw;
+  int64_t drawn, skipped;
+} RenderOnDemand;
+
+// As a singleton, paces the frames. The swap interval of the window is set, and with a target_fps, each frame sleeps
+// until an absolute deadline, as late as the cost of recent frames allows, so that the simulation reads input as late
+// as possible. Use it instead of the target_fps of ecs_app_run, which sleeps coarsely. Not available with Emscripten.
+typedef struct FramePacing {
+  // Zero doesn't sleep, leaving the pace to the swap interval.
+  float target_fps;
+  // Refreshes waited for by each swap: zero disables vsync, -1 is adaptive vsync if GLX_EXT_swap_control_tear or
+  // WGL_EXT_swap_control_tear are there.
+  int swap_interval;
+  // Waits for the GPU after every swap, so that the driver doesn't queue frames up. Lowers latency and throughput.
+  bool finish;
+
+  // In milliseconds, squared for the variance: the predicted cost of the next frame, and the mean and variance of the
+  // time between recent frames.
+  float predicted_cost, frame_time, frame_time_variance;
+  // Frames done after their deadline.
+  int64_t missed;
+
+  // The history, in nanoseconds: what frames cost to simulate and render, without the swap, and the time between them.
+  int64_t costs[GLI_PACING_FRAMES], frame_times[GLI_PACING_FRAMES];
+  int64_t frames, frame_start, last_frame_end, deadline;
+} FramePacing;
+
+// As a singleton, moves drawing to its own thread. The commands that Render records are handed to the render thread
+// along with the OpenGL context at the end of the frame, so the next one is simulated while this one is drawn. The main
+// thread takes the context back, waiting for the drawing to finish, only when it makes meshes or compiles programs.
+// OcclusionCulling, GpuFrameTime, GpuTime, FrameCapture and FramePacing::finish are ignored meanwhile. Not available
+// with Emscripten.
+typedef struct RenderThread {
+  // In milliseconds, for the last frame: how long the main thread waited for the render thread, and how long the
+  // render thread took to draw.
+  float wait, draw;
+} RenderThread;
+
+// As a singleton, reports the commands that Render recorded for the last frame, and executes them `replays` more times
+// to profile the OpenGL calls apart from the queries that produced them. Replays are ignored with a RenderThread.
+typedef struct CommandStream {
+  int replays;
+  int64_t commands, bytes;
+  // In milliseconds, on the CPU, for one execution of the commands.
+  float execute;
+  // For one execution too: the glUniform* calls made, and those skipped because the uniform had the value already.
+  int uniform_calls, skipped_uniform_calls;
+  // The glBindTexture calls made, once for each change of atlas between programs.
+  int texture_binds;
+} CommandStream;
+
 extern ECS_COMPONENT_DECLARE(Window);
 extern ECS_COMPONENT_DECLARE(MeshData);
 extern ECS_COMPONENT_DECLARE(Mesh);
+extern ECS_COMPONENT_DECLARE(ModelFile);
+extern ECS_COMPONENT_DECLARE(MeshFile);
+extern ECS_COMPONENT_DECLARE(DynamicMesh);
 extern ECS_COMPONENT_DECLARE(ShaderProgramSource);
 extern ECS_COMPONENT_DECLARE(ShaderProgram);
+extern ECS_COMPONENT_DECLARE(TextureAtlas);
+extern ECS_COMPONENT_DECLARE(ImageData);
+extern ECS_COMPONENT_DECLARE(TextureRegion);
+extern ECS_COMPONENT_DECLARE(TextureLayer);
+extern ECS_COMPONENT_DECLARE(TextureFile);
+extern ECS_COMPONENT_DECLARE(TextureStreaming);
+extern ECS_COMPONENT_DECLARE(StreamedTexture);
 extern ECS_COMPONENT_DECLARE(Camera2D);
 extern ECS_COMPONENT_DECLARE(Camera3D);
 extern ECS_COMPONENT_DECLARE(Color);
 extern ECS_COMPONENT_DECLARE(ClearColor);
+extern ECS_COMPONENT_DECLARE(LevelOfDetail);
+extern ECS_COMPONENT_DECLARE(OcclusionCulling);
+extern ECS_COMPONENT_DECLARE(OcclusionQuery);
+extern ECS_COMPONENT_DECLARE(OccluderGeometry);
+extern ECS_COMPONENT_DECLARE(SoftwareOcclusion);
+extern ECS_COMPONENT_DECLARE(GpuFrameTime);
+extern ECS_COMPONENT_DECLARE(GpuTime);
+extern ECS_COMPONENT_DECLARE(RenderStats);
+extern ECS_COMPONENT_DECLARE(ShaderProgramStats);
+extern ECS_COMPONENT_DECLARE(NullBackendStats);
+extern ECS_COMPONENT_DECLARE(FrameCapture);
+extern ECS_COMPONENT_DECLARE(RenderOnDemand);
+extern ECS_COMPONENT_DECLARE(FramePacing);
+extern ECS_COMPONENT_DECLARE(RenderThread);
+extern ECS_COMPONENT_DECLARE(CommandStream);
 
 extern ECS_TAG_DECLARE(Uses);
+// Marks meshes whose entities hide what's behind them, for SoftwareOcclusion. Only GLI_TRIANGLES meshes whose first
+// attribute is a GLI_VEC3 position can be occluders. They should be few, simple, closed and not bigger than what they
+// stand for: a box fitting inside a building, say.
+extern ECS_TAG_DECLARE(Occluder);
 
 void glitchImport(ecs_world_t* world);
+
+// A release callback for MeshData that does nothing, to borrow memory that outlives the component.
+void gli_keep_mesh_data(const void* data, const unsigned* indices, void* context);
+
+// Writes a mesh file for MeshFile, with what MakeMeshes would upload from the mesh data: the same vertices, the levels
+// of detail that it asks for, and the bounds. Indices take 16 bits when they fit. Returns whether it succeeded.
+bool gli_cook_mesh(const MeshData* mesh_data, const char* path);
+
+// Marks count vertices of a DynamicMesh from first, in every attribute, to be uploaded before the next frame.
+void gli_update_dynamic_vertices(DynamicMesh* mesh, int first, int count);
+// Marks count indices of a DynamicMesh from first to be uploaded before the next frame.
+void gli_update_dynamic_indices(DynamicMesh* mesh, int first, int count);
 #endif
@@ -75797,7 +75797,9 @@ bool flecs_query_trivial_search_init(
         ecs_assert(t != query->term_count, ECS_INTERNAL_ERROR, NULL);
         op_ctx->start_from = t;
 
-        ecs_id_record_t *idr = flecs_id_record_get(ctx->world, query->ids[t]);
+        /* Terms are indexed by term, ids by field (they differ after an Or) */
+        ecs_id_t id = term_set ? query->terms[t].id : query->ids[t];
+        ecs_id_record_t *idr = flecs_id_record_get(ctx->world, id);
         if (!idr) {
             return false;
         }
@@ -75878,7 +75880,7 @@ bool flecs_query_trivial_search(
             ctx->vars[0].range.table = table;
             ctx->vars[0].range.count = 0;
             ctx->vars[0].range.offset = 0;
-            it->trs[op_ctx->start_from] = tr;
+            it->trs[terms[op_ctx->start_from].field_index] = tr;
             break;
         }
     } while (true);
@@ -0,0 +1,1318 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CVKM_NO
+#define CVKM_ENABLE_FLECS
+#define CVKM_FLECS_IMPLEMENTATION
+#include <cvkm.h>
+#include <flecs.h>
+#include <glitch.h>
+
+// Renders generated scenes for a fixed number of frames and prints, as JSON, how long each frame and each system of
+// the glitch module took on the CPU. Runs fine under Xvfb with Mesa's llvmpipe, so it can track regressions on build
+// machines without a GPU.
+
+typedef enum bench_scene_t {
+  // Many entities spread over many meshes and shader programs, some of them moving.
+  BENCH_STRESS,
+  // A dense city seen from street level, for occlusion culling.
+  BENCH_CITY,
+  // Many small images packed into an atlas, drawn as sprites by many shader programs.
+  BENCH_SPRITES,
+  // Sprites of textures loaded from files, with the camera zooming in and out so that their levels are streamed.
+  BENCH_STREAMING,
+  // A heightmap rewritten in place on every frame, all of it or a band of its rows, as a DynamicMesh.
+  BENCH_TERRAIN,
+} bench_scene_t;
+
+typedef struct bench_params_t {
+  bench_scene_t scene;
+  int frames, warmup_frames, threads, width, height;
+  // Stress scene.
+  int entities, meshes, programs;
+  // Per-entity uniforms of the programs, entityColor being the first one.
+  int uniforms;
+  // Distinct values that the uniforms take, zero for random ones on every entity.
+  int colors;
+  float fraction_3d, fraction_moving;
+  // City scene.
+  int grid_size, props_per_block;
+  // Sprites scene, along with entities, programs and fraction_moving.
+  int images;
+  // Streaming scene, along with entities: the texture files, and the budget in MiB.
+  int textures, stream_budget;
+  // Terrain scene: the vertices along each side, and the rows of them rewritten on every frame, zero for all.
+  int terrain_size, dirty_rows;
+  bool software_occlusion, occlusion_culling, on_demand, render_thread;
+  // Cook the meshes into files, then load them from there with MeshFile.
+  bool mesh_files;
+  gli_backend_t backend;
+  // Negative for no capture.
+  int capture_format;
+  // Zero for no FramePacing.
+  float target_fps;
+  // Extra executions of each frame's commands.
+  int replays;
+  const char* output;
+} bench_params_t;
+
+#define STRESS_HALF_WIDTH 600.0f
+#define STRESS_HALF_HEIGHT 330.0f
+#define STRESS_NEAR -10.0f
+#define STRESS_FAR -60.0f
+
+#define STREAMING_TEXTURE_SIZE 512
+
+#define BLOCK_SIZE 10.0f
+#define STREET_WIDTH 4.0f
+
+static float random_float(const float min, const float max) {
+  return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+// Keeps moving entities inside the area the camera sees.
+static float wrap(const float value, const float min, const float max) {
+  return value < min ? value + (max - min) : value > max ? value - (max - min) : value;
+}
+
+static void Move2D(ecs_iter_t* it) {
+  Position2D* positions = ecs_field(it, Position2D, 0);
+  const Velocity2D* velocities = ecs_field(it, Velocity2D, 1);
+
+  for (int i = 0; i < it->count; i++) {
+    positions[i].x = wrap(positions[i].x + velocities[i].x * it->delta_time, -STRESS_HALF_WIDTH, STRESS_HALF_WIDTH);
+    positions[i].y = wrap(positions[i].y + velocities[i].y * it->delta_time, -STRESS_HALF_HEIGHT, STRESS_HALF_HEIGHT);
+  }
+}
+
+static void Move3D(ecs_iter_t* it) {
+  Position3D* positions = ecs_field(it, Position3D, 0);
+  const Velocity3D* velocities = ecs_field(it, Velocity3D, 1);
+
+  for (int i = 0; i < it->count; i++) {
+    const float extent = -positions[i].z * 0.5f;
+    positions[i].x = wrap(positions[i].x + velocities[i].x * it->delta_time, -extent, extent);
+    positions[i].y = wrap(positions[i].y + velocities[i].y * it->delta_time, -extent, extent);
+    positions[i].z = wrap(positions[i].z + velocities[i].z * it->delta_time, STRESS_FAR, STRESS_NEAR);
+  }
+}
+
+// Set from bench_params_t::mesh_files, along with the count of the files written by make_mesh.
+static bool cook_meshes;
+static int cooked_meshes_count;
+
+static void mesh_file_path(char* path, const size_t size, const int mesh) {
+  snprintf(path, size, "glitch_bench_%d.mesh", mesh);
+}
+
+static ecs_entity_t make_mesh(
+  ecs_world_t* world,
+  void* data,
+  unsigned* indices,
+  const int vertices_count,
+  const int indices_count,
+  const gli_data_type_t position_type,
+  const bool occluder
+) {
+  MeshData mesh_data = {
+    .data = data,
+    .indices = indices,
+    .vertices_count = vertices_count,
+    .indices_count = indices_count,
+    .primitive = GLI_TRIANGLES,
+    .vertex_attributes = {
+      { .type = (int8_t)position_type },
+    },
+  };
+  ecs_entity_t mesh;
+  if (cook_meshes) {
+    char path[64];
+    mesh_file_path(path, sizeof(path), cooked_meshes_count++);
+    gli_cook_mesh(&mesh_data, path);
+    free(data);
+    free(indices);
+    mesh = ecs_entity(world, {
+      .set = ecs_values({ .type = ecs_id(MeshFile), .ptr = &(MeshFile){ .path = strdup(path) } }),
+    });
+  } else {
+    mesh = ecs_entity(world, {
+      .set = ecs_values({ .type = ecs_id(MeshData), .ptr = &mesh_data }),
+    });
+  }
+  if (occluder) {
+    ecs_add(world, mesh, Occluder);
+  }
+  return mesh;
+}
+
+static ecs_entity_t make_box_mesh(ecs_world_t* world, const bool occluder) {
+  static const float vertices[] = {
+    -0.5f, -0.5f, -0.5f,
+     0.5f, -0.5f, -0.5f,
+    -0.5f,  0.5f, -0.5f,
+     0.5f,  0.5f, -0.5f,
+    -0.5f, -0.5f,  0.5f,
+     0.5f, -0.5f,  0.5f,
+    -0.5f,  0.5f,  0.5f,
+     0.5f,  0.5f,  0.5f,
+  };
+  static const unsigned indices[] = {
+    0, 2, 1, 1, 2, 3,
+    4, 5, 6, 6, 5, 7,
+    0, 4, 2, 2, 4, 6,
+    1, 3, 5, 5, 3, 7,
+    0, 1, 4, 4, 1, 5,
+    2, 6, 3, 3, 6, 7,
+  };
+  void* vertices_buffer = malloc(sizeof(vertices));
+  memcpy(vertices_buffer, vertices, sizeof(vertices));
+  unsigned* indices_buffer = malloc(sizeof(indices));
+  memcpy(indices_buffer, indices, sizeof(indices));
+
+  return make_mesh(world, vertices_buffer, indices_buffer, 8, 36, GLI_VEC3, occluder);
+}
+
+// A regular polygon of the given radius, as a fan of triangles around its center.
+static ecs_entity_t make_polygon_mesh(ecs_world_t* world, const int sides, const float radius) {
+  vkm_vec2* vertices = malloc((sides + 1) * sizeof(vkm_vec2));
+  unsigned* indices = malloc(sides * 3 * sizeof(unsigned));
+  vertices[0] = (vkm_vec2){ { 0.0f, 0.0f } };
+  for (int i = 0; i < sides; i++) {
+    const float angle = (float)i / (float)sides * 2.0f * CVKM_PI_F;
+    vertices[i + 1] = (vkm_vec2){ { vkm_cos(angle) * radius, vkm_sin(angle) * radius } };
+    indices[i * 3] = 0;
+    indices[i * 3 + 1] = i + 1;
+    indices[i * 3 + 2] = (i + 1) % sides + 1;
+  }
+
+  return make_mesh(world, vertices, indices, sides + 1, sides * 3, GLI_VEC2, false);
+}
+
+// A unit sphere made of rings and segments.
+static ecs_entity_t make_sphere_mesh(ecs_world_t* world, const int rings, const int segments) {
+  const int vertices_count = (rings + 1) * (segments + 1);
+  const int indices_count = rings * segments * 6;
+  vkm_vec3* vertices = malloc(vertices_count * sizeof(vkm_vec3));
+  unsigned* indices = malloc(indices_count * sizeof(unsigned));
+
+  for (int i = 0; i <= rings; i++) {
+    const float theta = (float)i / (float)rings * CVKM_PI_F;
+    for (int j = 0; j <= segments; j++) {
+      const float phi = (float)j / (float)segments * 2.0f * CVKM_PI_F;
+      vertices[i * (segments + 1) + j] = (vkm_vec3){ {
+        vkm_sin(theta) * vkm_cos(phi),
+        vkm_cos(theta),
+        -vkm_sin(theta) * vkm_sin(phi),
+      } };
+    }
+  }
+
+  unsigned* index = indices;
+  for (int i = 0; i < rings; i++) {
+    for (int j = 0; j < segments; j++) {
+      const unsigned a = i * (segments + 1) + j, b = a + segments + 1;
+      *index++ = a;
+      *index++ = b;
+      *index++ = a + 1;
+      *index++ = a + 1;
+      *index++ = b;
+      *index++ = b + 1;
+    }
+  }
+
+  return make_mesh(world, vertices, indices, vertices_count, indices_count, GLI_VEC3, false);
+}
+
+// Float components for the uniforms that come after entityColor, to time programs with more of them.
+static ecs_entity_t extra_uniforms[GLI_MAX_UNIFORMS];
+
+static void make_extra_uniforms(ecs_world_t* world, const int count) {
+  for (int i = 0; i < count; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "BenchUniform%d", i);
+    extra_uniforms[i] = ecs_primitive(world, {
+      .entity = ecs_entity(world, { .name = name, .symbol = name }),
+      .kind = EcsF32,
+    });
+  }
+}
+
+// Every program is a bit different so that the driver can't share them.
+static ecs_entity_t make_program(ecs_world_t* world, const bool is_3d, const int variant, const int extra_count) {
+  char vertex_shader[512], fragment_shader[4096], name[64];
+  // Each extra uniform is declared and added in, so that the compiler keeps it.
+  char declarations[2048] = "", sum[1024] = "0.0";
+  for (int i = 0; i < extra_count; i++) {
+    const size_t declarations_length = strlen(declarations), sum_length = strlen(sum);
+    snprintf(
+      declarations + declarations_length,
+      sizeof(declarations) - declarations_length,
+      "uniform float entityBenchUniform%d;\n",
+      i
+    );
+    snprintf(sum + sum_length, sizeof(sum) - sum_length, " + entityBenchUniform%d", i);
+  }
+  snprintf(
+    vertex_shader,
+    sizeof(vertex_shader),
+    "layout(location = 0) in %s position;\n"
+    "\n"
+    "void main() {\n"
+    "  gl_Position = projection * view * model * vec4(position%s, 1.0);\n"
+    "}\n",
+    is_3d ? "vec3" : "vec2",
+    is_3d ? "" : ", 0.0"
+  );
+  snprintf(
+    fragment_shader,
+    sizeof(fragment_shader),
+    "out vec4 fragment_color;\n"
+    "\n"
+    "uniform vec4 entityColor;\n"
+    "%s"
+    "\n"
+    "void main() {\n"
+    "  fragment_color = entityColor * %f + vec4(%s) * 0.001;\n"
+    "}\n",
+    declarations,
+    1.0 - variant * 0.01,
+    sum
+  );
+  snprintf(name, sizeof(name), "Bench program %s %d", is_3d ? "3D" : "2D", variant);
+
+  return ecs_entity(world, {
+    .name = name,
+    .set = ecs_values(
+      {
+        .type = ecs_id(ShaderProgramSource),
+        .ptr = &(ShaderProgramSource) {
+          .vertex_shader = strdup(vertex_shader),
+          .fragment_shader = strdup(fragment_shader),
+        },
+      }
+    ),
+  });
+}
+
+// Samples its image from the atlas, tinted a bit differently by every program.
+static ecs_entity_t make_sprite_program(ecs_world_t* world, const ecs_entity_t atlas, const int variant) {
+  static const char* vertex_shader =
+    "layout(location = 0) in vec2 position;\n"
+    "\n"
+    "out vec2 uv;\n"
+    "\n"
+    "void main() {\n"
+    "  uv = position + 0.5;\n"
+    "  gl_Position = projection * view * model * vec4(position, 0.0, 1.0);\n"
+    "}\n";
+  char fragment_shader[1024], name[64];
+  snprintf(
+    fragment_shader,
+    sizeof(fragment_shader),
+    "in vec2 uv;\n"
+    "out vec4 fragment_color;\n"
+    "\n"
+    "uniform sampler2DArray atlas;\n"
+    "uniform vec4 entityTextureRegion;\n"
+    "uniform float entityTextureLayer;\n"
+    "\n"
+    "void main() {\n"
+    "  vec3 coordinates = vec3(entityTextureRegion.xy + uv * entityTextureRegion.zw, entityTextureLayer);\n"
+    "  fragment_color = texture(atlas, coordinates) * %f;\n"
+    "}\n",
+    1.0 - variant * 0.01
+  );
+  snprintf(name, sizeof(name), "Bench sprite program %d", variant);
+
+  return ecs_entity(world, {
+    .name = name,
+    .add = ecs_ids(ecs_pair(ecs_id(Uses), atlas)),
+    .set = ecs_values(
+      {
+        .type = ecs_id(ShaderProgramSource),
+        .ptr = &(ShaderProgramSource) {
+          .vertex_shader = strdup(vertex_shader),
+          .fragment_shader = strdup(fragment_shader),
+        },
+      }
+    ),
+  });
+}
+
+// How many of count go to a fraction, leaving at least one on each side.
+static int split(const int count, const float fraction) {
+  return vkm_maxi(1, vkm_mini(count - 1, (int)((float)count * fraction + 0.5f)));
+}
+
+static void make_stress_scene(ecs_world_t* world, const bench_params_t* params) {
+  // Split meshes and programs between dimensions, with at least one of each for a dimension in use.
+  const bool has_2d = params->fraction_3d < 1.0f, has_3d = params->fraction_3d > 0.0f;
+  const int meshes_3d = !has_3d ? 0 : !has_2d ? params->meshes : split(params->meshes, params->fraction_3d);
+  const int programs_3d = !has_3d ? 0 : !has_2d ? params->programs : split(params->programs, params->fraction_3d);
+
+  ecs_entity_t* meshes = malloc(params->meshes * sizeof(ecs_entity_t));
+  for (int i = 0; i < params->meshes; i++) {
+    meshes[i] = i < meshes_3d
+      ? make_sphere_mesh(world, 4 + i % 16 * 2, 8 + i % 16 * 4)
+      : make_polygon_mesh(world, 3 + i % 29, 10.0f);
+  }
+
+  ecs_entity_t* programs = malloc(params->programs * sizeof(ecs_entity_t));
+  for (int i = 0; i < params->programs; i++) {
+    programs[i] = make_program(world, i < programs_3d, i, params->uniforms - 1);
+  }
+
+  Color* palette = malloc(params->colors * sizeof(Color));
+  for (int i = 0; i < params->colors; i++) {
+    palette[i] = (Color){ { random_float(0.2f, 1.0f), random_float(0.2f, 1.0f), random_float(0.2f, 1.0f), 1.0f } };
+  }
+
+  for (int i = 0; i < params->entities; i++) {
+    const bool is_3d = random_float(0.0f, 1.0f) < params->fraction_3d;
+    const ecs_entity_t mesh = is_3d
+      ? meshes[rand() % meshes_3d]
+      : meshes[meshes_3d + rand() % (params->meshes - meshes_3d)];
+    const ecs_entity_t program = is_3d
+      ? programs[rand() % programs_3d]
+      : programs[programs_3d + rand() % (params->programs - programs_3d)];
+    const int color = params->colors ? rand() % params->colors : -1;
+    const ecs_entity_t entity = ecs_entity(world, {
+      .add = ecs_ids(ecs_pair(ecs_id(Uses), mesh), ecs_pair(ecs_id(Uses), program)),
+      .set = ecs_values(
+        {
+          .type = ecs_id(Color),
+          .ptr = color >= 0
+            ? palette + color
+            : &(Color){ { random_float(0.2f, 1.0f), random_float(0.2f, 1.0f), random_float(0.2f, 1.0f), 1.0f } },
+        }
+      ),
+    });
+
+    for (int j = 0; j < params->uniforms - 1; j++) {
+      const float value = color >= 0 ? (float)color / (float)params->colors : random_float(0.0f, 1.0f);
+      ecs_set_id(world, entity, extra_uniforms[j], sizeof(float), &value);
+    }
+
+    const bool moving = random_float(0.0f, 1.0f) < params->fraction_moving;
+    if (is_3d) {
+      const float z = random_float(STRESS_FAR, STRESS_NEAR);
+      ecs_set(world, entity, Position3D, { { random_float(z, -z) * 0.5f, random_float(z, -z) * 0.5f, z } });
+      if (moving) {
+        ecs_set(world, entity, Velocity3D, {
+          { random_float(-5.0f, 5.0f), random_float(-5.0f, 5.0f), random_float(-5.0f, 5.0f) }
+        });
+      }
+    } else {
+      ecs_set(world, entity, Position2D, {
+        { random_float(-STRESS_HALF_WIDTH, STRESS_HALF_WIDTH), random_float(-STRESS_HALF_HEIGHT, STRESS_HALF_HEIGHT) }
+      });
+      if (moving) {
+        ecs_set(world, entity, Velocity2D, { { random_float(-100.0f, 100.0f), random_float(-100.0f, 100.0f) } });
+      }
+    }
+  }
+
+  free(meshes);
+  free(programs);
+  free(palette);
+}
+
+// Every entity of the stress scene uses one program and has all that it reads, so each program must match exactly the
+// entities that use it. Programs with two or more uniforms of their own once matched those of the other programs too.
+static bool check_stress_programs(const ecs_world_t* world) {
+  bool matched = true;
+  ecs_iter_t it = ecs_each(world, ShaderProgram);
+  while (ecs_each_next(&it)) {
+    const ShaderProgram* shader_programs = ecs_field(&it, ShaderProgram, 0);
+    for (int i = 0; i < it.count; i++) {
+      const int32_t expected = ecs_count_id(world, ecs_pair(ecs_id(Uses), it.entities[i]));
+      const int32_t entities = ecs_query_count(shader_programs[i].rendered_entities_query).entities;
+      if (entities != expected) {
+        fprintf(
+          stderr,
+          "Program %s matches %d entities instead of %d.\n",
+          ecs_get_name(world, it.entities[i]),
+          entities,
+          expected
+        );
+        matched = false;
+      }
+    }
+  }
+  return matched;
+}
+
+// A unit square for sprites to scale.
+static ecs_entity_t make_quad(ecs_world_t* world) {
+  static const vkm_vec2 quad_vertices[] = {
+    { { -0.5f, -0.5f } },
+    { {  0.5f, -0.5f } },
+    { { -0.5f,  0.5f } },
+    { {  0.5f,  0.5f } },
+  };
+  static const unsigned quad_indices[] = { 0, 1, 2, 2, 1, 3 };
+  void* vertices = malloc(sizeof(quad_vertices));
+  memcpy(vertices, quad_vertices, sizeof(quad_vertices));
+  unsigned* indices = malloc(sizeof(quad_indices));
+  memcpy(indices, quad_indices, sizeof(quad_indices));
+  return make_mesh(world, vertices, indices, 4, 6, GLI_VEC2, false);
+}
+
+static void make_sprites_scene(ecs_world_t* world, const bench_params_t* params) {
+  const ecs_entity_t atlas = ecs_entity(world, {
+    .name = "Bench atlas",
+    .set = ecs_values(
+      { .type = ecs_id(TextureAtlas), .ptr = &(TextureAtlas){ .size = { { 1024, 1024 } }, .layers = 16 } }
+    ),
+  });
+
+  // Gradients of random colors and sizes.
+  ecs_entity_t* images = malloc(params->images * sizeof(ecs_entity_t));
+  vkm_ivec2* sizes = malloc(params->images * sizeof(vkm_ivec2));
+  for (int i = 0; i < params->images; i++) {
+    sizes[i] = (vkm_ivec2){ { 8 + rand() % 57, 8 + rand() % 57 } };
+    const float color[3] = { random_float(0.2f, 1.0f), random_float(0.2f, 1.0f), random_float(0.2f, 1.0f) };
+    uint8_t* pixels = malloc((size_t)sizes[i].x * sizes[i].y * 4);
+    for (int y = 0; y < sizes[i].y; y++) {
+      for (int x = 0; x < sizes[i].x; x++) {
+        uint8_t* pixel = pixels + ((size_t)y * sizes[i].x + x) * 4;
+        const float shade = 0.5f + 0.5f * (float)(x + y) / (float)(sizes[i].x + sizes[i].y);
+        for (int j = 0; j < 3; j++) {
+          pixel[j] = (uint8_t)(color[j] * shade * 255.0f);
+        }
+        pixel[3] = 255;
+      }
+    }
+    images[i] = ecs_entity(world, {
+      .add = ecs_ids(ecs_pair(ecs_id(Uses), atlas)),
+      .set = ecs_values({ .type = ecs_id(ImageData), .ptr = &(ImageData){ .pixels = pixels, .size = sizes[i] } }),
+    });
+  }
+
+  const ecs_entity_t quad = make_quad(world);
+
+  ecs_entity_t* programs = malloc(params->programs * sizeof(ecs_entity_t));
+  for (int i = 0; i < params->programs; i++) {
+    programs[i] = make_sprite_program(world, atlas, i);
+  }
+
+  // Uploads the images. Sprites copy their region and layer rather than being IsA them, which would give every image
+  // a table of its own.
+  ecs_progress(world, 0.0f);
+
+  for (int i = 0; i < params->entities; i++) {
+    const int image = rand() % params->images;
+    TextureRegion region = *ecs_get(world, images[image], TextureRegion);
+    TextureLayer layer = *ecs_get(world, images[image], TextureLayer);
+    const ecs_entity_t entity = ecs_entity(world, {
+      .add = ecs_ids(
+        ecs_pair(ecs_id(Uses), quad),
+        ecs_pair(ecs_id(Uses), programs[rand() % params->programs])
+      ),
+      .set = ecs_values(
+        { .type = ecs_id(TextureRegion), .ptr = &region },
+        { .type = ecs_id(TextureLayer), .ptr = &layer },
+        {
+          .type = ecs_id(Position2D),
+          .ptr = &(Position2D){ {
+            random_float(-STRESS_HALF_WIDTH, STRESS_HALF_WIDTH),
+            random_float(-STRESS_HALF_HEIGHT, STRESS_HALF_HEIGHT),
+          } },
+        },
+        { .type = ecs_id(Scale2D), .ptr = &(Scale2D){ { (float)sizes[image].x, (float)sizes[image].y } } }
+      ),
+    });
+    if (random_float(0.0f, 1.0f) < params->fraction_moving) {
+      ecs_set(world, entity, Velocity2D, { { random_float(-100.0f, 100.0f), random_float(-100.0f, 100.0f) } });
+    }
+  }
+
+  free(images);
+  free(sizes);
+  free(programs);
+}
+
+static void texture_file_path(char* path, const size_t size, const int texture) {
+  snprintf(path, size, "glitch_bench_%d.ktx2", texture);
+}
+
+static void write_u32(FILE* file, const uint32_t value) {
+  const uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+  fwrite(bytes, 1, sizeof(bytes), file);
+}
+
+static void write_u64(FILE* file, const uint64_t value) {
+  write_u32(file, (uint32_t)value);
+  write_u32(file, (uint32_t)(value >> 32));
+}
+
+// Writes a KTX2 file of RGBA8 pixels with every level, a checkerboard of a random color that fades to gray as the
+// squares get smaller than a pixel.
+static bool write_texture_file(const char* path) {
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+
+  int levels = 1;
+  while (STREAMING_TEXTURE_SIZE >> levels) {
+    levels++;
+  }
+  static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+  fwrite(identifier, 1, sizeof(identifier), file);
+  // The format, type size, size, depth, layers, faces, levels and supercompression, then no data format descriptor,
+  // key/values or supercompression data.
+  const uint32_t header[] = { 37, 1, STREAMING_TEXTURE_SIZE, STREAMING_TEXTURE_SIZE, 0, 0, 1, (uint32_t)levels, 0 };
+  for (unsigned i = 0; i < GLI_COUNTOF(header); i++) {
+    write_u32(file, header[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    write_u32(file, 0);
+  }
+  write_u64(file, 0);
+  write_u64(file, 0);
+
+  // Levels are stored from the smallest, after the index.
+  uint64_t offsets[16];
+  uint64_t offset = 80 + 24 * (uint64_t)levels;
+  for (int i = levels - 1; i >= 0; i--) {
+    const uint64_t size = STREAMING_TEXTURE_SIZE >> i;
+    offsets[i] = offset;
+    offset += size * size * 4;
+  }
+  for (int i = 0; i < levels; i++) {
+    const uint64_t size = STREAMING_TEXTURE_SIZE >> i;
+    write_u64(file, offsets[i]);
+    write_u64(file, size * size * 4);
+    write_u64(file, size * size * 4);
+  }
+
+  const float color[3] = { random_float(0.2f, 1.0f), random_float(0.2f, 1.0f), random_float(0.2f, 1.0f) };
+  uint8_t* row = malloc(STREAMING_TEXTURE_SIZE * 4);
+  for (int i = levels - 1; i >= 0; i--) {
+    const int size = STREAMING_TEXTURE_SIZE >> i, square = 32 >> i;
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        const float shade = square ? ((x / square + y / square) % 2 ? 1.0f : 0.25f) : 0.625f;
+        for (int j = 0; j < 3; j++) {
+          row[x * 4 + j] = (uint8_t)(color[j] * shade * 255.0f);
+        }
+        row[x * 4 + 3] = 255;
+      }
+      fwrite(row, 4, size, file);
+    }
+  }
+  free(row);
+
+  return fclose(file) == 0;
+}
+
+static void make_streaming_scene(ecs_world_t* world, const bench_params_t* params) {
+  ecs_singleton_set(world, TextureStreaming, { .budget = (int64_t)params->stream_budget << 20 });
+
+  ecs_entity_t* textures = malloc(params->textures * sizeof(ecs_entity_t));
+  ecs_entity_t* programs = malloc(params->textures * sizeof(ecs_entity_t));
+  for (int i = 0; i < params->textures; i++) {
+    char path[64];
+    texture_file_path(path, sizeof(path), i);
+    if (!write_texture_file(path)) {
+      fprintf(stderr, "Could not write %s\n", path);
+    }
+    textures[i] = ecs_entity(world, {
+      .set = ecs_values({ .type = ecs_id(TextureFile), .ptr = &(TextureFile){ .path = strdup(path) } }),
+    });
+    // Each texture is an atlas of its own.
+    programs[i] = make_sprite_program(world, textures[i], i);
+  }
+
+  const ecs_entity_t quad = make_quad(world);
+  for (int i = 0; i < params->entities; i++) {
+    const int texture = rand() % params->textures;
+    const float size = random_float(16.0f, 256.0f);
+    ecs_entity(world, {
+      .add = ecs_ids(
+        ecs_isa(textures[texture]),
+        ecs_pair(ecs_id(Uses), quad),
+        ecs_pair(ecs_id(Uses), programs[texture])
+      ),
+      .set = ecs_values(
+        {
+          .type = ecs_id(Position2D),
+          .ptr = &(Position2D){ {
+            random_float(-STRESS_HALF_WIDTH, STRESS_HALF_WIDTH) * 4.0f,
+            random_float(-STRESS_HALF_HEIGHT, STRESS_HALF_HEIGHT) * 4.0f,
+          } },
+        },
+        { .type = ecs_id(Scale2D), .ptr = &(Scale2D){ { size, size } } }
+      ),
+    });
+  }
+
+  free(textures);
+  free(programs);
+}
+
+// Zooms in from far out and back, twice over the frames.
+static void zoom_streaming_camera(ecs_world_t* world, const bench_params_t* params, const int frame) {
+  const float progress = (float)frame / (float)params->frames;
+  Camera2D* camera = ecs_singleton_ensure(world, Camera2D);
+  camera->zoom = exp2f(-3.0f + 4.0f * (0.5f - 0.5f * cosf(progress * 4.0f * (float)CVKM_PI)));
+  ecs_singleton_modified(world, Camera2D);
+}
+
+static void make_city_scene(ecs_world_t* world, const bench_params_t* params) {
+  const ecs_entity_t program = make_program(world, true, 0, 0);
+  const ecs_entity_t building_mesh = make_box_mesh(world, true);
+  const ecs_entity_t prop_mesh = make_box_mesh(world, false);
+
+  const float stride = BLOCK_SIZE + STREET_WIDTH;
+  for (int x = 0; x < params->grid_size; x++) {
+    for (int z = 0; z < params->grid_size; z++) {
+      const float height = random_float(5.0f, 40.0f);
+      const float gray = random_float(0.3f, 0.8f);
+      ecs_entity(world, {
+        .add = ecs_ids(ecs_pair(ecs_id(Uses), building_mesh), ecs_pair(ecs_id(Uses), program)),
+        .set = ecs_values(
+          {
+            .type = ecs_id(Position3D),
+            .ptr = &(Position3D){ { (float)x * stride, height * 0.5f, -(float)z * stride } },
+          },
+          { .type = ecs_id(Scale3D), .ptr = &(Scale3D){ { BLOCK_SIZE, height, BLOCK_SIZE } } },
+          { .type = ecs_id(Color), .ptr = &(Color){ { gray, gray, gray, 1.0f } } }
+        ),
+      });
+
+      for (int i = 0; i < params->props_per_block; i++) {
+        // Along the street in front of and to the right of the block.
+        const float along = random_float(-0.5f, 0.5f) * stride;
+        const float across = BLOCK_SIZE * 0.5f + random_float(0.5f, STREET_WIDTH - 0.5f);
+        Position3D position = i % 2
+          ? (Position3D){ { (float)x * stride + along, 0.5f, -(float)z * stride + across } }
+          : (Position3D){ { (float)x * stride + across, 0.5f, -(float)z * stride + along } };
+        ecs_entity(world, {
+          .add = ecs_ids(ecs_pair(ecs_id(Uses), prop_mesh), ecs_pair(ecs_id(Uses), program)),
+          .set = ecs_values(
+            { .type = ecs_id(Position3D), .ptr = &position },
+            { .type = ecs_id(Scale3D), .ptr = &(Scale3D){ { 0.5f, 1.0f, 0.5f } } },
+            { .type = ecs_id(Color), .ptr = &(Color){ { 1.0f, 0.5f, 0.0f, 1.0f } } }
+          ),
+        });
+      }
+    }
+  }
+}
+
+// Walks down the first street of the city while looking around, the same way on every run.
+static void move_city_camera(ecs_world_t* world, const bench_params_t* params, const int frame) {
+  const float progress = (float)frame / (float)params->frames;
+  const float street_length = (float)params->grid_size * (BLOCK_SIZE + STREET_WIDTH);
+  ecs_set(world, ecs_id(Camera3D), Position3D, {
+    { BLOCK_SIZE * 0.5f + STREET_WIDTH * 0.5f, 1.7f, -progress * street_length } }
+  );
+
+  Rotation3D rotation = CVKM_QUAT_IDENTITY;
+  vkm_euler_to_quat(&(vkm_vec3){ { 0.0f, vkm_sin(progress * 20.0f) * 0.8f, 0.0f } }, &rotation);
+  ecs_set_ptr(world, ecs_id(Camera3D), Rotation3D, &rotation);
+}
+
+static ecs_entity_t terrain_mesh;
+
+// Waves that travel over the frames.
+static float terrain_height(const int x, const int z, const int frame) {
+  const float time = (float)frame * 0.05f;
+  return 2.0f * vkm_sin((float)x * 0.1f + time) * vkm_cos((float)z * 0.1f + time);
+}
+
+static void make_terrain_scene(ecs_world_t* world, const bench_params_t* params) {
+  const int size = params->terrain_size;
+  const int vertices_count = size * size, indices_count = (size - 1) * (size - 1) * 6;
+  vkm_vec3* vertices = malloc(vertices_count * sizeof(vkm_vec3));
+  for (int z = 0; z < size; z++) {
+    for (int x = 0; x < size; x++) {
+      vertices[z * size + x] = (vkm_vec3){ { (float)x - (float)size * 0.5f, terrain_height(x, z, 0), -(float)z } };
+    }
+  }
+  unsigned* indices = malloc(indices_count * sizeof(unsigned));
+  unsigned* index = indices;
+  for (int z = 0; z < size - 1; z++) {
+    for (int x = 0; x < size - 1; x++) {
+      const unsigned a = z * size + x, b = a + size;
+      *index++ = a;
+      *index++ = a + 1;
+      *index++ = b;
+      *index++ = b;
+      *index++ = a + 1;
+      *index++ = b + 1;
+    }
+  }
+
+  terrain_mesh = ecs_entity(world, {
+    .set = ecs_values(
+      {
+        .type = ecs_id(DynamicMesh),
+        .ptr = &(DynamicMesh) {
+          .data = vertices,
+          .indices = indices,
+          .vertices_capacity = vertices_count,
+          .indices_capacity = indices_count,
+          .vertices_count = vertices_count,
+          .indices_count = indices_count,
+          .primitive = GLI_TRIANGLES,
+          .vertex_attributes = {
+            { .type = GLI_VEC3 },
+          },
+        },
+      }
+    ),
+  });
+  const ecs_entity_t program = make_program(world, true, 0, 0);
+  ecs_entity(world, {
+    .add = ecs_ids(ecs_pair(ecs_id(Uses), terrain_mesh), ecs_pair(ecs_id(Uses), program)),
+    .set = ecs_values(
+      { .type = ecs_id(Position3D), .ptr = &(Position3D){ { 0.0f, 0.0f, -5.0f } } },
+      { .type = ecs_id(Color), .ptr = &(Color){ { 0.3f, 0.7f, 0.3f, 1.0f } } }
+    ),
+  });
+
+  ecs_set(world, ecs_id(Camera3D), Position3D, { { 0.0f, (float)size * 0.25f, 0.0f } });
+  Rotation3D rotation = CVKM_QUAT_IDENTITY;
+  vkm_euler_to_quat(&(vkm_vec3){ { -0.5f, 0.0f, 0.0f } }, &rotation);
+  ecs_set_ptr(world, ecs_id(Camera3D), Rotation3D, &rotation);
+}
+
+// Rewrites the heights of a band of rows that moves down the terrain, or of all of them.
+static void update_terrain(ecs_world_t* world, const bench_params_t* params, const int frame) {
+  DynamicMesh* mesh = ecs_get_mut(world, terrain_mesh, DynamicMesh);
+  const int size = params->terrain_size;
+  const int rows = params->dirty_rows ? vkm_mini(params->dirty_rows, size) : size;
+  const int first_row = params->dirty_rows ? frame * rows % size : 0;
+  const int last_row = vkm_mini(first_row + rows, size);
+  vkm_vec3* vertices = mesh->data;
+  for (int z = first_row; z < last_row; z++) {
+    for (int x = 0; x < size; x++) {
+      vertices[z * size + x].y = terrain_height(x, z, frame);
+    }
+  }
+  gli_update_dynamic_vertices(mesh, first_row * size, (last_row - first_row) * size);
+}
+
+static int compare_doubles(const void* a, const void* b) {
+  const double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : x > y;
+}
+
+// Of sorted samples, by nearest rank.
+static double percentile(const double* samples, const int count, const double percent) {
+  return samples[vkm_maxi(0, vkm_mini(count - 1, (int)(percent / 100.0 * count + 0.5) - 1))];
+}
+
+// Sorts the samples, in seconds, and prints their summary in milliseconds.
+static void print_samples(FILE* file, double* samples, const int count) {
+  qsort(samples, count, sizeof(double), compare_doubles);
+  double total = 0.0;
+  for (int i = 0; i < count; i++) {
+    total += samples[i];
+  }
+
+  fprintf(
+    file,
+    "{ \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+    total / count * 1000.0,
+    samples[0] * 1000.0,
+    percentile(samples, count, 50.0) * 1000.0,
+    percentile(samples, count, 90.0) * 1000.0,
+    percentile(samples, count, 99.0) * 1000.0,
+    samples[count - 1] * 1000.0
+  );
+}
+
+static bool parse_params(const int argc, char** argv, bench_params_t* params) {
+  for (int i = 1; i < argc; i++) {
+    const char* option = argv[i];
+    if (strcmp(option, "--software-occlusion") == 0) {
+      params->software_occlusion = true;
+      continue;
+    }
+    if (strcmp(option, "--occlusion-culling") == 0) {
+      params->occlusion_culling = true;
+      continue;
+    }
+    if (strcmp(option, "--on-demand") == 0) {
+      params->on_demand = true;
+      continue;
+    }
+    if (strcmp(option, "--render-thread") == 0) {
+      params->render_thread = true;
+      continue;
+    }
+    if (strcmp(option, "--mesh-files") == 0) {
+      params->mesh_files = true;
+      continue;
+    }
+
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char* value = argv[++i];
+    if (strcmp(option, "--scene") == 0) {
+      if (strcmp(value, "stress") == 0) {
+        params->scene = BENCH_STRESS;
+      } else if (strcmp(value, "city") == 0) {
+        params->scene = BENCH_CITY;
+      } else if (strcmp(value, "sprites") == 0) {
+        params->scene = BENCH_SPRITES;
+      } else if (strcmp(value, "streaming") == 0) {
+        params->scene = BENCH_STREAMING;
+      } else if (strcmp(value, "terrain") == 0) {
+        params->scene = BENCH_TERRAIN;
+      } else {
+        return false;
+      }
+    } else if (strcmp(option, "--backend") == 0) {
+      if (strcmp(value, "window") == 0) {
+        params->backend = GLI_BACKEND_WINDOW;
+      } else if (strcmp(value, "headless") == 0) {
+        params->backend = GLI_BACKEND_HEADLESS;
+      } else if (strcmp(value, "null") == 0) {
+        params->backend = GLI_BACKEND_NULL;
+      } else {
+        return false;
+      }
+    } else if (strcmp(option, "--capture") == 0) {
+      if (strcmp(value, "rgba") == 0) {
+        params->capture_format = GLI_CAPTURE_RGBA;
+      } else if (strcmp(value, "yuv420") == 0) {
+        params->capture_format = GLI_CAPTURE_YUV420;
+      } else {
+        return false;
+      }
+    } else if (strcmp(option, "--target-fps") == 0) {
+      params->target_fps = (float)atof(value);
+    } else if (strcmp(option, "--replays") == 0) {
+      params->replays = atoi(value);
+    } else if (strcmp(option, "--frames") == 0) {
+      params->frames = atoi(value);
+    } else if (strcmp(option, "--warmup") == 0) {
+      params->warmup_frames = atoi(value);
+    } else if (strcmp(option, "--threads") == 0) {
+      params->threads = atoi(value);
+    } else if (strcmp(option, "--width") == 0) {
+      params->width = atoi(value);
+    } else if (strcmp(option, "--height") == 0) {
+      params->height = atoi(value);
+    } else if (strcmp(option, "--entities") == 0) {
+      params->entities = atoi(value);
+    } else if (strcmp(option, "--meshes") == 0) {
+      params->meshes = atoi(value);
+    } else if (strcmp(option, "--programs") == 0) {
+      params->programs = atoi(value);
+    } else if (strcmp(option, "--uniforms") == 0) {
+      params->uniforms = atoi(value);
+    } else if (strcmp(option, "--colors") == 0) {
+      params->colors = atoi(value);
+    } else if (strcmp(option, "--fraction-3d") == 0) {
+      params->fraction_3d = (float)atof(value);
+    } else if (strcmp(option, "--fraction-moving") == 0) {
+      params->fraction_moving = (float)atof(value);
+    } else if (strcmp(option, "--grid") == 0) {
+      params->grid_size = atoi(value);
+    } else if (strcmp(option, "--props") == 0) {
+      params->props_per_block = atoi(value);
+    } else if (strcmp(option, "--images") == 0) {
+      params->images = atoi(value);
+    } else if (strcmp(option, "--textures") == 0) {
+      params->textures = atoi(value);
+    } else if (strcmp(option, "--stream-budget") == 0) {
+      params->stream_budget = atoi(value);
+    } else if (strcmp(option, "--terrain") == 0) {
+      params->terrain_size = atoi(value);
+    } else if (strcmp(option, "--dirty-rows") == 0) {
+      params->dirty_rows = atoi(value);
+    } else if (strcmp(option, "--output") == 0) {
+      params->output = value;
+    } else {
+      return false;
+    }
+  }
+
+  if (params->frames <= 0
+    || params->warmup_frames < 0
+    || params->threads < 0
+    || params->width <= 0
+    || params->height <= 0
+    || params->entities < 0
+    || params->target_fps < 0.0f
+    || params->replays < 0) {
+    return false;
+  }
+
+  // The other options are only checked for the scenes that use them.
+  switch (params->scene) {
+    case BENCH_STRESS: {
+      const bool both_dimensions = params->fraction_3d > 0.0f && params->fraction_3d < 1.0f;
+      return params->meshes >= (both_dimensions ? 2 : 1)
+        && params->programs >= (both_dimensions ? 2 : 1)
+        && params->uniforms >= 1 && params->uniforms <= GLI_MAX_UNIFORMS
+        && params->colors >= 0
+        && params->fraction_3d >= 0.0f && params->fraction_3d <= 1.0f
+        && params->fraction_moving >= 0.0f && params->fraction_moving <= 1.0f;
+    }
+    case BENCH_CITY:
+      return params->grid_size > 0 && params->props_per_block >= 0;
+    case BENCH_SPRITES:
+      return params->images > 0
+        && params->programs >= 1
+        && params->fraction_moving >= 0.0f && params->fraction_moving <= 1.0f;
+    case BENCH_STREAMING:
+      return params->textures > 0 && params->stream_budget >= 0;
+    case BENCH_TERRAIN:
+      return params->terrain_size >= 2 && params->dirty_rows >= 0;
+  }
+  return false;
+}
+
+static void print_usage(FILE* file, const char* program) {
+  fprintf(
+    file,
+    "Usage: %s [--scene stress|city|sprites|streaming|terrain] [--backend window|headless|null] [--frames N]\n"
+    "  [--warmup N] [--threads N] [--width N] [--height N] [--entities N] [--meshes N] [--programs N]\n"
+    "  [--uniforms N] [--colors N] [--fraction-3d F] [--fraction-moving F] [--grid N] [--props N] [--images N]\n"
+    "  [--textures N] [--stream-budget MIB] [--terrain N] [--dirty-rows N] [--software-occlusion]\n"
+    "  [--occlusion-culling] [--on-demand] [--capture rgba|yuv420] [--target-fps F] [--render-thread] [--replays N]\n"
+    "  [--mesh-files] [--output FILE] [--help]\n",
+    program
+  );
+}
+
+int main(const int argc, char** argv) {
+  bench_params_t params = {
+    .scene = BENCH_STRESS,
+    .capture_format = -1,
+    .frames = 600,
+    .warmup_frames = 10,
+    .width = 1280,
+    .height = 720,
+    .entities = 10000,
+    .meshes = 16,
+    .programs = 8,
+    .uniforms = 1,
+    .fraction_3d = 0.5f,
+    .fraction_moving = 0.1f,
+    .grid_size = 32,
+    .props_per_block = 16,
+    .images = 256,
+    .textures = 32,
+    .stream_budget = 16,
+    .terrain_size = 256,
+  };
+  if (argc == 2 && strcmp(argv[1], "--help") == 0) {
+    print_usage(stdout, argv[0]);
+    return EXIT_SUCCESS;
+  }
+  if (!parse_params(argc, argv, &params)) {
+    print_usage(stderr, argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  FILE* output = params.output ? fopen(params.output, "w") : stdout;
+  if (!output) {
+    fprintf(stderr, "Could not open %s\n", params.output);
+    return EXIT_FAILURE;
+  }
+
+  ecs_world_t* world = ecs_init();
+  if (params.threads > 0) {
+    ecs_set_threads(world, params.threads);
+  }
+
+  ECS_IMPORT(world, glitch);
+  const ecs_entity_t glitch_module = ecs_lookup(world, "glitch");
+
+  ECS_SYSTEM(world, Move2D, EcsOnUpdate, [inout] cvkm.Position2D, [in] cvkm.Velocity2D);
+  ECS_SYSTEM(world, Move3D, EcsOnUpdate, [inout] cvkm.Position3D, [in] cvkm.Velocity3D);
+
+  ecs_set_id(world, ecs_id(Window), ecs_id(Window), sizeof(GLitchWindow), &(GLitchWindow){
+    .name = "GLitch bench",
+    .backend = params.backend,
+    .size = { { (uint16_t)params.width, (uint16_t)params.height } },
+  });
+  ecs_singleton_add(world, RenderStats);
+  if (params.backend == GLI_BACKEND_NULL) {
+    ecs_singleton_add(world, NullBackendStats);
+  }
+  if (params.capture_format >= 0) {
+    ecs_singleton_set(world, FrameCapture, { .format = (gli_capture_format_t)params.capture_format });
+  }
+  if (params.software_occlusion) {
+    ecs_singleton_add(world, SoftwareOcclusion);
+  }
+  if (params.occlusion_culling) {
+    ecs_singleton_add(world, OcclusionCulling);
+  }
+  if (params.on_demand) {
+    ecs_singleton_add(world, RenderOnDemand);
+  }
+  if (params.target_fps > 0.0f) {
+    ecs_singleton_set(world, FramePacing, { .target_fps = params.target_fps });
+  }
+  if (params.render_thread) {
+    ecs_singleton_add(world, RenderThread);
+  }
+  ecs_singleton_set(world, CommandStream, { .replays = params.replays });
+
+  cook_meshes = params.mesh_files;
+  srand(1);
+  if (params.scene == BENCH_STRESS) {
+    make_extra_uniforms(world, params.uniforms - 1);
+    make_stress_scene(world, &params);
+  } else if (params.scene == BENCH_CITY) {
+    make_city_scene(world, &params);
+  } else if (params.scene == BENCH_SPRITES) {
+    make_sprites_scene(world, &params);
+  } else if (params.scene == BENCH_STREAMING) {
+    make_streaming_scene(world, &params);
+  } else {
+    make_terrain_scene(world, &params);
+  }
+
+  // The systems of the module, with their time spent in each frame.
+  ecs_measure_system_time(world, true);
+  ecs_entity_t systems[64];
+  ecs_ftime_t last_times_spent[64];
+  double* system_samples[64];
+  int systems_count = 0;
+  ecs_iter_t children = ecs_children(world, glitch_module);
+  while (ecs_children_next(&children)) {
+    for (int i = 0; i < children.count && systems_count < (int)GLI_COUNTOF(systems); i++) {
+      if (ecs_has_id(world, children.entities[i], EcsSystem)) {
+        systems[systems_count] = children.entities[i];
+        system_samples[systems_count] = malloc(params.frames * sizeof(double));
+        systems_count++;
+      }
+    }
+  }
+  double* frame_samples = malloc(params.frames * sizeof(double));
+  RenderStats render_stats_total = { 0 };
+  int64_t gl_calls_total = 0;
+  double render_thread_wait_total = 0.0, render_thread_draw_total = 0.0;
+  int64_t commands_total = 0, command_bytes_total = 0, uniform_calls_total = 0, skipped_uniform_calls_total = 0;
+  int64_t executed_texture_binds_total = 0;
+  double execute_total = 0.0;
+  TextureStreaming streaming_total = { 0 };
+
+  int frames = 0;
+  for (int i = -params.warmup_frames; i < params.frames; i++) {
+    if (params.scene == BENCH_CITY) {
+      move_city_camera(world, &params, vkm_maxi(i, 0));
+    } else if (params.scene == BENCH_STREAMING) {
+      zoom_streaming_camera(world, &params, vkm_maxi(i, 0));
+    } else if (params.scene == BENCH_TERRAIN) {
+      update_terrain(world, &params, i + params.warmup_frames);
+    }
+
+    if (i == 0) {
+      for (int j = 0; j < systems_count; j++) {
+        last_times_spent[j] = ecs_system_get(world, systems[j])->time_spent;
+      }
+    }
+
+    ecs_time_t start = { 0 };
+    ecs_time_measure(&start);
+    if (!ecs_progress(world, 1.0f / 60.0f)) {
+      break;
+    }
+    if (i < 0) {
+      continue;
+    }
+
+    frame_samples[frames] = ecs_time_measure(&start);
+    // Time spent is accumulated in single precision, so the difference is only good to about a microsecond.
+    for (int j = 0; j < systems_count; j++) {
+      const ecs_ftime_t time_spent = ecs_system_get(world, systems[j])->time_spent;
+      system_samples[j][frames] = (double)(time_spent - last_times_spent[j]);
+      last_times_spent[j] = time_spent;
+    }
+
+    const RenderStats* render_stats = ecs_singleton_get(world, RenderStats);
+    render_stats_total.draw_calls += render_stats->draw_calls;
+    render_stats_total.triangles += render_stats->triangles;
+    render_stats_total.program_binds += render_stats->program_binds;
+    render_stats_total.texture_binds += render_stats->texture_binds;
+    render_stats_total.uniform_values += render_stats->uniform_values;
+    render_stats_total.uploaded_bytes += render_stats->uploaded_bytes;
+    const NullBackendStats* null_backend_stats = ecs_singleton_get(world, NullBackendStats);
+    if (null_backend_stats) {
+      gl_calls_total += null_backend_stats->calls;
+    }
+    const CommandStream* command_stream = ecs_singleton_get(world, CommandStream);
+    commands_total += command_stream->commands;
+    command_bytes_total += command_stream->bytes;
+    execute_total += command_stream->execute;
+    uniform_calls_total += command_stream->uniform_calls;
+    skipped_uniform_calls_total += command_stream->skipped_uniform_calls;
+    executed_texture_binds_total += command_stream->texture_binds;
+    const TextureStreaming* streaming = ecs_singleton_get(world, TextureStreaming);
+    if (streaming) {
+      streaming_total.resident_bytes += streaming->resident_bytes;
+      streaming_total.wanted_bytes += streaming->wanted_bytes;
+      streaming_total.bias += streaming->bias;
+      streaming_total.pending_levels += streaming->pending_levels;
+      streaming_total.loaded_levels += streaming->loaded_levels;
+      streaming_total.evicted_levels += streaming->evicted_levels;
+    }
+    const RenderThread* render_thread = ecs_singleton_get(world, RenderThread);
+    if (render_thread) {
+      render_thread_wait_total += render_thread->wait;
+      render_thread_draw_total += render_thread->draw;
+    }
+    frames++;
+  }
+
+  if (frames > 0) {
+    fprintf(output, "{\n");
+    static const char* scene_names[] = { "stress", "city", "sprites", "streaming", "terrain" };
+    fprintf(output, "  \"scene\": \"%s\",\n", scene_names[params.scene]);
+    static const char* backend_names[] = { "window", "headless", "null" };
+    fprintf(output, "  \"backend\": \"%s\",\n", backend_names[params.backend]);
+    fprintf(
+      output,
+      "  \"params\": { \"frames\": %d, \"threads\": %d, \"width\": %d, \"height\": %d, \"entities\": %d, "
+      "\"meshes\": %d, \"programs\": %d, \"uniforms\": %d, \"colors\": %d, \"fraction_3d\": %g, "
+      "\"fraction_moving\": %g, \"grid\": %d, \"props\": %d, \"images\": %d, \"textures\": %d, "
+      "\"stream_budget\": %d, \"terrain\": %d, \"dirty_rows\": %d, \"software_occlusion\": %s, "
+      "\"occlusion_culling\": %s, \"mesh_files\": %s },\n",
+      frames,
+      params.threads,
+      params.width,
+      params.height,
+      params.entities,
+      params.meshes,
+      params.programs,
+      params.uniforms,
+      params.colors,
+      params.fraction_3d,
+      params.fraction_moving,
+      params.grid_size,
+      params.props_per_block,
+      params.images,
+      params.textures,
+      params.stream_budget,
+      params.terrain_size,
+      params.dirty_rows,
+      params.software_occlusion ? "true" : "false",
+      params.occlusion_culling ? "true" : "false",
+      params.mesh_files ? "true" : "false"
+    );
+    fprintf(
+      output,
+      "  \"per_frame\": { \"draw_calls\": %.1f, \"triangles\": %.1f, \"program_binds\": %.1f, \"texture_binds\": %.1f, "
+      "\"uniform_values\": %.1f, \"uploaded_bytes\": %.1f",
+      (double)render_stats_total.draw_calls / frames,
+      (double)render_stats_total.triangles / frames,
+      (double)render_stats_total.program_binds / frames,
+      (double)render_stats_total.texture_binds / frames,
+      (double)render_stats_total.uniform_values / frames,
+      (double)render_stats_total.uploaded_bytes / frames
+    );
+    if (params.backend == GLI_BACKEND_NULL) {
+      fprintf(output, ", \"gl_calls\": %.1f", (double)gl_calls_total / frames);
+    }
+    fprintf(output, " },\n");
+    const RenderOnDemand* on_demand = ecs_singleton_get(world, RenderOnDemand);
+    if (on_demand) {
+      fprintf(
+        output,
+        "  \"on_demand\": { \"drawn\": %lld, \"skipped\": %lld },\n",
+        (long long)on_demand->drawn,
+        (long long)on_demand->skipped
+      );
+    }
+    const FramePacing* pacing = ecs_singleton_get(world, FramePacing);
+    if (pacing) {
+      fprintf(
+        output,
+        "  \"pacing\": { \"frame_time\": %.3f, \"frame_time_variance\": %.4f, \"predicted_cost\": %.3f, "
+        "\"missed\": %lld },\n",
+        pacing->frame_time,
+        pacing->frame_time_variance,
+        pacing->predicted_cost,
+        (long long)pacing->missed
+      );
+    }
+    fprintf(
+      output,
+      "  \"commands\": { \"count\": %.1f, \"bytes\": %.1f, \"execute\": %.3f, \"uniform_calls\": %.1f, "
+      "\"skipped_uniform_calls\": %.1f, \"texture_binds\": %.1f },\n",
+      (double)commands_total / frames,
+      (double)command_bytes_total / frames,
+      execute_total / frames,
+      (double)uniform_calls_total / frames,
+      (double)skipped_uniform_calls_total / frames,
+      (double)executed_texture_binds_total / frames
+    );
+    if (params.render_thread) {
+      fprintf(
+        output,
+        "  \"render_thread\": { \"wait\": %.3f, \"draw\": %.3f },\n",
+        render_thread_wait_total / frames,
+        render_thread_draw_total / frames
+      );
+    }
+    if (params.scene == BENCH_STREAMING) {
+      fprintf(
+        output,
+        "  \"streaming\": { \"resident_bytes\": %.1f, \"wanted_bytes\": %.1f, \"bias\": %.2f, "
+        "\"pending_levels\": %.2f, \"loaded_levels\": %.2f, \"evicted_levels\": %.2f },\n",
+        (double)streaming_total.resident_bytes / frames,
+        (double)streaming_total.wanted_bytes / frames,
+        (double)streaming_total.bias / frames,
+        (double)streaming_total.pending_levels / frames,
+        (double)streaming_total.loaded_levels / frames,
+        (double)streaming_total.evicted_levels / frames
+      );
+    }
+    const FrameCapture* capture = ecs_singleton_get(world, FrameCapture);
+    if (capture) {
+      fprintf(
+        output,
+        "  \"capture\": { \"format\": \"%s\", \"delivered\": %lld, \"stalls\": %d },\n",
+        capture->format == GLI_CAPTURE_RGBA ? "rgba" : "yuv420",
+        (long long)(capture->pixels ? capture->frame + 1 : 0),
+        capture->stalls
+      );
+    }
+    fprintf(output, "  \"frame_ms\": ");
+    print_samples(output, frame_samples, frames);
+    fprintf(output, ",\n  \"systems_ms\": {\n");
+    for (int i = 0; i < systems_count; i++) {
+      fprintf(output, "    \"%s\": ", ecs_get_name(world, systems[i]));
+      print_samples(output, system_samples[i], frames);
+      fprintf(output, i < systems_count - 1 ? ",\n" : "\n");
+    }
+    fprintf(output, "  }\n}\n");
+  }
+
+  for (int i = 0; i < systems_count; i++) {
+    free(system_samples[i]);
+  }
+  free(frame_samples);
+  if (output != stdout) {
+    fclose(output);
+  }
+
+  const bool programs_matched = params.scene != BENCH_STRESS || check_stress_programs(world);
+  ecs_fini(world);
+  if (params.scene == BENCH_STREAMING) {
+    for (int i = 0; i < params.textures; i++) {
+      char path[64];
+      texture_file_path(path, sizeof(path), i);
+      remove(path);
+    }
+  }
+  for (int i = 0; i < cooked_meshes_count; i++) {
+    char path[64];
+    mesh_file_path(path, sizeof(path), i);
+    remove(path);
+  }
+  return frames > 0 && programs_matched ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CVKM_NO
+#define CVKM_ENABLE_FLECS
+#define CVKM_FLECS_IMPLEMENTATION
+#include <cvkm.h>
+#include <flecs.h>
+#include <glitch.h>
+
+// Cooks the meshes of GLB files into mesh files for MeshFile, one for each primitive, named after the file and the
+// index of the primitive: model.glb becomes model.0.mesh, model.1.mesh, etc. The files are loaded by the glitch module
+// itself, with the null backend, so the meshes are exactly those that the entities of a ModelFile would use.
+
+typedef struct cook_params_t {
+  int lods_count;
+  float lod_max_error;
+  // The GLB file being cooked, and how many of its primitives are done.
+  const char* path;
+  int primitives_count;
+  bool failed;
+} cook_params_t;
+
+static void CookMeshes(ecs_iter_t* it) {
+  const MeshData* mesh_datas = ecs_field(it, MeshData, 0);
+  cook_params_t* params = it->ctx;
+
+  for (int i = 0; i < it->count; i++) {
+    MeshData mesh_data = mesh_datas[i];
+    mesh_data.lods_count = params->lods_count;
+    mesh_data.lod_max_error = params->lod_max_error;
+
+    const char* extension = strrchr(params->path, '.');
+    const int stem_length = extension ? (int)(extension - params->path) : (int)strlen(params->path);
+    char path[4096];
+    snprintf(path, sizeof(path), "%.*s.%d.mesh", stem_length, params->path, params->primitives_count++);
+    if (gli_cook_mesh(&mesh_data, path)) {
+      printf("%s: %d vertices, %d indices\n", path, mesh_data.vertices_count, mesh_data.indices_count);
+    } else {
+      params->failed = true;
+    }
+  }
+}
+
+int main(const int argc, char** argv) {
+  cook_params_t params = { .lods_count = 0 };
+  int first_path = 1;
+  for (; first_path + 1 < argc && strncmp(argv[first_path], "--", 2) == 0; first_path += 2) {
+    if (strcmp(argv[first_path], "--lods") == 0) {
+      params.lods_count = atoi(argv[first_path + 1]);
+    } else if (strcmp(argv[first_path], "--lod-error") == 0) {
+      params.lod_max_error = (float)atof(argv[first_path + 1]);
+    } else {
+      break;
+    }
+  }
+  if (first_path >= argc || params.lods_count < 0 || params.lods_count >= GLI_MAX_LODS) {
+    fprintf(stderr, "Usage: %s [--lods N] [--lod-error F] FILE.glb...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  ecs_world_t* world = ecs_init();
+  ECS_IMPORT(world, glitch);
+  ecs_set_id(world, ecs_id(Window), ecs_id(Window), sizeof(GLitchWindow), &(GLitchWindow){
+    .name = "glitch_cook",
+    .size = { { 1, 1 } },
+    .backend = GLI_BACKEND_NULL,
+  });
+  // Before MakeMeshes takes the mesh data.
+  ecs_observer(world, {
+    .query.terms = { { .id = ecs_id(MeshData), .inout = EcsIn } },
+    .events = { EcsOnSet },
+    .callback = CookMeshes,
+    .ctx = &params,
+  });
+
+  for (int i = first_path; i < argc; i++) {
+    params.path = argv[i];
+    params.primitives_count = 0;
+    const ecs_entity_t model = ecs_new(world);
+    ecs_set(world, model, ModelFile, { .path = strdup(argv[i]) });
+    ecs_progress(world, 0.0f);
+    if (!params.primitives_count) {
+      params.failed = true;
+    }
+    ecs_delete(world, model);
+  }
+
+  ecs_fini(world);
+  return params.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -8,6 +8,9 @@
 #endif
 
 #include <assert.h>
+#include <ctype.h>
+#include <float.h>
+#include <limits.h>
 #include <stdalign.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -18,13 +21,36 @@
 #include <flecs.h>
 #include <glitch.h>
 
+#ifdef GLI_LINUX
+#include <EGL/eglext.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLI_SSE2
+#include <emmintrin.h>
+#endif
+
 #ifdef GLI_EMSCRIPTEN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #ifndef GLI_CANVAS_SELECTOR
 #define GLI_CANVAS_SELECTOR "#canvas"
 #endif
 #endif
 
 static GLuint attributeless_vertex_array;
+// Whether the driver can compile and link shaders in its own threads, letting us poll for completion.
+static bool parallel_shader_compile;
 
 // The number of terms that we use in the ecs_query_desc_t::terms of the shader program.
 #define GLI_RESERVED_TERMS 9
@@ -49,7 +75,6 @@ static const char* built_in_names[] = {
   "delta_time",
 };
 
-#define GLI_BUILT_IN_UNIFORMS_COUNT GLI_COUNTOF(built_in_names)
 
 static GLuint built_ins_uniform_buffer;
 #pragma endregion
@@ -99,6 +124,8 @@ typedef void (*glGetActiveUniformProc)(
   GLchar* name
 );
 static glGetActiveUniformProc glGetActiveUniform;
+typedef void (*glGetAttachedShadersProc)(GLuint program, GLsizei maxCount, GLsizei* count, GLuint* shaders);
+static glGetAttachedShadersProc glGetAttachedShaders;
 typedef GLint (*glGetAttribLocationProc)(GLuint program, const GLchar* name);
 static glGetAttribLocationProc glGetAttribLocation;
 typedef GLint (*glGetUniformLocationProc)(GLuint program, const GLchar* name);
@@ -132,6 +159,8 @@ typedef void (*glEnableVertexAttribArrayProc)(GLuint index);
 static glEnableVertexAttribArrayProc glEnableVertexAttribArray;
 typedef void (*glBufferDataProc)(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
 static glBufferDataProc glBufferData;
+typedef void (*glBufferSubDataProc)(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+static glBufferSubDataProc glBufferSubData;
 typedef void (*glUseProgramProc)(GLuint program);
 static glUseProgramProc glUseProgram;
 typedef void (*glUniform1fvProc)(GLint location, GLsizei count, const GLfloat* value);
@@ -160,19 +189,819 @@ typedef void (*glUniform4uivProc)(GLint location, GLsizei count, const GLuint* v
 static glUniform4uivProc glUniform4uiv;
 typedef void (*glUniformMatrix4fvProc)(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
 static glUniformMatrix4fvProc glUniformMatrix4fv;
+typedef void (*glGenQueriesProc)(GLsizei n, GLuint* ids);
+static glGenQueriesProc glGenQueries;
+typedef void (*glDeleteQueriesProc)(GLsizei n, const GLuint* ids);
+static glDeleteQueriesProc glDeleteQueries;
+typedef void (*glBeginQueryProc)(GLenum target, GLuint id);
+static glBeginQueryProc glBeginQuery;
+typedef void (*glEndQueryProc)(GLenum target);
+static glEndQueryProc glEndQuery;
+typedef void (*glGetQueryObjectuivProc)(GLuint id, GLenum pname, GLuint* params);
+static glGetQueryObjectuivProc glGetQueryObjectuiv;
+typedef void (*glQueryCounterProc)(GLuint id, GLenum target);
+static glQueryCounterProc glQueryCounter;
+typedef void (*glGetQueryObjectui64vProc)(GLuint id, GLenum pname, GLuint64* params);
+static glGetQueryObjectui64vProc glGetQueryObjectui64v;
+typedef void (*glBeginConditionalRenderProc)(GLuint id, GLenum mode);
+static glBeginConditionalRenderProc glBeginConditionalRender;
+typedef void (*glEndConditionalRenderProc)(void);
+static glEndConditionalRenderProc glEndConditionalRender;
+typedef const GLubyte* (*glGetStringiProc)(GLenum name, GLuint index);
+static glGetStringiProc glGetStringi;
+typedef void (*glGenFramebuffersProc)(GLsizei n, GLuint* framebuffers);
+static glGenFramebuffersProc glGenFramebuffers;
+typedef void (*glDeleteFramebuffersProc)(GLsizei n, const GLuint* framebuffers);
+static glDeleteFramebuffersProc glDeleteFramebuffers;
+typedef void (*glBindFramebufferProc)(GLenum target, GLuint framebuffer);
+static glBindFramebufferProc glBindFramebuffer;
+typedef GLenum (*glCheckFramebufferStatusProc)(GLenum target);
+static glCheckFramebufferStatusProc glCheckFramebufferStatus;
+typedef void (*glFramebufferRenderbufferProc)(
+  GLenum target,
+  GLenum attachment,
+  GLenum renderbuffertarget,
+  GLuint renderbuffer
+);
+static glFramebufferRenderbufferProc glFramebufferRenderbuffer;
+typedef void (*glGenRenderbuffersProc)(GLsizei n, GLuint* renderbuffers);
+static glGenRenderbuffersProc glGenRenderbuffers;
+typedef void (*glDeleteRenderbuffersProc)(GLsizei n, const GLuint* renderbuffers);
+static glDeleteRenderbuffersProc glDeleteRenderbuffers;
+typedef void (*glBindRenderbufferProc)(GLenum target, GLuint renderbuffer);
+static glBindRenderbufferProc glBindRenderbuffer;
+typedef void (*glRenderbufferStorageProc)(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+static glRenderbufferStorageProc glRenderbufferStorage;
+typedef void* (*glMapBufferRangeProc)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+static glMapBufferRangeProc glMapBufferRange;
+typedef GLboolean (*glUnmapBufferProc)(GLenum target);
+static glUnmapBufferProc glUnmapBuffer;
+typedef GLsync (*glFenceSyncProc)(GLenum condition, GLbitfield flags);
+static glFenceSyncProc glFenceSync;
+typedef GLenum (*glClientWaitSyncProc)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+static glClientWaitSyncProc glClientWaitSync;
+typedef void (*glDeleteSyncProc)(GLsync sync);
+static glDeleteSyncProc glDeleteSync;
+typedef void (*glGenerateMipmapProc)(GLenum target);
+static glGenerateMipmapProc glGenerateMipmap;
+// Optional, from KHR_parallel_shader_compile.
+typedef void (*glMaxShaderCompilerThreadsKHRProc)(GLuint count);
+static glMaxShaderCompilerThreadsKHRProc glMaxShaderCompilerThreadsKHR;
+
+// The OpenGL 1.1 entry points are exported by the system library, but we call them through pointers too so that the
+// null backend can replace them. Being function-like, these macros leave the bare names to the real functions.
+typedef void (APIENTRY* glClearProc)(GLbitfield mask);
+static glClearProc gli_glClear;
+#define glClear(...) gli_glClear(__VA_ARGS__)
+typedef void (APIENTRY* glClearColorProc)(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+static glClearColorProc gli_glClearColor;
+#define glClearColor(...) gli_glClearColor(__VA_ARGS__)
+typedef void (APIENTRY* glViewportProc)(GLint x, GLint y, GLsizei width, GLsizei height);
+static glViewportProc gli_glViewport;
+#define glViewport(...) gli_glViewport(__VA_ARGS__)
+typedef void (APIENTRY* glEnableProc)(GLenum cap);
+static glEnableProc gli_glEnable;
+#define glEnable(...) gli_glEnable(__VA_ARGS__)
+typedef void (APIENTRY* glDisableProc)(GLenum cap);
+static glDisableProc gli_glDisable;
+#define glDisable(...) gli_glDisable(__VA_ARGS__)
+typedef void (APIENTRY* glDepthMaskProc)(GLboolean flag);
+static glDepthMaskProc gli_glDepthMask;
+#define glDepthMask(...) gli_glDepthMask(__VA_ARGS__)
+typedef void (APIENTRY* glDepthFuncProc)(GLenum func);
+static glDepthFuncProc gli_glDepthFunc;
+#define glDepthFunc(...) gli_glDepthFunc(__VA_ARGS__)
+typedef void (APIENTRY* glColorMaskProc)(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+static glColorMaskProc gli_glColorMask;
+#define glColorMask(...) gli_glColorMask(__VA_ARGS__)
+typedef void (APIENTRY* glDrawArraysProc)(GLenum mode, GLint first, GLsizei count);
+static glDrawArraysProc gli_glDrawArrays;
+#define glDrawArrays(...) gli_glDrawArrays(__VA_ARGS__)
+typedef void (APIENTRY* glDrawElementsProc)(GLenum mode, GLsizei count, GLenum type, const void* indices);
+static glDrawElementsProc gli_glDrawElements;
+#define glDrawElements(...) gli_glDrawElements(__VA_ARGS__)
+typedef void (APIENTRY* glGetIntegervProc)(GLenum pname, GLint* data);
+static glGetIntegervProc gli_glGetIntegerv;
+#define glGetIntegerv(...) gli_glGetIntegerv(__VA_ARGS__)
+typedef void (APIENTRY* glReadPixelsProc)(
+  GLint x,
+  GLint y,
+  GLsizei width,
+  GLsizei height,
+  GLenum format,
+  GLenum type,
+  void* pixels
+);
+static glReadPixelsProc gli_glReadPixels;
+#define glReadPixels(...) gli_glReadPixels(__VA_ARGS__)
+typedef GLenum (APIENTRY* glGetErrorProc)(void);
+static glGetErrorProc gli_glGetError;
+#define glGetError() gli_glGetError()
+typedef void (APIENTRY* glFinishProc)(void);
+static glFinishProc gli_glFinish;
+#define glFinish() gli_glFinish()
+typedef void (APIENTRY* glGenTexturesProc)(GLsizei n, GLuint* textures);
+static glGenTexturesProc gli_glGenTextures;
+#define glGenTextures(...) gli_glGenTextures(__VA_ARGS__)
+typedef void (APIENTRY* glDeleteTexturesProc)(GLsizei n, const GLuint* textures);
+static glDeleteTexturesProc gli_glDeleteTextures;
+#define glDeleteTextures(...) gli_glDeleteTextures(__VA_ARGS__)
+typedef void (APIENTRY* glBindTextureProc)(GLenum target, GLuint texture);
+static glBindTextureProc gli_glBindTexture;
+#define glBindTexture(...) gli_glBindTexture(__VA_ARGS__)
+typedef void (APIENTRY* glTexParameteriProc)(GLenum target, GLenum pname, GLint param);
+static glTexParameteriProc gli_glTexParameteri;
+#define glTexParameteri(...) gli_glTexParameteri(__VA_ARGS__)
+
+// Linux headers declare these OpenGL 1.2 entry points, which aren't exported everywhere, so they are loaded like the
+// others but named like the ones above.
+typedef void (APIENTRY* glTexImage3DProc)(
+  GLenum target,
+  GLint level,
+  GLint internalformat,
+  GLsizei width,
+  GLsizei height,
+  GLsizei depth,
+  GLint border,
+  GLenum format,
+  GLenum type,
+  const void* pixels
+);
+static glTexImage3DProc gli_glTexImage3D;
+#define glTexImage3D(...) gli_glTexImage3D(__VA_ARGS__)
+typedef void (APIENTRY* glTexSubImage3DProc)(
+  GLenum target,
+  GLint level,
+  GLint xoffset,
+  GLint yoffset,
+  GLint zoffset,
+  GLsizei width,
+  GLsizei height,
+  GLsizei depth,
+  GLenum format,
+  GLenum type,
+  const void* pixels
+);
+static glTexSubImage3DProc gli_glTexSubImage3D;
+#define glTexSubImage3D(...) gli_glTexSubImage3D(__VA_ARGS__)
+typedef void (APIENTRY* glCompressedTexImage3DProc)(
+  GLenum target,
+  GLint level,
+  GLenum internalformat,
+  GLsizei width,
+  GLsizei height,
+  GLsizei depth,
+  GLint border,
+  GLsizei imageSize,
+  const void* data
+);
+static glCompressedTexImage3DProc gli_glCompressedTexImage3D;
+#define glCompressedTexImage3D(...) gli_glCompressedTexImage3D(__VA_ARGS__)
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Compressed texture formats, from extensions that not every header knows about.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#define GL_COMPRESSED_SRGB8_ETC2 0x9275
+#define GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9276
+#define GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9277
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#define GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC 0x9279
 #endif
 
 ECS_COMPONENT_DECLARE(Window);
 ECS_COMPONENT_DECLARE(MeshData);
 ECS_COMPONENT_DECLARE(Mesh);
+ECS_COMPONENT_DECLARE(ModelFile);
+ECS_COMPONENT_DECLARE(MeshFile);
+ECS_COMPONENT_DECLARE(DynamicMesh);
 ECS_COMPONENT_DECLARE(ShaderProgramSource);
 ECS_COMPONENT_DECLARE(ShaderProgram);
+ECS_COMPONENT_DECLARE(TextureAtlas);
+ECS_COMPONENT_DECLARE(ImageData);
+ECS_COMPONENT_DECLARE(TextureRegion);
+ECS_COMPONENT_DECLARE(TextureLayer);
+ECS_COMPONENT_DECLARE(TextureFile);
+ECS_COMPONENT_DECLARE(TextureStreaming);
+ECS_COMPONENT_DECLARE(StreamedTexture);
 ECS_COMPONENT_DECLARE(Camera2D);
 ECS_COMPONENT_DECLARE(Camera3D);
 ECS_COMPONENT_DECLARE(Color);
 ECS_COMPONENT_DECLARE(ClearColor);
+ECS_COMPONENT_DECLARE(LevelOfDetail);
+ECS_COMPONENT_DECLARE(OcclusionCulling);
+ECS_COMPONENT_DECLARE(OcclusionQuery);
+ECS_COMPONENT_DECLARE(OccluderGeometry);
+ECS_COMPONENT_DECLARE(SoftwareOcclusion);
+ECS_COMPONENT_DECLARE(GpuFrameTime);
+ECS_COMPONENT_DECLARE(GpuTime);
+ECS_COMPONENT_DECLARE(RenderStats);
+ECS_COMPONENT_DECLARE(ShaderProgramStats);
+ECS_COMPONENT_DECLARE(NullBackendStats);
+ECS_COMPONENT_DECLARE(FrameCapture);
+ECS_COMPONENT_DECLARE(RenderOnDemand);
+ECS_COMPONENT_DECLARE(FramePacing);
+ECS_COMPONENT_DECLARE(RenderThread);
+ECS_COMPONENT_DECLARE(CommandStream);
 
 ECS_TAG_DECLARE(Uses);
+ECS_TAG_DECLARE(Occluder);
+
+#pragma region Command stream
+// Render doesn't call OpenGL itself, it records plain data commands that execute_commands() replays later, on the
+// thread that has the context. Each command is a gli_command_t followed by its arguments, padded to 8 bytes.
+typedef enum gli_command_type_t {
+  GLI_COMMAND_CLEAR,
+  GLI_COMMAND_USE_PROGRAM,
+  GLI_COMMAND_BIND_VERTEX_ARRAY,
+  GLI_COMMAND_BIND_TEXTURE,
+  GLI_COMMAND_UPDATE_BUILT_INS,
+  GLI_COMMAND_UNIFORM_UPLOADS,
+  GLI_COMMAND_SET_UNIFORMS,
+  GLI_COMMAND_BEGIN_QUERY,
+  GLI_COMMAND_END_QUERY,
+  GLI_COMMAND_BEGIN_CONDITIONAL_RENDER,
+  GLI_COMMAND_END_CONDITIONAL_RENDER,
+  GLI_COMMAND_DRAW,
+} gli_command_type_t;
+
+typedef struct gli_command_t {
+  // The type is actually gli_command_type_t. The size includes this header and the padding.
+  uint16_t type, size;
+} gli_command_t;
+
+// The arguments of GLI_COMMAND_UNIFORM_UPLOADS, followed by the uniform shadow of the program and the uploads, which
+// the GLI_COMMAND_SET_UNIFORMS after it use until the next one. Those only hold the values, one after the other.
+typedef struct gli_uploads_command_t {
+  int32_t count;
+} gli_uploads_command_t;
+
+// The shadow and the function pointers of the uploads must be aligned.
+static_assert((sizeof(gli_command_t) + sizeof(gli_uploads_command_t)) % 8 == 0, "Uploads are misaligned!");
+
+// The arguments of GLI_COMMAND_BEGIN_QUERY and GLI_COMMAND_END_QUERY.
+typedef struct gli_query_command_t {
+  GLenum target;
+  GLuint query;
+} gli_query_command_t;
+
+typedef struct gli_draw_command_t {
+  gli_primitive_t primitive;
+  int count, first_index;
+  // Zero when the mesh isn't indexed.
+  GLenum index_type;
+} gli_draw_command_t;
+
+typedef struct gli_command_buffer_t {
+  uint8_t* data;
+  size_t size, capacity;
+  int64_t count;
+} gli_command_buffer_t;
+
+// Where the commands of a program are in the buffer of a stage. The index is the place of the program in the results
+// of the query of Render.
+typedef struct gli_program_commands_t {
+  int32_t index;
+  size_t begin, end;
+} gli_program_commands_t;
+
+// What a stage recorded in Render, with the counts that it can't add to the singletons from a worker thread.
+typedef struct gli_recording_t {
+  gli_command_buffer_t commands;
+  // By increasing index.
+  gli_program_commands_t* programs;
+  int programs_count, programs_capacity;
+  // The next of the programs to execute.
+  int next_program;
+  RenderStats stats;
+  int occlusion_culled, software_tested, software_culled;
+} gli_recording_t;
+
+// Everything recorded for a frame: the commands of the main thread before Render, then those of each stage. Flecs
+// splits every table of programs among the stages, so the programs are executed one by one in the order of the query
+// rather than stage by stage.
+typedef struct gli_frame_commands_t {
+  gli_command_buffer_t main;
+  gli_recording_t* recordings;
+  int recordings_count;
+  // Counted by the last execution.
+  int uniform_calls, skipped_uniform_calls, texture_binds;
+  // While executing, zero when unknown.
+  GLuint bound_texture;
+} gli_frame_commands_t;
+
+// One frame is recorded while the other one may still be executed by a RenderThread.
+static gli_frame_commands_t frame_commands[2];
+static int recording_frame;
+
+// Appends a command and returns where its arguments go.
+static void* push_command(gli_command_buffer_t* buffer, const gli_command_type_t type, const size_t arguments_size) {
+  const size_t size = (sizeof(gli_command_t) + arguments_size + 7) & ~(size_t)7;
+  assert(size <= UINT16_MAX);
+  if (buffer->size + size > buffer->capacity) {
+    buffer->capacity = vkm_maxul(buffer->capacity * 2, vkm_maxul(buffer->size + size, 64 * 1024));
+    buffer->data = realloc(buffer->data, buffer->capacity);
+  }
+
+  gli_command_t* command = (gli_command_t*)(buffer->data + buffer->size);
+  command->type = (uint16_t)type;
+  command->size = (uint16_t)size;
+  buffer->size += size;
+  buffer->count++;
+  return command + 1;
+}
+
+static void record_command(
+  gli_command_buffer_t* buffer,
+  const gli_command_type_t type,
+  const void* arguments,
+  const size_t arguments_size
+) {
+  void* destination = push_command(buffer, type, arguments_size);
+  if (arguments_size) {
+    memcpy(destination, arguments, arguments_size);
+  }
+}
+
+// Records uniforms of a program, with the part of its shadow that they use, for the GLI_COMMAND_SET_UNIFORMS after it.
+static void record_uniform_uploads(
+  gli_command_buffer_t* buffer,
+  const gli_uniform_upload_t* uploads,
+  const int count,
+  uint8_t* shadow
+) {
+  const size_t uploads_size = count * sizeof(gli_uniform_upload_t);
+  uint8_t* arguments = push_command(
+    buffer,
+    GLI_COMMAND_UNIFORM_UPLOADS,
+    sizeof(gli_uploads_command_t) + sizeof(uint8_t*) + uploads_size
+  );
+  memcpy(arguments, &(gli_uploads_command_t){ .count = count }, sizeof(gli_uploads_command_t));
+  arguments += sizeof(gli_uploads_command_t);
+  *(uint8_t**)arguments = shadow;
+  memcpy(arguments + sizeof(uint8_t*), uploads, uploads_size);
+}
+
+static void clear_commands(gli_command_buffer_t* buffer) {
+  buffer->size = 0;
+  buffer->count = 0;
+}
+
+// Makes room for the recordings of every stage, on the main thread before Render.
+static void prepare_recordings(gli_frame_commands_t* frame, const int stages_count) {
+  if (frame->recordings_count < stages_count) {
+    frame->recordings = realloc(frame->recordings, stages_count * sizeof(gli_recording_t));
+    memset(
+      frame->recordings + frame->recordings_count,
+      0,
+      (stages_count - frame->recordings_count) * sizeof(gli_recording_t)
+    );
+    frame->recordings_count = stages_count;
+  }
+}
+
+// Marks where the commands of a program end, from the place it has in the query of Render.
+static void record_program(gli_recording_t* recording, const int32_t index, const size_t begin) {
+  if (recording->programs_count == recording->programs_capacity) {
+    recording->programs_capacity = vkm_maxi(recording->programs_capacity * 2, 16);
+    recording->programs = realloc(recording->programs, recording->programs_capacity * sizeof(gli_program_commands_t));
+  }
+  recording->programs[recording->programs_count++] = (gli_program_commands_t){
+    .index = index,
+    .begin = begin,
+    .end = recording->commands.size,
+  };
+}
+
+static void clear_frame_commands(gli_frame_commands_t* frame) {
+  clear_commands(&frame->main);
+  for (int i = 0; i < frame->recordings_count; i++) {
+    clear_commands(&frame->recordings[i].commands);
+    frame->recordings[i].programs_count = 0;
+  }
+}
+
+static void free_frame_commands(void) {
+  for (int i = 0; i < 2; i++) {
+    free(frame_commands[i].main.data);
+    for (int j = 0; j < frame_commands[i].recordings_count; j++) {
+      free(frame_commands[i].recordings[j].commands.data);
+      free(frame_commands[i].recordings[j].programs);
+    }
+    free(frame_commands[i].recordings);
+    frame_commands[i] = (gli_frame_commands_t){ 0 };
+  }
+}
+
+// The upload functions for each type of uniform, picked from when the program is linked.
+static void upload_int(const GLint location, const void* value) {
+  glUniform1iv(location, 1, value);
+}
+
+static void upload_uint(const GLint location, const void* value) {
+  glUniform1uiv(location, 1, value);
+}
+
+static void upload_float(const GLint location, const void* value) {
+  glUniform1fv(location, 1, value);
+}
+
+static void upload_ivec2(const GLint location, const void* value) {
+  glUniform2iv(location, 1, value);
+}
+
+static void upload_uvec2(const GLint location, const void* value) {
+  glUniform2uiv(location, 1, value);
+}
+
+static void upload_vec2(const GLint location, const void* value) {
+  glUniform2fv(location, 1, value);
+}
+
+static void upload_ivec3(const GLint location, const void* value) {
+  glUniform3iv(location, 1, value);
+}
+
+static void upload_uvec3(const GLint location, const void* value) {
+  glUniform3uiv(location, 1, value);
+}
+
+static void upload_vec3(const GLint location, const void* value) {
+  glUniform3fv(location, 1, value);
+}
+
+static void upload_ivec4(const GLint location, const void* value) {
+  glUniform4iv(location, 1, value);
+}
+
+static void upload_uvec4(const GLint location, const void* value) {
+  glUniform4uiv(location, 1, value);
+}
+
+static void upload_vec4(const GLint location, const void* value) {
+  glUniform4fv(location, 1, value);
+}
+
+static void upload_mat4(const GLint location, const void* value) {
+  glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+static const gli_upload_uniform_t uniform_uploads[] = {
+  [GLI_INT]   = upload_int,
+  [GLI_UINT]  = upload_uint,
+  [GLI_FLOAT] = upload_float,
+  [GLI_IVEC2] = upload_ivec2,
+  [GLI_UVEC2] = upload_uvec2,
+  [GLI_VEC2]  = upload_vec2,
+  [GLI_IVEC3] = upload_ivec3,
+  [GLI_UVEC3] = upload_uvec3,
+  [GLI_VEC3]  = upload_vec3,
+  [GLI_IVEC4] = upload_ivec4,
+  [GLI_UVEC4] = upload_uvec4,
+  [GLI_VEC4]  = upload_vec4,
+  [GLI_MAT4]  = upload_mat4,
+};
+
+// Executes the commands of the buffer from begin to end.
+static void execute_commands(
+  gli_frame_commands_t* frame,
+  const gli_command_buffer_t* buffer,
+  const size_t begin,
+  const size_t end
+) {
+  const gli_uniform_upload_t* uploads = NULL;
+  int uploads_count = 0;
+  uint8_t* uniform_shadow = NULL;
+
+  for (size_t offset = begin; offset < end;) {
+    const gli_command_t* command = (const gli_command_t*)(buffer->data + offset);
+    const void* arguments = command + 1;
+    offset += command->size;
+
+    switch ((gli_command_type_t)command->type) {
+      case GLI_COMMAND_CLEAR: {
+        const ClearColor* color = arguments;
+        glClearColor(color->r, color->g, color->b, color->a);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        break;
+      }
+      case GLI_COMMAND_USE_PROGRAM:
+        glUseProgram(*(const GLuint*)arguments);
+        break;
+      case GLI_COMMAND_BIND_VERTEX_ARRAY:
+        glBindVertexArray(*(const GLuint*)arguments);
+        break;
+      case GLI_COMMAND_BIND_TEXTURE:
+        // Programs sharing an atlas leave it bound for each other.
+        if (*(const GLuint*)arguments != frame->bound_texture) {
+          frame->bound_texture = *(const GLuint*)arguments;
+          glBindTexture(GL_TEXTURE_2D_ARRAY, frame->bound_texture);
+          frame->texture_binds++;
+        }
+        break;
+      case GLI_COMMAND_UPDATE_BUILT_INS:
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(built_ins_t), arguments, GL_STREAM_DRAW);
+        break;
+      case GLI_COMMAND_UNIFORM_UPLOADS: {
+        const uint8_t* shadow = (const uint8_t*)((const gli_uploads_command_t*)arguments + 1);
+        uploads_count = ((const gli_uploads_command_t*)arguments)->count;
+        uniform_shadow = *(uint8_t* const*)shadow;
+        uploads = (const gli_uniform_upload_t*)(shadow + sizeof(uint8_t*));
+        break;
+      }
+      case GLI_COMMAND_SET_UNIFORMS: {
+        // Neighbouring entities, and the same entity from a frame to the next, often have the same values.
+        const uint8_t* value = arguments;
+        uint8_t* shadow = uniform_shadow;
+        for (int k = 0; k < uploads_count; k++) {
+          const int size = uploads[k].size;
+          if (memcmp(shadow, value, size) == 0) {
+            frame->skipped_uniform_calls++;
+          } else {
+            memcpy(shadow, value, size);
+            uploads[k].upload(uploads[k].location, value);
+            frame->uniform_calls++;
+          }
+          value += size;
+          shadow += size;
+        }
+        break;
+      }
+#ifndef GLI_EMSCRIPTEN
+      case GLI_COMMAND_BEGIN_QUERY: {
+        const gli_query_command_t* query = arguments;
+        glBeginQuery(query->target, query->query);
+        break;
+      }
+      case GLI_COMMAND_END_QUERY:
+        glEndQuery(((const gli_query_command_t*)arguments)->target);
+        break;
+      case GLI_COMMAND_BEGIN_CONDITIONAL_RENDER:
+        glBeginConditionalRender(*(const GLuint*)arguments, GL_QUERY_NO_WAIT);
+        break;
+      case GLI_COMMAND_END_CONDITIONAL_RENDER:
+        glEndConditionalRender();
+        break;
+#endif
+      case GLI_COMMAND_DRAW: {
+        const gli_draw_command_t* draw = arguments;
+        if (draw->index_type) {
+          const size_t index_size = draw->index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned);
+          glDrawElements(
+            draw->primitive - 1,
+            draw->count,
+            draw->index_type,
+            (const GLvoid*)(draw->first_index * index_size)
+          );
+        } else {
+          glDrawArrays(draw->primitive - 1, 0, draw->count);
+        }
+        break;
+      }
+      default:
+        assert(false);
+    }
+  }
+}
+
+static void execute_frame_commands(gli_frame_commands_t* frame) {
+  frame->uniform_calls = frame->skipped_uniform_calls = frame->texture_binds = 0;
+  // Textures are bound outside of the commands too, when uploading.
+  frame->bound_texture = 0;
+  glBindBuffer(GL_UNIFORM_BUFFER, built_ins_uniform_buffer);
+  execute_commands(frame, &frame->main, 0, frame->main.size);
+
+  for (int i = 0; i < frame->recordings_count; i++) {
+    frame->recordings[i].next_program = 0;
+  }
+  // Merge the programs of the stages by index. There are only as many stages as threads.
+  while (true) {
+    gli_recording_t* next = NULL;
+    for (int i = 0; i < frame->recordings_count; i++) {
+      gli_recording_t* recording = frame->recordings + i;
+      if (recording->next_program < recording->programs_count && (
+        !next || recording->programs[recording->next_program].index < next->programs[next->next_program].index
+      )) {
+        next = recording;
+      }
+    }
+    if (!next) {
+      break;
+    }
+    const gli_program_commands_t* program = next->programs + next->next_program++;
+    execute_commands(frame, &next->commands, program->begin, program->end);
+  }
+}
+#pragma endregion
+
+#pragma region Render thread
+// Whether RenderThread is there, making PostRenderFrame hand the commands over instead of executing them.
+static bool render_thread_enabled;
+// The window that the submitted commands are for, copied for its handles.
+static GLitchWindow submitted_window;
+
+static ecs_os_thread_t render_thread;
+static ecs_os_mutex_t render_thread_mutex;
+static ecs_os_cond_t render_thread_cond;
+// Protected by the mutex. The render thread has the context while a frame is submitted.
+static bool frame_submitted, render_thread_quit;
+// Only touched by the main thread.
+static bool context_on_main_thread = true;
+// In seconds, for the last frame.
+static double render_thread_wait, render_thread_draw;
+// Protected by the mutex, for the last frame that the render thread executed.
+static int render_thread_uniform_calls, render_thread_skipped_uniform_calls, render_thread_texture_binds;
+
+static void make_context_current(const GLitchWindow* window, const bool current) {
+#ifdef GLI_LINUX
+  if (window->egl_context) {
+    eglMakeCurrent(
+      window->egl_display,
+      current ? window->egl_surface : EGL_NO_SURFACE,
+      current ? window->egl_surface : EGL_NO_SURFACE,
+      current ? window->egl_context : EGL_NO_CONTEXT
+    );
+  } else if (window->context) {
+    glXMakeCurrent(window->display, current ? window->window : None, current ? window->context : NULL);
+  }
+#elif defined(GLI_WINDOWS)
+  if (window->context) {
+    wglMakeCurrent(current ? window->device_context_handle : NULL, current ? window->context : NULL);
+  }
+#else
+  (void)window;
+  (void)current;
+#endif
+}
+
+static void present_frame(const GLitchWindow* window) {
+#ifdef GLI_LINUX
+  if (window->backend == GLI_BACKEND_WINDOW) {
+    glXSwapBuffers(window->display, window->window);
+  }
+#elif defined(GLI_WINDOWS)
+  if (window->backend == GLI_BACKEND_WINDOW) {
+    SwapBuffers(window->device_context_handle);
+  }
+#elif defined(GLI_EMSCRIPTEN)
+  (void)window;
+#endif
+
+  GLenum error;
+  while ((error = glGetError()) != GL_NO_ERROR) {
+    fprintf(stderr, "OpenGL error 0x%x\n", error);
+  }
+}
+
+static void* render_thread_main(void* argument) {
+  (void)argument;
+
+  ecs_os_mutex_lock(render_thread_mutex);
+  while (true) {
+    while (!frame_submitted && !render_thread_quit) {
+      ecs_os_cond_wait(render_thread_cond, render_thread_mutex);
+    }
+    if (render_thread_quit) {
+      break;
+    }
+    gli_frame_commands_t* frame = frame_commands + 1 - recording_frame;
+    ecs_os_mutex_unlock(render_thread_mutex);
+
+    ecs_time_t start = { 0 };
+    ecs_time_measure(&start);
+    make_context_current(&submitted_window, true);
+    execute_frame_commands(frame);
+    present_frame(&submitted_window);
+    make_context_current(&submitted_window, false);
+    const double draw = ecs_time_measure(&start);
+
+    ecs_os_mutex_lock(render_thread_mutex);
+    render_thread_draw = draw;
+    render_thread_uniform_calls = frame->uniform_calls;
+    render_thread_skipped_uniform_calls = frame->skipped_uniform_calls;
+    render_thread_texture_binds = frame->texture_binds;
+    frame_submitted = false;
+    ecs_os_cond_broadcast(render_thread_cond);
+  }
+  ecs_os_mutex_unlock(render_thread_mutex);
+  return NULL;
+}
+
+static void wait_for_render_thread(void) {
+  if (!render_thread) {
+    return;
+  }
+
+  ecs_time_t start = { 0 };
+  ecs_time_measure(&start);
+  ecs_os_mutex_lock(render_thread_mutex);
+  while (frame_submitted) {
+    ecs_os_cond_wait(render_thread_cond, render_thread_mutex);
+  }
+  ecs_os_mutex_unlock(render_thread_mutex);
+  render_thread_wait += ecs_time_measure(&start);
+}
+
+// Must be called before the main thread uses OpenGL. Waits for the render thread to execute the last submitted
+// commands, and takes the context back.
+static void acquire_context(void) {
+  if (context_on_main_thread) {
+    return;
+  }
+
+  wait_for_render_thread();
+  make_context_current(&submitted_window, true);
+  context_on_main_thread = true;
+}
+
+// Hands the recorded commands and the context to the render thread, starting it if needed.
+static void submit_commands(const GLitchWindow* window) {
+  wait_for_render_thread();
+
+  if (!render_thread) {
+    render_thread_mutex = ecs_os_mutex_new();
+    render_thread_cond = ecs_os_cond_new();
+    render_thread = ecs_os_thread_new(render_thread_main, NULL);
+  }
+
+  submitted_window = *window;
+  if (context_on_main_thread) {
+    make_context_current(window, false);
+    context_on_main_thread = false;
+  }
+
+  ecs_os_mutex_lock(render_thread_mutex);
+  recording_frame = 1 - recording_frame;
+  frame_submitted = true;
+  ecs_os_cond_broadcast(render_thread_cond);
+  ecs_os_mutex_unlock(render_thread_mutex);
+
+  // The other frame was executed already, so it can be recorded over.
+  clear_frame_commands(frame_commands + recording_frame);
+}
+
+static void stop_render_thread(void) {
+  if (render_thread) {
+    ecs_os_mutex_lock(render_thread_mutex);
+    render_thread_quit = true;
+    ecs_os_cond_broadcast(render_thread_cond);
+    ecs_os_mutex_unlock(render_thread_mutex);
+    ecs_os_thread_join(render_thread);
+    ecs_os_cond_free(render_thread_cond);
+    ecs_os_mutex_free(render_thread_mutex);
+    render_thread = 0;
+    render_thread_quit = frame_submitted = false;
+  }
+
+  if (!context_on_main_thread) {
+    make_context_current(&submitted_window, true);
+    context_on_main_thread = true;
+  }
+}
+
+static void OnAddRenderThread(ecs_iter_t* it) {
+  (void)it;
+  render_thread_enabled = true;
+}
+
+static void OnRemoveRenderThread(ecs_iter_t* it) {
+  (void)it;
+  stop_render_thread();
+  render_thread_enabled = false;
+}
+#pragma endregion
+
+static void free_shader_inputs(const ShaderProgram* shader_program) {
+  for (int j = 0; j < shader_program->uniforms_count; j++) {
+    free(shader_program->uniforms[j].name);
+  }
+  free(shader_program->uniforms);
+  for (int j = 0; j < shader_program->attributes_count; j++) {
+    free(shader_program->attributes[j].name);
+  }
+  free(shader_program->attributes);
+  free(shader_program->uniform_shadow);
+}
 
 ECS_CTOR(GLitchWindow, ptr, {
   *ptr = (GLitchWindow){ 0 };
@@ -200,36 +1029,158 @@ ECS_CTOR(MeshData, ptr, {
   *ptr = (MeshData){ 0 };
 })
 
+static void release_mesh_data(const MeshData* mesh_data) {
+  if (mesh_data->release) {
+    mesh_data->release(mesh_data->data, mesh_data->indices, mesh_data->release_context);
+  } else {
+    // Owned, so only read-only for those that borrow it.
+    free((void*)mesh_data->data);
+    free((void*)mesh_data->indices);
+  }
+}
+
+void gli_keep_mesh_data(const void* data, const unsigned* indices, void* context) {
+  (void)data;
+  (void)indices;
+  (void)context;
+}
+
 ECS_MOVE(MeshData, dst, src, {
-  free(dst->data);
-  free(dst->indices);
+  release_mesh_data(dst);
   *dst = *src;
   *src = (MeshData){ 0 };
 })
 
 ECS_DTOR(MeshData, ptr, {
-  free(ptr->data);
-  free(ptr->indices);
+  release_mesh_data(ptr);
   *ptr = (MeshData){ 0 };
 })
 
+// Meshes without vertex attributes all share the same vertex array, which stays.
+static void delete_mesh(const Mesh* mesh) {
+  if (mesh->vertex_buffer || mesh->index_buffer || mesh->vertex_array) {
+    acquire_context();
+    glDeleteBuffers(1, &mesh->vertex_buffer);
+    glDeleteBuffers(1, &mesh->index_buffer);
+    if (mesh->vertex_array != attributeless_vertex_array) {
+      glDeleteVertexArrays(1, &mesh->vertex_array);
+    }
+  }
+}
+
 ECS_CTOR(Mesh, ptr, {
   *ptr = (Mesh){ 0 };
 })
 
 ECS_MOVE(Mesh, dst, src, {
-  glDeleteBuffers(1, &dst->vertex_buffer);
-  glDeleteVertexArrays(1, &dst->vertex_array);
+  delete_mesh(dst);
   *dst = *src;
   *src = (Mesh){ 0 };
 })
 
 ECS_DTOR(Mesh, ptr, {
-  glDeleteBuffers(1, &ptr->vertex_buffer);
-  glDeleteVertexArrays(1, &ptr->vertex_array);
+  delete_mesh(ptr);
   *ptr = (Mesh){ 0 };
 })
 
+ECS_CTOR(TextureAtlas, ptr, {
+  *ptr = (TextureAtlas){ 0 };
+})
+
+ECS_MOVE(TextureAtlas, dst, src, {
+  if (dst->texture) {
+    acquire_context();
+    glDeleteTextures(1, &dst->texture);
+  }
+  *dst = *src;
+  *src = (TextureAtlas){ 0 };
+})
+
+ECS_DTOR(TextureAtlas, ptr, {
+  if (ptr->texture) {
+    acquire_context();
+    glDeleteTextures(1, &ptr->texture);
+  }
+  *ptr = (TextureAtlas){ 0 };
+})
+
+ECS_CTOR(ImageData, ptr, {
+  *ptr = (ImageData){ 0 };
+})
+
+ECS_MOVE(ImageData, dst, src, {
+  free(dst->pixels);
+  *dst = *src;
+  *src = (ImageData){ 0 };
+})
+
+ECS_DTOR(ImageData, ptr, {
+  free(ptr->pixels);
+  *ptr = (ImageData){ 0 };
+})
+
+ECS_CTOR(TextureFile, ptr, {
+  *ptr = (TextureFile){ 0 };
+})
+
+ECS_MOVE(TextureFile, dst, src, {
+  free(dst->path);
+  *dst = *src;
+  *src = (TextureFile){ 0 };
+})
+
+ECS_DTOR(TextureFile, ptr, {
+  free(ptr->path);
+  *ptr = (TextureFile){ 0 };
+})
+
+ECS_CTOR(ModelFile, ptr, {
+  *ptr = (ModelFile){ 0 };
+})
+
+ECS_MOVE(ModelFile, dst, src, {
+  free(dst->path);
+  *dst = *src;
+  *src = (ModelFile){ 0 };
+})
+
+ECS_DTOR(ModelFile, ptr, {
+  free(ptr->path);
+  *ptr = (ModelFile){ 0 };
+})
+
+ECS_CTOR(MeshFile, ptr, {
+  *ptr = (MeshFile){ 0 };
+})
+
+ECS_MOVE(MeshFile, dst, src, {
+  free(dst->path);
+  *dst = *src;
+  *src = (MeshFile){ 0 };
+})
+
+ECS_DTOR(MeshFile, ptr, {
+  free(ptr->path);
+  *ptr = (MeshFile){ 0 };
+})
+
+ECS_CTOR(DynamicMesh, ptr, {
+  *ptr = (DynamicMesh){ 0 };
+})
+
+ECS_MOVE(DynamicMesh, dst, src, {
+  free(dst->data);
+  free(dst->indices);
+  *dst = *src;
+  *src = (DynamicMesh){ 0 };
+})
+
+ECS_DTOR(DynamicMesh, ptr, {
+  free(ptr->data);
+  free(ptr->indices);
+  *ptr = (DynamicMesh){ 0 };
+})
+
 ECS_CTOR(ShaderProgramSource, ptr, {
   *ptr = (ShaderProgramSource){ 0 };
 })
@@ -237,6 +1188,8 @@ ECS_CTOR(ShaderProgramSource, ptr, {
 ECS_MOVE(ShaderProgramSource, dst, src, {
   free(dst->vertex_shader);
   free(dst->fragment_shader);
+  free(dst->vertex_shader_path);
+  free(dst->fragment_shader_path);
   *dst = *src;
   *src = (ShaderProgramSource){ 0 };
 })
@@ -244,6 +1197,8 @@ ECS_MOVE(ShaderProgramSource, dst, src, {
 ECS_DTOR(ShaderProgramSource, ptr, {
   free(ptr->vertex_shader);
   free(ptr->fragment_shader);
+  free(ptr->vertex_shader_path);
+  free(ptr->fragment_shader_path);
   *ptr = (ShaderProgramSource){ 0 };
 })
 
@@ -253,21 +1208,24 @@ ECS_CTOR(ShaderProgram, ptr, {
 
 ECS_MOVE(ShaderProgram, dst, src, {
   free(dst->uniforms);
-  glDeleteProgram(dst->program);
+  if (dst->program || dst->pending_program) {
+    acquire_context();
+    glDeleteProgram(dst->program);
+    glDeleteProgram(dst->pending_program);
+  }
+  free(dst->uniform_shadow);
   *dst = *src;
   *src = (ShaderProgram){ 0 };
 })
 
 ECS_DTOR(ShaderProgram, ptr, {
-  for (int j = 0; j < ptr->uniforms_count; j++) {
-    free(ptr->uniforms[j].name);
+  if (ptr->program || ptr->pending_program) {
+    acquire_context();
+    glDeleteProgram(ptr->program);
+    glDeleteProgram(ptr->pending_program);
   }
-  free(ptr->uniforms);
-  for (int j = 0; j < ptr->attributes_count; j++) {
-    free(ptr->attributes[j].name);
-  }
-  free(ptr->attributes);
-  glDeleteProgram(ptr->program);
+  // After the render thread is done with the shadow.
+  free_shader_inputs(ptr);
   *ptr = (ShaderProgram){ 0 };
 })
 
@@ -297,15 +1255,136 @@ ECS_CTOR(ClearColor, ptr, {
   *ptr = (ClearColor){ { 0.0f, 0.0f, 0.0f, 1.0f } };
 })
 
-static GLuint compile_shader(const GLenum type, const char* source) {
-  const GLuint shader = glCreateShader(type);
-  static const char* shader_copypasta =
-#ifdef GLI_EMSCRIPTEN
-    "#version 300 es\n"
-    "precision highp float;\n"
-#else
-    "#version 330 core\n"
-#endif
+ECS_CTOR(LevelOfDetail, ptr, {
+  *ptr = (LevelOfDetail){ .max_screen_error = 1.0f };
+})
+
+// Queries are made lazily, so some may be missing.
+static void delete_queries(const int count, const GLuint* queries) {
+  for (int i = 0; i < count; i++) {
+    if (queries[i]) {
+      acquire_context();
+      glDeleteQueries(1, queries + i);
+    }
+  }
+}
+
+ECS_CTOR(OcclusionQuery, ptr, {
+  *ptr = (OcclusionQuery){ .visible = true };
+})
+
+ECS_MOVE(OcclusionQuery, dst, src, {
+  delete_queries(1, &dst->query);
+  *dst = *src;
+  *src = (OcclusionQuery){ 0 };
+})
+
+ECS_DTOR(OcclusionQuery, ptr, {
+  delete_queries(1, &ptr->query);
+  *ptr = (OcclusionQuery){ 0 };
+})
+
+ECS_CTOR(GpuFrameTime, ptr, {
+  *ptr = (GpuFrameTime){ 0 };
+})
+
+ECS_MOVE(GpuFrameTime, dst, src, {
+  delete_queries(GLI_GPU_TIMER_FRAMES, dst->clear_queries);
+  delete_queries(GLI_GPU_TIMER_FRAMES, dst->start_queries);
+  delete_queries(GLI_GPU_TIMER_FRAMES, dst->end_queries);
+  *dst = *src;
+  *src = (GpuFrameTime){ 0 };
+})
+
+ECS_DTOR(GpuFrameTime, ptr, {
+  delete_queries(GLI_GPU_TIMER_FRAMES, ptr->clear_queries);
+  delete_queries(GLI_GPU_TIMER_FRAMES, ptr->start_queries);
+  delete_queries(GLI_GPU_TIMER_FRAMES, ptr->end_queries);
+  *ptr = (GpuFrameTime){ 0 };
+})
+
+ECS_CTOR(GpuTime, ptr, {
+  *ptr = (GpuTime){ 0 };
+})
+
+ECS_MOVE(GpuTime, dst, src, {
+  delete_queries(GLI_GPU_TIMER_FRAMES, dst->queries);
+  *dst = *src;
+  *src = (GpuTime){ 0 };
+})
+
+ECS_DTOR(GpuTime, ptr, {
+  delete_queries(GLI_GPU_TIMER_FRAMES, ptr->queries);
+  *ptr = (GpuTime){ 0 };
+})
+
+ECS_CTOR(OccluderGeometry, ptr, {
+  *ptr = (OccluderGeometry){ 0 };
+})
+
+ECS_MOVE(OccluderGeometry, dst, src, {
+  free(dst->positions);
+  free(dst->indices);
+  *dst = *src;
+  *src = (OccluderGeometry){ 0 };
+})
+
+ECS_DTOR(OccluderGeometry, ptr, {
+  free(ptr->positions);
+  free(ptr->indices);
+  *ptr = (OccluderGeometry){ 0 };
+})
+
+static void delete_frame_capture(FrameCapture* capture) {
+  for (int i = 0; i < GLI_CAPTURE_FRAMES; i++) {
+    if (capture->buffers[i] || capture->fences[i]) {
+      acquire_context();
+    }
+    if (capture->buffers[i]) {
+      glDeleteBuffers(1, capture->buffers + i);
+    }
+    if (capture->fences[i]) {
+      glDeleteSync(capture->fences[i]);
+    }
+  }
+  free(capture->pixels);
+}
+
+ECS_CTOR(FrameCapture, ptr, {
+  *ptr = (FrameCapture){ 0 };
+})
+
+// Only the settings are copied, the copy starts capturing anew.
+ECS_COPY(FrameCapture, dst, src, {
+  delete_frame_capture(dst);
+  *dst = (FrameCapture){
+    .format = src->format,
+    .callback = src->callback,
+    .callback_context = src->callback_context,
+  };
+})
+
+ECS_MOVE(FrameCapture, dst, src, {
+  delete_frame_capture(dst);
+  *dst = *src;
+  *src = (FrameCapture){ 0 };
+})
+
+ECS_DTOR(FrameCapture, ptr, {
+  delete_frame_capture(ptr);
+  *ptr = (FrameCapture){ 0 };
+})
+
+static GLuint create_shader(const GLenum type, const char* source) {
+  const GLuint shader = glCreateShader(type);
+  static const char* shader_copypasta =
+#ifdef GLI_EMSCRIPTEN
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "precision highp sampler2DArray;\n"
+#else
+    "#version 330 core\n"
+#endif
     "layout(std140) uniform built_ins {\n"
     "  mat4 model, view, projection;\n"
     "  vec2 resolution;\n"
@@ -315,13 +1394,24 @@ static GLuint compile_shader(const GLenum type, const char* source) {
   const char* sources[2] = { shader_copypasta, source };
   glShaderSource(shader, 2, sources, NULL);
   glCompileShader(shader);
+  return shader;
+}
 
+static bool check_shader(const GLuint shader) {
   GLint success;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
   if (!success) {
     char info_log[1000];
     glGetShaderInfoLog(shader, sizeof(info_log), NULL, info_log);
     fprintf(stderr, "Shader compilation failed: %s\n", info_log);
+  }
+
+  return success;
+}
+
+static GLuint compile_shader(const GLenum type, const char* source) {
+  const GLuint shader = create_shader(type, source);
+  if (!check_shader(shader)) {
     glDeleteShader(shader);
     return 0;
   }
@@ -329,6 +1419,89 @@ static GLuint compile_shader(const GLenum type, const char* source) {
   return shader;
 }
 
+static bool check_program(const GLuint program) {
+  GLint success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    // Programs linked in the background didn't get their shaders checked, so the reason may be there.
+    GLuint shaders[2];
+    GLsizei count;
+    glGetAttachedShaders(program, GLI_COUNTOF(shaders), &count, shaders);
+    for (int i = 0; i < count; i++) {
+      check_shader(shaders[i]);
+    }
+
+    char info_log[1000];
+    glGetProgramInfoLog(program, sizeof(info_log), NULL, info_log);
+    fprintf(stderr, "Program linking failed: %s\n", info_log);
+  }
+
+  return success;
+}
+
+// Returns a zero-terminated buffer with the contents of the file, to be freed by the caller, or NULL on failure.
+static char* read_file(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s.\n", path);
+    return NULL;
+  }
+
+  char* buffer = NULL;
+  long size;
+  if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+    buffer = malloc(size + 1);
+    if (fread(buffer, 1, size, file) == (size_t)size) {
+      buffer[size] = '\0';
+    } else {
+      free(buffer);
+      buffer = NULL;
+    }
+  }
+
+  if (!buffer) {
+    fprintf(stderr, "Cannot read %s.\n", path);
+  }
+
+  fclose(file);
+  return buffer;
+}
+
+// The file takes precedence if there is one. The returned buffer must be freed by the caller.
+static char* load_shader_source(const char* source, const char* path) {
+  if (path) {
+    return read_file(path);
+  }
+
+  return source ? strdup(source) : NULL;
+}
+
+// Starts compiling and linking a new program without waiting for the results, which may happen in the background if the
+// driver supports it. Those must be checked with check_program() before using the program. Returns 0 on failure.
+static GLuint start_linking_program(const ShaderProgramSource* source) {
+  char* vertex_shader_source = load_shader_source(source->vertex_shader, source->vertex_shader_path);
+  char* fragment_shader_source = load_shader_source(source->fragment_shader, source->fragment_shader_path);
+
+  GLuint program = 0;
+  if (vertex_shader_source && fragment_shader_source) {
+    program = glCreateProgram();
+
+    const GLuint vertex_shader = create_shader(GL_VERTEX_SHADER, vertex_shader_source);
+    const GLuint fragment_shader = create_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    // They are only flagged for deletion while attached, so they go away along with the program.
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    glLinkProgram(program);
+  }
+
+  free(vertex_shader_source);
+  free(fragment_shader_source);
+  return program;
+}
+
 typedef struct gli_type_info_t {
   GLenum type;
   short vector_components, size;
@@ -363,367 +1536,5533 @@ static gli_type_info_t type_infos[] = {
   [GLI_IVEC4]  = { .type = GL_INT,            .vector_components = 4, .size = 16 },
   [GLI_UVEC4]  = { .type = GL_UNSIGNED_INT,   .vector_components = 4, .size = 16 },
   [GLI_VEC4]   = { .type = GL_FLOAT,          .vector_components = 4, .size = 16 },
+  [GLI_MAT4]   = { .type = GL_FLOAT,          .vector_components = 16, .size = 64 },
 };
 
-static void MakeMeshes(ecs_iter_t* it) {
-  const MeshData* mesh_datas = ecs_field(it, MeshData, 0);
+#pragma region Render stats
+// Counts for the frame in progress, published to RenderStats at the end of it.
+static RenderStats frame_stats;
+
+static void add_render_stats(RenderStats* stats, const RenderStats* other) {
+  stats->draw_calls += other->draw_calls;
+  stats->instances += other->instances;
+  stats->triangles += other->triangles;
+  stats->vertices += other->vertices;
+  stats->program_binds += other->program_binds;
+  stats->vertex_array_binds += other->vertex_array_binds;
+  stats->buffer_binds += other->buffer_binds;
+  stats->texture_binds += other->texture_binds;
+  stats->uniform_values += other->uniform_values;
+  stats->tables += other->tables;
+  stats->uploaded_bytes += other->uploaded_bytes;
+}
+
+static void count_draw(RenderStats* stats, const gli_primitive_t primitive, const int vertices_count) {
+  stats->draw_calls++;
+  stats->instances++;
+  stats->vertices += vertices_count;
+  switch (primitive) {
+    case GLI_TRIANGLES:
+      stats->triangles += vertices_count / 3;
+      break;
+    case GLI_TRIANGLE_STRIP:
+    case GLI_TRIANGLE_FAN:
+      stats->triangles += vertices_count > 2 ? vertices_count - 2 : 0;
+      break;
+    default:
+      break;
+  }
+}
+
+static void AddShaderProgramStats(ecs_iter_t* it) {
+  for (int i = 0; i < it->count; i++) {
+    ecs_add(it->world, it->entities[i], ShaderProgramStats);
+  }
+}
+
+static void OnRemoveRenderStats(ecs_iter_t* it) {
+  ecs_remove_all(it->world, ecs_id(ShaderProgramStats));
+}
+
+// Describes the members for both RenderStats and ShaderProgramStats.
+static void render_stats_struct(ecs_world_t* world, const ecs_entity_t entity) {
+  ecs_struct(world, {
+    .entity = entity,
+    .members = {
+      { .name = "draw_calls", .type = ecs_id(ecs_i32_t), .offset = offsetof(RenderStats, draw_calls) },
+      { .name = "instances", .type = ecs_id(ecs_i32_t), .offset = offsetof(RenderStats, instances) },
+      { .name = "triangles", .type = ecs_id(ecs_i32_t), .offset = offsetof(RenderStats, triangles) },
+      { .name = "vertices", .type = ecs_id(ecs_i32_t), .offset = offsetof(RenderStats, vertices) },
+      { .name = "program_binds", .type = ecs_id(ecs_i32_t), .offset = offsetof(RenderStats, program_binds) },
+      { .name = "vertex_array_binds", .type = ecs_id(ecs_i32_t), .offset = offsetof(RenderStats, vertex_array_binds) },
+      { .name = "buffer_binds", .type = ecs_id(ecs_i32_t), .offset = offsetof(RenderStats, buffer_binds) },
+      { .name = "texture_binds", .type = ecs_id(ecs_i32_t), .offset = offsetof(RenderStats, texture_binds) },
+      { .name = "uniform_values", .type = ecs_id(ecs_i32_t), .offset = offsetof(RenderStats, uniform_values) },
+      { .name = "tables", .type = ecs_id(ecs_i32_t), .offset = offsetof(RenderStats, tables) },
+      {
+        .name = "uploaded_bytes",
+        .type = ecs_id(ecs_i64_t),
+        .offset = offsetof(RenderStats, uploaded_bytes),
+        .unit = EcsBytes,
+      },
+    },
+  });
+}
+#pragma endregion
+
+#pragma region Null backend
+#if defined(GLI_LINUX) || defined(GLI_WINDOWS)
+// Whether the OpenGL functions are the stubs below, see GLI_BACKEND_NULL.
+static bool null_backend;
+static NullBackendStats null_stats;
+
+#define GLI_NULL_MAX_NAME 64
+
+typedef struct gli_null_variable_t {
+  char name[GLI_NULL_MAX_NAME];
+  GLenum type;
+  GLint location;
+} gli_null_variable_t;
+
+// What the stubs remember about shaders and programs, to fake compilation and reflection.
+typedef struct gli_null_object_t {
+  GLenum shader_type;
+  char* source;
+  GLuint shaders[2];
+  int shaders_count;
+  gli_null_variable_t* uniforms;
+  gli_null_variable_t* attributes;
+  int uniforms_count, attributes_count;
+} gli_null_object_t;
+
+// Indexed by name. All kinds of objects share the names, but only shaders and programs are stored here.
+static gli_null_object_t* null_objects;
+static GLuint null_objects_count, null_last_name;
+// Mapped buffers all share this memory, which never holds anything interesting.
+static void* null_mapped_memory;
+static GLsizeiptr null_mapped_size;
+
+static GLuint null_name(void) {
+  null_stats.objects++;
+  return ++null_last_name;
+}
+
+static GLuint null_create_object(void) {
+  const GLuint name = null_name();
+  if (name >= null_objects_count) {
+    const GLuint count = name * 2;
+    null_objects = realloc(null_objects, count * sizeof(gli_null_object_t));
+    memset(null_objects + null_objects_count, 0, (count - null_objects_count) * sizeof(gli_null_object_t));
+    null_objects_count = count;
+  }
+  return name;
+}
+
+static gli_null_object_t* null_object(const GLuint name) {
+  return name < null_objects_count ? null_objects + name : NULL;
+}
+
+static void null_delete_object(const GLuint name) {
+  gli_null_object_t* object = null_object(name);
+  if (object) {
+    free(object->source);
+    free(object->uniforms);
+    free(object->attributes);
+    *object = (gli_null_object_t){ 0 };
+  }
+}
+
+static void null_reset(void) {
+  for (GLuint i = 0; i < null_objects_count; i++) {
+    null_delete_object(i);
+  }
+  free(null_objects);
+  null_objects = NULL;
+  free(null_mapped_memory);
+  null_mapped_memory = NULL;
+  null_mapped_size = 0;
+  null_objects_count = null_last_name = 0;
+  null_stats = (NullBackendStats){ 0 };
+}
+
+// Reads the next identifier, number or punctuation character into token, skipping whitespace, comments and
+// preprocessor directives. Returns where it stopped, or NULL at the end of the source.
+static const char* null_next_token(const char* cursor, char token[GLI_NULL_MAX_NAME]) {
+  for (;;) {
+    while (isspace((unsigned char)*cursor)) {
+      cursor++;
+    }
+    if (*cursor == '#' || (cursor[0] == '/' && cursor[1] == '/')) {
+      while (*cursor && *cursor != '\n') {
+        cursor++;
+      }
+    } else if (cursor[0] == '/' && cursor[1] == '*') {
+      const char* end = strstr(cursor + 2, "*/");
+      cursor = end ? end + 2 : cursor + strlen(cursor);
+    } else {
+      break;
+    }
+  }
+
+  if (!*cursor) {
+    return NULL;
+  }
+
+  int length = 0;
+  if (isalnum((unsigned char)*cursor) || *cursor == '_') {
+    for (; isalnum((unsigned char)*cursor) || *cursor == '_'; cursor++) {
+      if (length < GLI_NULL_MAX_NAME - 1) {
+        token[length++] = *cursor;
+      }
+    }
+  } else {
+    token[length++] = *cursor++;
+  }
+  token[length] = '\0';
+  return cursor;
+}
+
+static GLenum null_type(const char* name) {
+  static const struct {
+    const char* name;
+    GLenum type;
+  } types[] = {
+    { "float", GL_FLOAT },
+    { "vec2", GL_FLOAT_VEC2 },
+    { "vec3", GL_FLOAT_VEC3 },
+    { "vec4", GL_FLOAT_VEC4 },
+    { "int", GL_INT },
+    { "ivec2", GL_INT_VEC2 },
+    { "ivec3", GL_INT_VEC3 },
+    { "ivec4", GL_INT_VEC4 },
+    { "uint", GL_UNSIGNED_INT },
+    { "uvec2", GL_UNSIGNED_INT_VEC2 },
+    { "uvec3", GL_UNSIGNED_INT_VEC3 },
+    { "uvec4", GL_UNSIGNED_INT_VEC4 },
+    { "mat4", GL_FLOAT_MAT4 },
+    { "sampler2DArray", GL_SAMPLER_2D_ARRAY },
+  };
+
+  for (unsigned i = 0; i < GLI_COUNTOF(types); i++) {
+    if (strcmp(name, types[i].name) == 0) {
+      return types[i].type;
+    }
+  }
+  return 0;
+}
+
+static bool null_is_qualifier(const char* token) {
+  static const char* qualifiers[] = {
+    "highp", "mediump", "lowp", "flat", "smooth", "noperspective", "centroid", "invariant",
+  };
+
+  for (unsigned i = 0; i < GLI_COUNTOF(qualifiers); i++) {
+    if (strcmp(token, qualifiers[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void null_add_variable(
+  gli_null_variable_t** variables,
+  int* count,
+  const char* name,
+  const GLenum type,
+  const GLint location
+) {
+  if (!type || !(isalpha((unsigned char)*name) || *name == '_')) {
+    return;
+  }
+  for (int i = 0; i < *count; i++) {
+    if (strcmp((*variables)[i].name, name) == 0) {
+      return;
+    }
+  }
+
+  *variables = realloc(*variables, (*count + 1) * sizeof(gli_null_variable_t));
+  gli_null_variable_t* variable = *variables + *count;
+  strcpy(variable->name, name);
+  variable->type = type;
+  variable->location = location >= 0 ? location : *count;
+  ++*count;
+}
+
+// Reads the names and types of a declaration up to its semicolon, skipping array sizes and initializers.
+static const char* null_read_declarators(
+  const char* cursor,
+  char token[GLI_NULL_MAX_NAME],
+  const GLenum type,
+  gli_null_variable_t** variables,
+  int* count,
+  const GLint location
+) {
+  bool skipping = false;
+  while ((cursor = null_next_token(cursor, token)) && strcmp(token, ";") != 0) {
+    if (strcmp(token, "=") == 0 || strcmp(token, "[") == 0) {
+      skipping = true;
+    } else if (strcmp(token, ",") == 0) {
+      skipping = false;
+    } else if (!skipping) {
+      null_add_variable(variables, count, token, type, location);
+    }
+  }
+  return cursor;
+}
+
+// Finds the uniforms and the vertex inputs declared in a shader, standing in for the reflection done by drivers.
+static void null_reflect_shader(gli_null_object_t* program, const gli_null_object_t* shader) {
+  char token[GLI_NULL_MAX_NAME], type_name[GLI_NULL_MAX_NAME];
+  int depth = 0;
+  GLint location = -1;
+  const char* cursor = shader->source;
+  while (cursor && (cursor = null_next_token(cursor, token))) {
+    if (strcmp(token, "{") == 0 || strcmp(token, "(") == 0) {
+      depth++;
+    } else if (strcmp(token, "}") == 0 || strcmp(token, ")") == 0) {
+      depth--;
+    } else if (depth == 0 && strcmp(token, "layout") == 0) {
+      // Only the location matters.
+      while ((cursor = null_next_token(cursor, token)) && strcmp(token, ")") != 0) {
+        if (strcmp(token, "location") == 0 && (cursor = null_next_token(cursor, token))) {
+          cursor = null_next_token(cursor, token);
+          location = cursor ? atoi(token) : -1;
+        }
+      }
+    } else if (depth == 0 && strcmp(token, "uniform") == 0) {
+      while ((cursor = null_next_token(cursor, type_name)) && null_is_qualifier(type_name)) {}
+      const char* after_type = cursor ? null_next_token(cursor, token) : NULL;
+      if (after_type && strcmp(token, "{") == 0) {
+        // Like drivers do, report the members of uniform blocks one by one.
+        cursor = after_type;
+        while ((cursor = null_next_token(cursor, type_name)) && strcmp(type_name, "}") != 0) {
+          cursor = null_read_declarators(
+            cursor,
+            token,
+            null_type(type_name),
+            &program->uniforms,
+            &program->uniforms_count,
+            -1
+          );
+        }
+      } else if (cursor) {
+        cursor = null_read_declarators(
+          cursor,
+          token,
+          null_type(type_name),
+          &program->uniforms,
+          &program->uniforms_count,
+          -1
+        );
+      }
+      location = -1;
+    } else if (depth == 0 && strcmp(token, "in") == 0 && shader->shader_type == GL_VERTEX_SHADER) {
+      while ((cursor = null_next_token(cursor, type_name)) && null_is_qualifier(type_name)) {}
+      if (cursor) {
+        cursor = null_read_declarators(
+          cursor,
+          token,
+          null_type(type_name),
+          &program->attributes,
+          &program->attributes_count,
+          location
+        );
+      }
+      location = -1;
+    } else if (strcmp(token, ";") == 0) {
+      location = -1;
+    }
+  }
+}
+
+static const gli_null_variable_t* null_find_variable(
+  const gli_null_variable_t* variables,
+  const int count,
+  const char* name
+) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(variables[i].name, name) == 0) {
+      return variables + i;
+    }
+  }
+  return NULL;
+}
+
+static void null_get_variable(
+  const gli_null_variable_t* variable,
+  const GLsizei buffer_size,
+  GLsizei* length,
+  GLint* size,
+  GLenum* type,
+  GLchar* name
+) {
+  if (!variable) {
+    return;
+  }
+  if (buffer_size > 0) {
+    strncpy(name, variable->name, buffer_size - 1);
+    name[buffer_size - 1] = '\0';
+  }
+  if (length) {
+    *length = (GLsizei)strlen(name);
+  }
+  *size = 1;
+  *type = variable->type;
+}
+
+static GLint null_max_length(const gli_null_variable_t* variables, const int count) {
+  GLint max_length = 1;
+  for (int i = 0; i < count; i++) {
+    max_length = vkm_maxi(max_length, (GLint)strlen(variables[i].name) + 1);
+  }
+  return max_length;
+}
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4100)
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+
+static void null_gen_names(const GLsizei n, GLuint* names) {
+  null_stats.calls++;
+  for (GLsizei i = 0; i < n; i++) {
+    names[i] = null_name();
+  }
+}
+
+static GLuint null_glCreateShader(GLenum shaderType) {
+  null_stats.calls++;
+  const GLuint shader = null_create_object();
+  null_objects[shader].shader_type = shaderType;
+  return shader;
+}
+
+static void null_glDeleteShader(GLuint shader) {
+  null_stats.calls++;
+  null_delete_object(shader);
+}
+
+static void null_glShaderSource(GLuint shader, GLsizei count, const GLchar** string, const GLint* length) {
+  null_stats.calls++;
+  gli_null_object_t* object = null_object(shader);
+  if (!object) {
+    return;
+  }
+
+  size_t total = 1;
+  for (GLsizei i = 0; i < count; i++) {
+    total += length && length[i] >= 0 ? (size_t)length[i] : strlen(string[i]);
+  }
+  free(object->source);
+  object->source = malloc(total);
+  size_t offset = 0;
+  for (GLsizei i = 0; i < count; i++) {
+    const size_t size = length && length[i] >= 0 ? (size_t)length[i] : strlen(string[i]);
+    memcpy(object->source + offset, string[i], size);
+    offset += size;
+  }
+  object->source[offset] = '\0';
+}
+
+static void null_glCompileShader(GLuint shader) {
+  null_stats.calls++;
+}
+
+static void null_glGetShaderiv(GLuint shader, GLenum pname, GLint* params) {
+  null_stats.calls++;
+  *params = pname == GL_COMPILE_STATUS || pname == GL_COMPLETION_STATUS_KHR;
+}
+
+static void null_glGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+  null_stats.calls++;
+  if (bufSize > 0) {
+    *infoLog = '\0';
+  }
+  if (length) {
+    *length = 0;
+  }
+}
+
+static GLuint null_glCreateProgram(void) {
+  null_stats.calls++;
+  return null_create_object();
+}
+
+static void null_glDeleteProgram(GLuint program) {
+  null_stats.calls++;
+  null_delete_object(program);
+}
+
+static void null_glAttachShader(GLuint program, GLuint shader) {
+  null_stats.calls++;
+  gli_null_object_t* object = null_object(program);
+  if (object && object->shaders_count < (int)GLI_COUNTOF(object->shaders)) {
+    object->shaders[object->shaders_count++] = shader;
+  }
+}
+
+static void null_glLinkProgram(GLuint program) {
+  null_stats.calls++;
+  gli_null_object_t* object = null_object(program);
+  if (!object) {
+    return;
+  }
+
+  for (int i = 0; i < object->shaders_count; i++) {
+    const gli_null_object_t* shader = null_object(object->shaders[i]);
+    if (shader && shader->source) {
+      null_reflect_shader(object, shader);
+    }
+  }
+}
+
+static void null_glGetProgramiv(GLuint program, GLenum pname, GLint* params) {
+  null_stats.calls++;
+  const gli_null_object_t* object = null_object(program);
+  switch (pname) {
+    case GL_LINK_STATUS:
+    case GL_COMPLETION_STATUS_KHR:
+      *params = GL_TRUE;
+      break;
+    case GL_ACTIVE_UNIFORMS:
+      *params = object ? object->uniforms_count : 0;
+      break;
+    case GL_ACTIVE_ATTRIBUTES:
+      *params = object ? object->attributes_count : 0;
+      break;
+    case GL_ACTIVE_UNIFORM_MAX_LENGTH:
+      *params = object ? null_max_length(object->uniforms, object->uniforms_count) : 1;
+      break;
+    case GL_ACTIVE_ATTRIBUTE_MAX_LENGTH:
+      *params = object ? null_max_length(object->attributes, object->attributes_count) : 1;
+      break;
+    default:
+      *params = 0;
+      break;
+  }
+}
+
+static void null_glGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+  null_glGetShaderInfoLog(program, bufSize, length, infoLog);
+}
+
+static void null_glGetActiveAttrib(
+  GLuint program,
+  GLuint index,
+  GLsizei bufSize,
+  GLsizei* length,
+  GLint* size,
+  GLenum* type,
+  GLchar* name
+) {
+  null_stats.calls++;
+  const gli_null_object_t* object = null_object(program);
+  if (object && index < (GLuint)object->attributes_count) {
+    null_get_variable(object->attributes + index, bufSize, length, size, type, name);
+  }
+}
+
+static void null_glGetActiveUniform(
+  GLuint program,
+  GLuint index,
+  GLsizei bufSize,
+  GLsizei* length,
+  GLint* size,
+  GLenum* type,
+  GLchar* name
+) {
+  null_stats.calls++;
+  const gli_null_object_t* object = null_object(program);
+  if (object && index < (GLuint)object->uniforms_count) {
+    null_get_variable(object->uniforms + index, bufSize, length, size, type, name);
+  }
+}
+
+static void null_glGetAttachedShaders(GLuint program, GLsizei maxCount, GLsizei* count, GLuint* shaders) {
+  null_stats.calls++;
+  const gli_null_object_t* object = null_object(program);
+  *count = 0;
+  for (int i = 0; object && i < object->shaders_count && *count < maxCount; i++) {
+    shaders[(*count)++] = object->shaders[i];
+  }
+}
+
+static GLint null_glGetAttribLocation(GLuint program, const GLchar* name) {
+  null_stats.calls++;
+  const gli_null_object_t* object = null_object(program);
+  const gli_null_variable_t* variable =
+    object ? null_find_variable(object->attributes, object->attributes_count, name) : NULL;
+  return variable ? variable->location : -1;
+}
+
+static GLint null_glGetUniformLocation(GLuint program, const GLchar* name) {
+  null_stats.calls++;
+  const gli_null_object_t* object = null_object(program);
+  const gli_null_variable_t* variable =
+    object ? null_find_variable(object->uniforms, object->uniforms_count, name) : NULL;
+  return variable ? variable->location : -1;
+}
+
+static void null_glGenVertexArrays(GLsizei n, GLuint* arrays) {
+  null_gen_names(n, arrays);
+}
+
+static void null_glDeleteVertexArrays(GLsizei n, const GLuint* arrays) {
+  null_stats.calls++;
+}
+
+static void null_glBindVertexArray(GLuint array) {
+  null_stats.calls++;
+}
+
+static void null_glGenBuffers(GLsizei n, GLuint* buffers) {
+  null_gen_names(n, buffers);
+}
+
+static void null_glDeleteBuffers(GLsizei n, const GLuint* buffers) {
+  null_stats.calls++;
+}
+
+static void null_glBindBuffer(GLenum target, GLuint buffer) {
+  null_stats.calls++;
+}
+
+static void null_glBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+  null_stats.calls++;
+}
+
+static void null_glVertexAttribPointer(
+  GLuint index,
+  GLint size,
+  GLenum type,
+  GLboolean normalized,
+  GLsizei stride,
+  const void* pointer
+) {
+  null_stats.calls++;
+}
+
+static void null_glVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer) {
+  null_stats.calls++;
+}
+
+static void null_glEnableVertexAttribArray(GLuint index) {
+  null_stats.calls++;
+}
+
+static void null_glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+  null_stats.calls++;
+}
+
+static void null_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+  null_stats.calls++;
+}
+
+static void null_glUseProgram(GLuint program) {
+  null_stats.calls++;
+}
+
+static void null_glUniform1fv(GLint location, GLsizei count, const GLfloat* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform2fv(GLint location, GLsizei count, const GLfloat* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform4fv(GLint location, GLsizei count, const GLfloat* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform1iv(GLint location, GLsizei count, const GLint* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform2iv(GLint location, GLsizei count, const GLint* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform3iv(GLint location, GLsizei count, const GLint* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform4iv(GLint location, GLsizei count, const GLint* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform1uiv(GLint location, GLsizei count, const GLuint* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform2uiv(GLint location, GLsizei count, const GLuint* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform3uiv(GLint location, GLsizei count, const GLuint* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniform4uiv(GLint location, GLsizei count, const GLuint* value) {
+  null_stats.calls++;
+}
+
+static void null_glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+  null_stats.calls++;
+}
+
+static void null_glGenQueries(GLsizei n, GLuint* ids) {
+  null_gen_names(n, ids);
+}
+
+static void null_glDeleteQueries(GLsizei n, const GLuint* ids) {
+  null_stats.calls++;
+}
+
+static void null_glBeginQuery(GLenum target, GLuint id) {
+  null_stats.calls++;
+}
+
+static void null_glEndQuery(GLenum target) {
+  null_stats.calls++;
+}
+
+// Queries are always ready and everything is always visible.
+static void null_glGetQueryObjectuiv(GLuint id, GLenum pname, GLuint* params) {
+  null_stats.calls++;
+  *params = 1;
+}
+
+static void null_glQueryCounter(GLuint id, GLenum target) {
+  null_stats.calls++;
+}
+
+static void null_glGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params) {
+  null_stats.calls++;
+  *params = pname == GL_QUERY_RESULT_AVAILABLE;
+}
+
+static void null_glBeginConditionalRender(GLuint id, GLenum mode) {
+  null_stats.calls++;
+}
+
+static void null_glEndConditionalRender(void) {
+  null_stats.calls++;
+}
+
+static const GLubyte* null_glGetStringi(GLenum name, GLuint index) {
+  null_stats.calls++;
+  return (const GLubyte*)"";
+}
+
+static void null_glGenFramebuffers(GLsizei n, GLuint* framebuffers) {
+  null_gen_names(n, framebuffers);
+}
+
+static void null_glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+  null_stats.calls++;
+}
+
+static void null_glBindFramebuffer(GLenum target, GLuint framebuffer) {
+  null_stats.calls++;
+}
+
+static GLenum null_glCheckFramebufferStatus(GLenum target) {
+  null_stats.calls++;
+  return GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void null_glFramebufferRenderbuffer(
+  GLenum target,
+  GLenum attachment,
+  GLenum renderbuffertarget,
+  GLuint renderbuffer
+) {
+  null_stats.calls++;
+}
+
+static void null_glGenRenderbuffers(GLsizei n, GLuint* renderbuffers) {
+  null_gen_names(n, renderbuffers);
+}
+
+static void null_glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers) {
+  null_stats.calls++;
+}
+
+static void null_glBindRenderbuffer(GLenum target, GLuint renderbuffer) {
+  null_stats.calls++;
+}
+
+static void null_glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) {
+  null_stats.calls++;
+}
+
+static void* null_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+  null_stats.calls++;
+  if (length > null_mapped_size) {
+    free(null_mapped_memory);
+    null_mapped_memory = calloc(1, length);
+    null_mapped_size = length;
+  }
+  return null_mapped_memory;
+}
+
+static GLboolean null_glUnmapBuffer(GLenum target) {
+  null_stats.calls++;
+  return GL_TRUE;
+}
+
+static GLsync null_glFenceSync(GLenum condition, GLbitfield flags) {
+  null_stats.calls++;
+  return (GLsync)(uintptr_t)null_name();
+}
+
+static GLenum null_glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+  null_stats.calls++;
+  return GL_ALREADY_SIGNALED;
+}
+
+static void null_glDeleteSync(GLsync sync) {
+  null_stats.calls++;
+}
+
+static void null_glGenerateMipmap(GLenum target) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glClear(GLbitfield mask) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glEnable(GLenum cap) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glDisable(GLenum cap) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glDepthMask(GLboolean flag) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glDepthFunc(GLenum func) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  null_stats.calls++;
+  null_stats.draw_calls++;
+}
+
+static void APIENTRY null_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+  null_stats.calls++;
+  null_stats.draw_calls++;
+}
+
+// No extensions.
+static void APIENTRY null_glGetIntegerv(GLenum pname, GLint* data) {
+  null_stats.calls++;
+  *data = 0;
+}
+
+static void APIENTRY null_glReadPixels(
+  GLint x,
+  GLint y,
+  GLsizei width,
+  GLsizei height,
+  GLenum format,
+  GLenum type,
+  void* pixels
+) {
+  null_stats.calls++;
+}
+
+static GLenum APIENTRY null_glGetError(void) {
+  null_stats.calls++;
+  return GL_NO_ERROR;
+}
+
+static void APIENTRY null_glFinish(void) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glGenTextures(GLsizei n, GLuint* textures) {
+  null_gen_names(n, textures);
+}
+
+static void APIENTRY null_glDeleteTextures(GLsizei n, const GLuint* textures) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glBindTexture(GLenum target, GLuint texture) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glTexParameteri(GLenum target, GLenum pname, GLint param) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glTexImage3D(
+  GLenum target,
+  GLint level,
+  GLint internalformat,
+  GLsizei width,
+  GLsizei height,
+  GLsizei depth,
+  GLint border,
+  GLenum format,
+  GLenum type,
+  const void* pixels
+) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glTexSubImage3D(
+  GLenum target,
+  GLint level,
+  GLint xoffset,
+  GLint yoffset,
+  GLint zoffset,
+  GLsizei width,
+  GLsizei height,
+  GLsizei depth,
+  GLenum format,
+  GLenum type,
+  const void* pixels
+) {
+  null_stats.calls++;
+}
+
+static void APIENTRY null_glCompressedTexImage3D(
+  GLenum target,
+  GLint level,
+  GLenum internalformat,
+  GLsizei width,
+  GLsizei height,
+  GLsizei depth,
+  GLint border,
+  GLsizei imageSize,
+  const void* data
+) {
+  null_stats.calls++;
+}
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#else
+#pragma GCC diagnostic pop
+#endif
+#endif
+#pragma endregion
+
+#pragma region Mesh simplification
+typedef struct gli_quadric_t {
+  // Upper triangle of a symmetric 4x4 matrix.
+  double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+} gli_quadric_t;
+
+typedef struct gli_collapse_t {
+  unsigned from, to;
+  float cost;
+} gli_collapse_t;
+
+typedef struct gli_edge_t {
+  unsigned a, b;
+} gli_edge_t;
+
+static void quadric_add(gli_quadric_t* quadric, const gli_quadric_t* other) {
+  double* destination = (double*)quadric;
+  const double* source = (const double*)other;
+  for (unsigned i = 0; i < sizeof(gli_quadric_t) / sizeof(double); i++) {
+    destination[i] += source[i];
+  }
+}
+
+// The sum of the squared distances from the point to the planes accumulated in the quadric.
+static double quadric_error(const gli_quadric_t* q, const vkm_vec3* p) {
+  const double x = p->x, y = p->y, z = p->z;
+  return q->a00 * x * x + 2.0 * q->a01 * x * y + 2.0 * q->a02 * x * z + 2.0 * q->a03 * x
+    + q->a11 * y * y + 2.0 * q->a12 * y * z + 2.0 * q->a13 * y
+    + q->a22 * z * z + 2.0 * q->a23 * z
+    + q->a33;
+}
+
+static void triangle_normal(const vkm_vec3* a, const vkm_vec3* b, const vkm_vec3* c, vkm_vec3* normal) {
+  vkm_vec3 ab, ac;
+  vkm_sub(b, a, &ab);
+  vkm_sub(c, a, &ac);
+  vkm_cross(&ab, &ac, normal);
+}
+
+static unsigned hash_position(const vkm_vec3* position) {
+  uint32_t bits[3];
+  memcpy(bits, position->raw, sizeof(bits));
+  return bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u;
+}
+
+static int compare_collapses(const void* a, const void* b) {
+  const float cost_a = ((const gli_collapse_t*)a)->cost, cost_b = ((const gli_collapse_t*)b)->cost;
+  return (cost_a > cost_b) - (cost_a < cost_b);
+}
+
+static int compare_edges(const void* a, const void* b) {
+  const gli_edge_t* edge_a = a, *edge_b = b;
+  if (edge_a->a != edge_b->a) {
+    return (edge_a->a > edge_b->a) - (edge_a->a < edge_b->a);
+  }
+  return (edge_a->b > edge_b->b) - (edge_a->b < edge_b->b);
+}
+
+// Finds the vertices that must not move: those on borders and on attribute seams (sharing their position with other
+// vertices), because moving them would open cracks.
+static bool* find_locked_vertices(
+  const vkm_vec3* positions,
+  const int vertices_count,
+  const unsigned* indices,
+  const int indices_count
+) {
+  bool* locked = calloc(vertices_count, sizeof(bool));
+  // For each vertex, the first vertex that has the same position.
+  unsigned* canonical = malloc(vertices_count * sizeof(unsigned));
+
+  unsigned capacity = 1;
+  while (capacity < (unsigned)vertices_count * 2) {
+    capacity <<= 1;
+  }
+  unsigned* table = malloc(capacity * sizeof(unsigned));
+  memset(table, 0xFF, capacity * sizeof(unsigned));
+  for (int v = 0; v < vertices_count; v++) {
+    unsigned slot = hash_position(positions + v) & (capacity - 1);
+    while (table[slot] != UINT32_MAX && memcmp(positions + table[slot], positions + v, sizeof(vkm_vec3)) != 0) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+
+    if (table[slot] == UINT32_MAX) {
+      table[slot] = canonical[v] = v;
+    } else {
+      canonical[v] = table[slot];
+      locked[v] = locked[table[slot]] = true;
+    }
+  }
+  free(table);
+
+  // Edges that aren't shared by exactly two triangles are borders (or worse).
+  gli_edge_t* edges = malloc(indices_count * sizeof(gli_edge_t));
+  for (int i = 0; i < indices_count; i += 3) {
+    for (int j = 0; j < 3; j++) {
+      const unsigned a = canonical[indices[i + j]], b = canonical[indices[i + (j + 1) % 3]];
+      edges[i + j] = (gli_edge_t){ a < b ? a : b, a < b ? b : a };
+    }
+  }
+  qsort(edges, indices_count, sizeof(gli_edge_t), compare_edges);
+  for (int i = 0, run; i < indices_count; i += run) {
+    for (run = 1; i + run < indices_count && compare_edges(edges + i, edges + i + run) == 0; run++);
+    if (run != 2) {
+      locked[edges[i].a] = locked[edges[i].b] = true;
+    }
+  }
+  free(edges);
+
+  for (int v = 0; v < vertices_count; v++) {
+    locked[v] |= locked[canonical[v]];
+  }
+
+  free(canonical);
+  return locked;
+}
+
+// Whether moving the vertex onto another one would flip any of the triangles around it.
+static bool collapse_flips(
+  const vkm_vec3* positions,
+  const unsigned* indices,
+  const int* adjacency,
+  const int* adjacency_offsets,
+  const unsigned from,
+  const unsigned to
+) {
+  for (int i = adjacency_offsets[from]; i < adjacency_offsets[from + 1]; i++) {
+    const unsigned* triangle = indices + adjacency[i];
+    if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+      // This one just goes away.
+      continue;
+    }
+
+    vkm_vec3 before, after;
+    triangle_normal(positions + triangle[0], positions + triangle[1], positions + triangle[2], &before);
+    triangle_normal(
+      positions + (triangle[0] == from ? to : triangle[0]),
+      positions + (triangle[1] == from ? to : triangle[1]),
+      positions + (triangle[2] == from ? to : triangle[2]),
+      &after
+    );
+    if (vkm_dot(&before, &after) <= 0.0f) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Simplifies an indexed triangle mesh by collapsing edges, choosing the cheapest ones by quadric error metrics, until
+// it has no more than target_indices_count indices or the next collapse would move the surface more than max_error. It
+// never creates vertices, so the result can share the vertex buffer of the original mesh. Writes the new indices to
+// destination, which must be as big as the original ones, and returns their count. The actual error is stored in error.
+static int simplify_mesh(
+  const vkm_vec3* positions,
+  const int vertices_count,
+  const unsigned* indices,
+  const int indices_count,
+  const int target_indices_count,
+  const float max_error,
+  unsigned* destination,
+  float* error
+) {
+  memcpy(destination, indices, indices_count * sizeof(unsigned));
+  int count = indices_count;
+  double max_cost = 0.0;
+
+  bool* locked = find_locked_vertices(positions, vertices_count, indices, indices_count);
+
+  gli_quadric_t* quadrics = calloc(vertices_count, sizeof(gli_quadric_t));
+  for (int i = 0; i < indices_count; i += 3) {
+    vkm_vec3 normal;
+    triangle_normal(positions + indices[i], positions + indices[i + 1], positions + indices[i + 2], &normal);
+    const float length = vkm_magnitude(&normal);
+    if (length <= 0.0f) {
+      continue;
+    }
+
+    const double a = normal.x / length, b = normal.y / length, c = normal.z / length;
+    const double d = -(a * positions[indices[i]].x + b * positions[indices[i]].y + c * positions[indices[i]].z);
+    const gli_quadric_t plane = {
+      a * a, a * b, a * c, a * d,
+      b * b, b * c, b * d,
+      c * c, c * d,
+      d * d,
+    };
+    for (int j = 0; j < 3; j++) {
+      quadric_add(quadrics + indices[i + j], &plane);
+    }
+  }
+
+  gli_collapse_t* collapses = malloc(indices_count * 2 * sizeof(gli_collapse_t));
+  int* adjacency = malloc(indices_count * sizeof(int));
+  int* adjacency_offsets = malloc((vertices_count + 1) * sizeof(int));
+  unsigned* remap = malloc(vertices_count * sizeof(unsigned));
+  // Vertices around the collapses of the current pass, which can't take part in other ones until the next pass.
+  bool* touched = malloc(vertices_count * sizeof(bool));
+
+  while (count > target_indices_count) {
+    int collapses_count = 0;
+    for (int i = 0; i < count; i++) {
+      const unsigned a = destination[i], b = destination[i - i % 3 + (i + 1) % 3];
+      gli_quadric_t quadric = quadrics[a];
+      quadric_add(&quadric, quadrics + b);
+      if (!locked[a]) {
+        collapses[collapses_count++] = (gli_collapse_t){ a, b, (float)quadric_error(&quadric, positions + b) };
+      }
+      if (!locked[b]) {
+        collapses[collapses_count++] = (gli_collapse_t){ b, a, (float)quadric_error(&quadric, positions + a) };
+      }
+    }
+    qsort(collapses, collapses_count, sizeof(gli_collapse_t), compare_collapses);
+
+    memset(adjacency_offsets, 0, (vertices_count + 1) * sizeof(int));
+    for (int i = 0; i < count; i++) {
+      adjacency_offsets[destination[i] + 1]++;
+    }
+    for (int v = 0; v < vertices_count; v++) {
+      adjacency_offsets[v + 1] += adjacency_offsets[v];
+    }
+    for (int i = 0; i < count; i++) {
+      adjacency[adjacency_offsets[destination[i]]++] = i - i % 3;
+    }
+    // Filling the lists moved the offsets one list ahead, move them back.
+    memmove(adjacency_offsets + 1, adjacency_offsets, vertices_count * sizeof(int));
+    adjacency_offsets[0] = 0;
+
+    for (int v = 0; v < vertices_count; v++) {
+      remap[v] = v;
+      touched[v] = false;
+    }
+
+    int triangles_count = count / 3, collapsed = 0;
+    for (int i = 0; i < collapses_count && triangles_count * 3 > target_indices_count; i++) {
+      const gli_collapse_t* collapse = collapses + i;
+      if (collapse->cost > max_error * max_error) {
+        break;
+      }
+
+      if (touched[collapse->from] || touched[collapse->to]) {
+        continue;
+      }
+
+      if (collapse_flips(positions, destination, adjacency, adjacency_offsets, collapse->from, collapse->to)) {
+        continue;
+      }
+
+      for (int j = adjacency_offsets[collapse->from]; j < adjacency_offsets[collapse->from + 1]; j++) {
+        const unsigned* triangle = destination + adjacency[j];
+        touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+        triangles_count -= triangle[0] == collapse->to || triangle[1] == collapse->to || triangle[2] == collapse->to;
+      }
+
+      remap[collapse->from] = collapse->to;
+      quadric_add(quadrics + collapse->to, quadrics + collapse->from);
+      if (collapse->cost > max_cost) {
+        max_cost = collapse->cost;
+      }
+      collapsed++;
+    }
+
+    if (!collapsed) {
+      break;
+    }
+
+    // Apply the collapses, dropping the triangles that degenerated.
+    int written = 0;
+    for (int i = 0; i < count; i += 3) {
+      const unsigned a = remap[destination[i]], b = remap[destination[i + 1]], c = remap[destination[i + 2]];
+      if (a != b && b != c && a != c) {
+        destination[written++] = a;
+        destination[written++] = b;
+        destination[written++] = c;
+      }
+    }
+    count = written;
+  }
+
+  free(touched);
+  free(remap);
+  free(adjacency_offsets);
+  free(adjacency);
+  free(collapses);
+  free(quadrics);
+  free(locked);
+
+  // The quadrics add up squared distances, so this overestimates the actual distance, which is fine for a bound.
+  *error = (float)vkm_sqrt(max_cost);
+  return count;
+}
+
+// Builds the indices of all the levels of detail of the mesh one after another, filling the levels in the mesh.
+static unsigned* build_lod_chain(const MeshData* mesh_data, Mesh* mesh, int* chain_indices_count) {
+  const vkm_vec3* positions = mesh_data->data;
+  const int indices_count = mesh_data->indices_count;
+  const int levels_count = mesh_data->lods_count + 1 < GLI_MAX_LODS ? mesh_data->lods_count + 1 : GLI_MAX_LODS;
+
+  unsigned* chain = malloc((size_t)levels_count * indices_count * sizeof(unsigned));
+  memcpy(chain, mesh_data->indices, indices_count * sizeof(unsigned));
+  mesh->lods[0] = (struct mesh_lod){ .indices_count = indices_count };
+  mesh->lods_count = 1;
+
+  vkm_vec3 size;
+  vkm_sub(&mesh->bounds_max, &mesh->bounds_min, &size);
+  const float max_error = (mesh_data->lod_max_error > 0.0f ? mesh_data->lod_max_error : 0.1f) * vkm_magnitude(&size);
+
+  int written = indices_count;
+  for (int level = 1; level < levels_count; level++) {
+    const struct mesh_lod* previous = mesh->lods + level - 1;
+    const int target = indices_count / 3 >> level;
+    if (target < 1) {
+      break;
+    }
+
+    float error;
+    const int count = simplify_mesh(
+      positions,
+      mesh_data->vertices_count,
+      mesh_data->indices,
+      indices_count,
+      target * 3,
+      max_error,
+      chain + written,
+      &error
+    );
+
+    // Not worth another level if the error bound didn't let it get noticeably simpler.
+    if (count > previous->indices_count * 9 / 10) {
+      break;
+    }
+
+    mesh->lods[mesh->lods_count++] = (struct mesh_lod){
+      .first_index = written,
+      .indices_count = count,
+      .error = error,
+    };
+    written += count;
+  }
+
+  *chain_indices_count = written;
+  return chain;
+}
+#pragma endregion
+
+#pragma region Render on demand
+// Whether this frame is not drawn, see RenderOnDemand.
+static bool skip_rendering;
+// Set for changes that change detection doesn't see: meshes and programs made, and the window.
+static bool redraw_requested;
+
+// What the last drawn frame was seen from. These are compared instead of using change detection because PreRenderFrame
+// writes the cameras every frame, and flecs trips over optional singletons that are written while being watched.
+typedef struct gli_drawn_view_t {
+  ClearColor clear_color;
+  float zoom;
+  Position2D position_2d;
+  float field_of_view, near_plane, far_plane;
+  Position3D position_3d;
+  Rotation3D rotation_3d;
+} gli_drawn_view_t;
+static gli_drawn_view_t drawn_view;
+
+// The rendered entities are watched through the queries of the programs.
+static ecs_query_t* shader_programs_query;
+
+static bool window_events_pending(const GLitchWindow* window) {
+#ifdef GLI_LINUX
+  return window->display && XPending(window->display) > 0;
+#elif defined(GLI_WINDOWS)
+  MSG message;
+  return window->backend == GLI_BACKEND_WINDOW && PeekMessage(&message, NULL, 0, 0, PM_NOREMOVE);
+#else
+  (void)window;
+  return false;
+#endif
+}
+
+// In milliseconds, how long to wait without a window and without a max_wait. Changes can only come from the frames
+// then, so nothing could end a longer wait.
+#define GLI_WINDOWLESS_WAIT 16
+
+static void wait_for_window_events(const GLitchWindow* window, const int max_wait) {
+#ifdef GLI_LINUX
+  if (window->display) {
+    if (XPending(window->display) == 0) {
+      struct pollfd descriptor = { .fd = ConnectionNumber(window->display), .events = POLLIN };
+      poll(&descriptor, 1, max_wait > 0 ? max_wait : -1);
+    }
+    return;
+  }
+  usleep((max_wait > 0 ? max_wait : GLI_WINDOWLESS_WAIT) * 1000);
+#elif defined(GLI_WINDOWS)
+  if (window->backend == GLI_BACKEND_WINDOW) {
+    MsgWaitForMultipleObjects(0, NULL, FALSE, max_wait > 0 ? (DWORD)max_wait : INFINITE, QS_ALLINPUT);
+  } else {
+    Sleep(max_wait > 0 ? (DWORD)max_wait : GLI_WINDOWLESS_WAIT);
+  }
+#else
+  // The browser runs the frames, we can't block it.
+  (void)window;
+  (void)max_wait;
+#endif
+}
+
+static void CheckForChanges(ecs_iter_t* it) {
+  RenderOnDemand* on_demand = ecs_field(it, RenderOnDemand, 0);
+  const GLitchWindow* window = ecs_field(it, GLitchWindow, 1);
+  const ClearColor* clear_color = ecs_field(it, ClearColor, 2);
+  const Camera2D* camera_2d = ecs_field(it, Camera2D, 3);
+  const Position2D* camera_2d_position = ecs_field(it, Position2D, 4);
+  const Camera3D* camera_3d = ecs_field(it, Camera3D, 5);
+  const Position3D* camera_3d_position = ecs_field(it, Position3D, 6);
+  const Rotation3D* camera_3d_rotation = ecs_field(it, Rotation3D, 7);
+
+  gli_drawn_view_t view = { 0 };
+  if (clear_color) {
+    view.clear_color = *clear_color;
+  }
+  if (camera_2d) {
+    view.zoom = camera_2d->zoom;
+    view.position_2d = camera_2d_position ? *camera_2d_position : (Position2D){ 0 };
+  }
+  if (camera_3d) {
+    view.field_of_view = camera_3d->field_of_view;
+    view.near_plane = camera_3d->near_plane;
+    view.far_plane = camera_3d->far_plane;
+    view.position_3d = camera_3d_position ? *camera_3d_position : (Position3D){ 0 };
+    view.rotation_3d = camera_3d_rotation ? *camera_3d_rotation : (Rotation3D){ 0 };
+  }
+
+  bool changed = on_demand->redraw
+    || redraw_requested
+    || window_events_pending(window)
+    || memcmp(&view, &drawn_view, sizeof(view)) != 0;
+
+  // Render iterates the queries of the programs, which resets their changed state.
+  ecs_iter_t programs_it = ecs_query_iter(it->world, shader_programs_query);
+  while (ecs_query_next(&programs_it)) {
+    const ShaderProgram* shader_programs = ecs_field(&programs_it, ShaderProgram, 0);
+    for (int i = 0; !changed && i < programs_it.count; i++) {
+      changed = ecs_query_changed(shader_programs[i].rendered_entities_query);
+    }
+  }
+
+  on_demand->redraw = redraw_requested = false;
+  skip_rendering = !changed;
+  if (changed) {
+    drawn_view = view;
+    on_demand->drawn++;
+  } else {
+    on_demand->skipped++;
+  }
+}
+
+static void WaitForChanges(ecs_iter_t* it) {
+  const RenderOnDemand* on_demand = ecs_field(it, RenderOnDemand, 0);
+  const GLitchWindow* window = ecs_field(it, GLitchWindow, 1);
+
+  if (skip_rendering) {
+    wait_for_window_events(window, on_demand->max_wait);
+  }
+}
+
+static void OnAddRenderOnDemand(ecs_iter_t* it) {
+  shader_programs_query = ecs_query(it->world, {
+    .terms = { { .id = ecs_id(ShaderProgram), .inout = EcsIn } },
+    .cache_kind = EcsQueryCacheAuto,
+  });
+  redraw_requested = true;
+}
+
+static void OnRemoveRenderOnDemand(ecs_iter_t* it) {
+  (void)it;
+  ecs_query_fini(shader_programs_query);
+  shader_programs_query = NULL;
+  skip_rendering = false;
+}
+#pragma endregion
+
+// Uploads planar vertices, pointing a new vertex array at each of their attributes.
+static size_t vertices_size(const struct attribute* attributes, const size_t vertices_count) {
+  size_t size = 0;
+  for (int i = 0; i < GLI_MAX_ATTRIBUTES && attributes[i].type; i++) {
+    size += type_infos[attributes[i].type].size * vertices_count;
+  }
+  return size;
+}
+
+// Makes the vertex array and buffer of a mesh, with room for vertices_capacity vertices, and uploads the vertices
+// unless data is NULL.
+static void upload_mesh_vertices(
+  Mesh* mesh,
+  const struct attribute* attributes,
+  const void* data,
+  const int vertices_capacity,
+  const GLenum usage
+) {
+  glGenVertexArrays(1, &mesh->vertex_array);
+  glBindVertexArray(mesh->vertex_array);
+  frame_stats.vertex_array_binds++;
+
+  glGenBuffers(1, &mesh->vertex_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer);
+  frame_stats.buffer_binds++;
+
+  // As we iterate the vertex attributes, the buffer size serves as an offset, too.
+  GLsizeiptr buffer_size = 0;
+  for (int j = 0; attributes[j].type && j < GLI_MAX_ATTRIBUTES; j++) {
+    const gli_type_info_t info = type_infos[attributes[j].type];
+
+    // Normalized integers are read as floats.
+    if (info.type == GL_FLOAT || attributes[j].normalize) {
+      glVertexAttribPointer(
+        j,
+        info.vector_components,
+        info.type,
+        attributes[j].normalize,
+        0,
+        (const GLvoid*)buffer_size
+      );
+    } else {
+      glVertexAttribIPointer(j, info.vector_components, info.type, 0, (const GLvoid*)buffer_size);
+    }
+
+    glEnableVertexAttribArray(j);
+    buffer_size += info.size * vertices_capacity;
+  }
+
+  glBufferData(GL_ARRAY_BUFFER, buffer_size, data, usage);
+  if (data) {
+    frame_stats.uploaded_bytes += buffer_size;
+  }
+}
+
+// Uploads indices of GL_UNSIGNED_SHORT or GL_UNSIGNED_INT into the element buffer of the vertex array that's bound, or
+// only makes room for them if indices is NULL.
+static void upload_mesh_indices(
+  Mesh* mesh,
+  const void* indices,
+  const GLenum type,
+  const int count,
+  const GLenum usage
+) {
+  const GLsizeiptr size = (GLsizeiptr)count * (type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned));
+  glGenBuffers(1, &mesh->index_buffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->index_buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, usage);
+  mesh->index_type = type;
+  frame_stats.buffer_binds++;
+  if (indices) {
+    frame_stats.uploaded_bytes += size;
+  }
+}
+
+static void measure_mesh_bounds(const MeshData* mesh_data, Mesh* mesh) {
+  const gli_data_type_t position_type = mesh_data->vertex_attributes[0].type;
+  if ((position_type == GLI_VEC2 || position_type == GLI_VEC3) && mesh_data->vertices_count > 0) {
+    const int components = type_infos[position_type].vector_components;
+    const float* positions = mesh_data->data;
+    for (int j = 0; j < components; j++) {
+      mesh->bounds_min.raw[j] = mesh->bounds_max.raw[j] = positions[j];
+    }
+    for (int j = components; j < mesh_data->vertices_count * components; j++) {
+      mesh->bounds_min.raw[j % components] = vkm_minf(mesh->bounds_min.raw[j % components], positions[j]);
+      mesh->bounds_max.raw[j % components] = vkm_maxf(mesh->bounds_max.raw[j % components], positions[j]);
+    }
+  }
+}
+
+// Copies the triangles of a mesh for the software rasterizer, with indices of index_size bytes, or none.
+static void set_occluder_geometry(
+  ecs_world_t* world,
+  const ecs_entity_t entity,
+  const vkm_vec3* positions,
+  const int vertices_count,
+  const void* indices,
+  const int index_size,
+  const int indices_count
+) {
+  OccluderGeometry* geometry = ecs_ensure(world, entity, OccluderGeometry);
+  free(geometry->positions);
+  free(geometry->indices);
+  geometry->vertices_count = vertices_count;
+  geometry->positions = malloc(geometry->vertices_count * sizeof(vkm_vec3));
+  memcpy(geometry->positions, positions, geometry->vertices_count * sizeof(vkm_vec3));
+  geometry->indices_count = indices ? indices_count : vertices_count;
+  geometry->indices = NULL;
+  if (indices && index_size == sizeof(unsigned)) {
+    geometry->indices = malloc(geometry->indices_count * sizeof(unsigned));
+    memcpy(geometry->indices, indices, geometry->indices_count * sizeof(unsigned));
+  } else if (indices) {
+    geometry->indices = malloc(geometry->indices_count * sizeof(unsigned));
+    for (int i = 0; i < indices_count; i++) {
+      uint16_t index;
+      memcpy(&index, (const uint8_t*)indices + i * sizeof(index), sizeof(index));
+      geometry->indices[i] = index;
+    }
+  }
+  ecs_modified(world, entity, OccluderGeometry);
+}
+
+static void MakeMeshes(ecs_iter_t* it) {
+  const MeshData* mesh_datas = ecs_field(it, MeshData, 0);
+  acquire_context();
+
+  for (int i = 0; i < it->count; i++) {
+    const MeshData* mesh_data = mesh_datas + i;
+
+    Mesh* mesh = ecs_ensure(it->world, it->entities[i], Mesh);
+
+    mesh->vertices_count = mesh_data->vertices_count;
+    mesh->indices_count = mesh_data->indices_count;
+    mesh->primitive = mesh_data->primitive;
+    assert(mesh->primitive);
+
+    if (mesh_data->data) {
+      upload_mesh_vertices(mesh, mesh_data->vertex_attributes, mesh_data->data, mesh->vertices_count, GL_STATIC_DRAW);
+      measure_mesh_bounds(mesh_data, mesh);
+
+      const gli_data_type_t position_type = mesh_data->vertex_attributes[0].type;
+      if (
+        position_type == GLI_VEC3
+        && mesh->primitive == GLI_TRIANGLES
+        && ecs_has(it->world, it->entities[i], Occluder)
+      ) {
+        set_occluder_geometry(
+          it->world,
+          it->entities[i],
+          mesh_data->data,
+          mesh_data->vertices_count,
+          mesh_data->indices,
+          sizeof(unsigned),
+          mesh_data->indices_count
+        );
+      }
+
+      if (mesh_data->indices) {
+        const unsigned* indices = mesh_data->indices;
+        int indices_count = mesh_data->indices_count;
+        unsigned* lod_chain = NULL;
+        if (mesh_data->lods_count > 0 && position_type == GLI_VEC3 && mesh->primitive == GLI_TRIANGLES) {
+          indices = lod_chain = build_lod_chain(mesh_data, mesh, &indices_count);
+        }
+
+        upload_mesh_indices(mesh, indices, GL_UNSIGNED_INT, indices_count, GL_STATIC_DRAW);
+        free(lod_chain);
+      }
+    } else {
+      mesh->vertex_array = attributeless_vertex_array;
+    }
+
+    ecs_modified(it->world, it->entities[i], Mesh);
+    ecs_remove(it->world, it->entities[i], MeshData);
+    redraw_requested = true;
+  }
+}
+
+#pragma region Dynamic meshes
+static void mark_dirty_range(struct dirty_range* range, const int first, const int count) {
+  if (count <= 0) {
+    return;
+  }
+
+  if (range->begin < range->end) {
+    range->begin = vkm_mini(range->begin, first);
+    range->end = vkm_maxi(range->end, first + count);
+  } else {
+    range->begin = first;
+    range->end = first + count;
+  }
+}
+
+void gli_update_dynamic_vertices(DynamicMesh* mesh, const int first, const int count) {
+  mark_dirty_range(&mesh->dirty_vertices, first, count);
+}
+
+void gli_update_dynamic_indices(DynamicMesh* mesh, const int first, const int count) {
+  mark_dirty_range(&mesh->dirty_indices, first, count);
+}
+
+static void MakeDynamicMeshes(ecs_iter_t* it) {
+  DynamicMesh* dynamic_meshes = ecs_field(it, DynamicMesh, 0);
+  acquire_context();
+
+  for (int i = 0; i < it->count; i++) {
+    DynamicMesh* dynamic_mesh = dynamic_meshes + i;
+
+    Mesh* mesh = ecs_ensure(it->world, it->entities[i], Mesh);
+    mesh->primitive = dynamic_mesh->primitive;
+    assert(mesh->primitive);
+
+    if (dynamic_mesh->vertex_attributes[0].type) {
+      upload_mesh_vertices(
+        mesh,
+        dynamic_mesh->vertex_attributes,
+        NULL,
+        dynamic_mesh->vertices_capacity,
+        GL_DYNAMIC_DRAW
+      );
+      if (dynamic_mesh->indices_capacity > 0) {
+        upload_mesh_indices(mesh, NULL, GL_UNSIGNED_INT, dynamic_mesh->indices_capacity, GL_DYNAMIC_DRAW);
+      }
+    } else {
+      mesh->vertex_array = attributeless_vertex_array;
+    }
+
+    // Left empty, for UpdateDynamicMeshes to upload everything as the counts grow from zero.
+    ecs_modified(it->world, it->entities[i], Mesh);
+  }
+}
+
+// Uploads the vertices of a range, attribute by attribute, into the buffer that's bound. If that's all the vertices
+// that are drawn, the buffer is orphaned first, so that the driver gives us new storage instead of waiting for the GPU.
+static void upload_dynamic_vertices(const DynamicMesh* dynamic_mesh, const int begin, const int end) {
+  const int capacity = dynamic_mesh->vertices_capacity;
+  if (begin == 0 && end >= dynamic_mesh->vertices_count) {
+    const size_t size = vertices_size(dynamic_mesh->vertex_attributes, capacity);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, NULL, GL_DYNAMIC_DRAW);
+  }
+
+  size_t offset = 0;
+  for (int j = 0; j < GLI_MAX_ATTRIBUTES && dynamic_mesh->vertex_attributes[j].type; j++) {
+    const size_t size = type_infos[dynamic_mesh->vertex_attributes[j].type].size;
+    const size_t range_offset = offset + begin * size, range_size = (end - begin) * size;
+    glBufferSubData(
+      GL_ARRAY_BUFFER,
+      (GLintptr)range_offset,
+      (GLsizeiptr)range_size,
+      (const uint8_t*)dynamic_mesh->data + range_offset
+    );
+    frame_stats.uploaded_bytes += (int64_t)range_size;
+    offset += size * capacity;
+  }
+}
+
+static void UpdateDynamicMeshes(ecs_iter_t* it) {
+  DynamicMesh* dynamic_meshes = ecs_field(it, DynamicMesh, 0);
+  Mesh* meshes = ecs_field(it, Mesh, 1);
+
+  for (int i = 0; i < it->count; i++) {
+    DynamicMesh* dynamic_mesh = dynamic_meshes + i;
+    Mesh* mesh = meshes + i;
+
+    const int vertices_count = vkm_clampi(dynamic_mesh->vertices_count, 0, dynamic_mesh->vertices_capacity);
+    const int indices_count = vkm_clampi(dynamic_mesh->indices_count, 0, dynamic_mesh->indices_capacity);
+    // Orphaning may have dropped what was past the counts.
+    gli_update_dynamic_vertices(dynamic_mesh, mesh->vertices_count, vertices_count - mesh->vertices_count);
+    gli_update_dynamic_indices(dynamic_mesh, mesh->indices_count, indices_count - mesh->indices_count);
+    struct dirty_range* vertices = &dynamic_mesh->dirty_vertices, *indices = &dynamic_mesh->dirty_indices;
+    vertices->begin = vkm_maxi(vertices->begin, 0);
+    vertices->end = vkm_mini(vertices->end, dynamic_mesh->vertices_capacity);
+    indices->begin = vkm_maxi(indices->begin, 0);
+    indices->end = vkm_mini(indices->end, dynamic_mesh->indices_capacity);
+    const bool upload_vertices = vertices->begin < vertices->end && mesh->vertex_buffer;
+    const bool upload_indices = indices->begin < indices->end && mesh->index_buffer;
+    const bool resized = mesh->vertices_count != vertices_count || mesh->indices_count != indices_count;
+
+    if (upload_vertices || upload_indices) {
+      acquire_context();
+      glBindVertexArray(mesh->vertex_array);
+      frame_stats.vertex_array_binds++;
+    }
+    if (upload_vertices) {
+      glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer);
+      frame_stats.buffer_binds++;
+      upload_dynamic_vertices(dynamic_mesh, vertices->begin, vertices->end);
+    }
+    if (upload_indices) {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->index_buffer);
+      frame_stats.buffer_binds++;
+      // Like the vertices, orphaned if all that's drawn is uploaded.
+      if (indices->begin == 0 && indices->end >= indices_count) {
+        const GLsizeiptr size = (GLsizeiptr)dynamic_mesh->indices_capacity * sizeof(unsigned);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+      }
+      const size_t size = (size_t)(indices->end - indices->begin) * sizeof(unsigned);
+      glBufferSubData(
+        GL_ELEMENT_ARRAY_BUFFER,
+        (GLintptr)(indices->begin * sizeof(unsigned)),
+        (GLsizeiptr)size,
+        dynamic_mesh->indices + indices->begin
+      );
+      frame_stats.uploaded_bytes += (int64_t)size;
+    }
+
+    if (upload_vertices || resized) {
+      MeshData positions = { .data = dynamic_mesh->data, .vertices_count = vertices_count };
+      positions.vertex_attributes[0] = dynamic_mesh->vertex_attributes[0];
+      measure_mesh_bounds(&positions, mesh);
+    }
+    if (upload_vertices || upload_indices || resized) {
+      mesh->vertices_count = vertices_count;
+      mesh->indices_count = indices_count;
+      redraw_requested = true;
+    }
+    *vertices = *indices = (struct dirty_range){ 0 };
+  }
+}
+#pragma endregion
+
+// An image of a batch being packed into an atlas, with the padding.
+typedef struct gli_packed_image_t {
+  int index;
+  vkm_ivec2 size;
+  int x, y, layer;
+  // Where its pixels are in the pixel buffer.
+  size_t offset;
+} gli_packed_image_t;
+
+// The pixel buffer that images are uploaded through, orphaned on every upload.
+static GLuint image_upload_buffer;
+
+// Tallest first, so that the shelves waste less room.
+static int compare_image_heights(const void* a, const void* b) {
+  return ((const gli_packed_image_t*)b)->size.y - ((const gli_packed_image_t*)a)->size.y;
+}
+
+// Puts the image on the shelf being filled, or on a new one, or on a new layer. Returns false if the atlas is full.
+static bool pack_image(TextureAtlas* atlas, gli_packed_image_t* image) {
+  if (image->size.x > atlas->size.x || image->size.y > atlas->size.y) {
+    return false;
+  }
+
+  if (atlas->shelf_x + image->size.x > atlas->size.x) {
+    atlas->shelf_x = 0;
+    atlas->shelf_y += atlas->shelf_height;
+    atlas->shelf_height = 0;
+  }
+  if (atlas->shelf_y + image->size.y > atlas->size.y) {
+    atlas->layer++;
+    atlas->shelf_x = atlas->shelf_y = atlas->shelf_height = 0;
+  }
+  if (atlas->layer >= atlas->layers) {
+    return false;
+  }
+
+  image->x = atlas->shelf_x;
+  image->y = atlas->shelf_y;
+  image->layer = atlas->layer;
+  atlas->shelf_x += image->size.x;
+  atlas->shelf_height = vkm_maxi(atlas->shelf_height, image->size.y);
+  return true;
+}
+
+// Writes the pixels with their edges repeated GLI_ATLAS_PADDING times around them.
+static void pad_image(const ImageData* image, uint8_t* destination) {
+  const int width = image->size.x, padded_width = width + 2 * GLI_ATLAS_PADDING;
+  for (int y = 0; y < image->size.y + 2 * GLI_ATLAS_PADDING; y++) {
+    const int source_y = vkm_mini(vkm_maxi(y - GLI_ATLAS_PADDING, 0), image->size.y - 1);
+    const uint8_t* row = image->pixels + (size_t)source_y * width * 4;
+    for (int x = 0; x < GLI_ATLAS_PADDING; x++) {
+      memcpy(destination + x * 4, row, 4);
+      memcpy(destination + (GLI_ATLAS_PADDING + width + x) * 4, row + (width - 1) * 4, 4);
+    }
+    memcpy(destination + GLI_ATLAS_PADDING * 4, row, (size_t)width * 4);
+    destination += (size_t)padded_width * 4;
+  }
+}
+
+static void make_atlas_texture(TextureAtlas* atlas) {
+  if (atlas->size.x <= 0 || atlas->size.y <= 0) {
+    atlas->size = (vkm_ivec2){ { 2048, 2048 } };
+  }
+  atlas->layers = vkm_maxi(atlas->layers, 1);
+
+  glGenTextures(1, &atlas->texture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->texture);
+  // The other levels come from glGenerateMipmap.
+  glTexImage3D(
+    GL_TEXTURE_2D_ARRAY,
+    0,
+    GL_RGBA8,
+    atlas->size.x,
+    atlas->size.y,
+    atlas->layers,
+    0,
+    GL_RGBA,
+    GL_UNSIGNED_BYTE,
+    NULL
+  );
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+// Packs the images of each atlas, copies them all into one pixel buffer and updates the atlas from it, so that the
+// driver copies them to the texture without stalling us, and mipmaps are generated once for all of them.
+static void UploadImages(ecs_iter_t* it) {
+  const ImageData* images = ecs_field(it, ImageData, 0);
+  TextureAtlas* atlas = ecs_field(it, TextureAtlas, 2);
+  acquire_context();
+
+  if (!atlas->texture) {
+    make_atlas_texture(atlas);
+  }
+
+  gli_packed_image_t* packed = malloc(it->count * sizeof(gli_packed_image_t));
+  for (int i = 0; i < it->count; i++) {
+    packed[i] = (gli_packed_image_t){
+      .index = i,
+      .size = { { images[i].size.x + 2 * GLI_ATLAS_PADDING, images[i].size.y + 2 * GLI_ATLAS_PADDING } },
+    };
+  }
+  qsort(packed, it->count, sizeof(gli_packed_image_t), compare_image_heights);
+
+  int packed_count = 0;
+  size_t buffer_size = 0;
+  for (int i = 0; i < it->count; i++) {
+    const ImageData* image = images + packed[i].index;
+    if (!image->pixels || image->size.x <= 0 || image->size.y <= 0 || !pack_image(atlas, packed + i)) {
+      fprintf(stderr, "An image of %dx%d doesn't fit in its atlas.\n", image->size.x, image->size.y);
+      continue;
+    }
+
+    packed[i].offset = buffer_size;
+    buffer_size += (size_t)packed[i].size.x * packed[i].size.y * 4;
+    packed[packed_count++] = packed[i];
+  }
+
+  if (packed_count) {
+    if (!image_upload_buffer) {
+      glGenBuffers(1, &image_upload_buffer);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, image_upload_buffer);
+    frame_stats.buffer_binds++;
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)buffer_size, NULL, GL_STREAM_DRAW);
+    uint8_t* pixels = glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER,
+      0,
+      (GLsizeiptr)buffer_size,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+    );
+    if (pixels) {
+      for (int i = 0; i < packed_count; i++) {
+        pad_image(images + packed[i].index, pixels + packed[i].offset);
+      }
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+      glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->texture);
+      frame_stats.texture_binds++;
+      for (int i = 0; i < packed_count; i++) {
+        glTexSubImage3D(
+          GL_TEXTURE_2D_ARRAY,
+          0,
+          packed[i].x,
+          packed[i].y,
+          packed[i].layer,
+          packed[i].size.x,
+          packed[i].size.y,
+          1,
+          GL_RGBA,
+          GL_UNSIGNED_BYTE,
+          (const GLvoid*)packed[i].offset
+        );
+      }
+      glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+      frame_stats.uploaded_bytes += (int64_t)buffer_size;
+
+      for (int i = 0; i < packed_count; i++) {
+        const ImageData* image = images + packed[i].index;
+        const ecs_entity_t entity = it->entities[packed[i].index];
+        ecs_set(it->world, entity, TextureRegion, { {
+          (float)(packed[i].x + GLI_ATLAS_PADDING) / (float)atlas->size.x,
+          (float)(packed[i].y + GLI_ATLAS_PADDING) / (float)atlas->size.y,
+          (float)image->size.x / (float)atlas->size.x,
+          (float)image->size.y / (float)atlas->size.y,
+        } });
+        ecs_set(it->world, entity, TextureLayer, { (float)packed[i].layer });
+      }
+    } else {
+      fprintf(stderr, "Failed to map the pixel buffer for uploading images.\n");
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  for (int i = 0; i < it->count; i++) {
+    ecs_remove(it->world, it->entities[i], ImageData);
+  }
+  free(packed);
+  redraw_requested = true;
+}
+
+// The texture formats that KTX files can hold for us, grouped by what the driver needs to support them.
+typedef enum gli_texture_family_t {
+  GLI_TEXTURE_UNCOMPRESSED,
+  GLI_TEXTURE_S3TC,
+  GLI_TEXTURE_S3TC_SRGB,
+  GLI_TEXTURE_BPTC,
+  GLI_TEXTURE_ETC2,
+  GLI_TEXTURE_FAMILIES_COUNT,
+} gli_texture_family_t;
+
+// Set for the families that the driver takes as they are when the window is set.
+static bool texture_families_supported[GLI_TEXTURE_FAMILIES_COUNT];
+
+// Decodes a 4x4 block into RGBA pixels, row by row.
+typedef void (*gli_decode_block_t)(const uint8_t* block, uint8_t pixels[16][4]);
+
+typedef struct gli_texture_format_t {
+  // In KTX2 files, and in KTX ones.
+  uint32_t vk_format;
+  GLenum gl_format;
+  gli_texture_family_t family;
+  // Of the pixels, 4x4 blocks or single RGBA8 pixels.
+  int block_size, block_bytes;
+  // Into pixels of decoded_format, when the driver doesn't support the family. Missing when it can't be done.
+  gli_decode_block_t decode;
+  GLenum decoded_format;
+} gli_texture_format_t;
+
+static uint8_t clamp_byte(const int value) {
+  return (uint8_t)vkm_mini(vkm_maxi(value, 0), 255);
+}
+
+static void decode_rgb565(const int color, int rgb[3]) {
+  rgb[0] = (color >> 11 & 31) << 3 | (color >> 13 & 7);
+  rgb[1] = (color >> 5 & 63) << 2 | (color >> 9 & 3);
+  rgb[2] = (color & 31) << 3 | (color >> 2 & 7);
+}
+
+// The colors of BC1, BC2 and BC3 blocks. Only BC1 ones can have three colors and a transparent one.
+static void decode_s3tc_colors(const uint8_t* block, uint8_t pixels[16][4], const bool bc1, const bool alpha) {
+  const int color0 = block[0] | block[1] << 8, color1 = block[2] | block[3] << 8;
+  int palette[4][4];
+  decode_rgb565(color0, palette[0]);
+  decode_rgb565(color1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    if (!bc1 || color0 > color1) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    } else {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+  }
+  palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+  if (bc1 && alpha && color0 <= color1) {
+    palette[3][3] = 0;
+  }
+
+  const uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+  for (int i = 0; i < 16; i++) {
+    const int* color = palette[indices >> 2 * i & 3];
+    for (int c = 0; c < 4; c++) {
+      pixels[i][c] = (uint8_t)color[c];
+    }
+  }
+}
+
+static void decode_bc1_rgb(const uint8_t* block, uint8_t pixels[16][4]) {
+  decode_s3tc_colors(block, pixels, true, false);
+}
+
+static void decode_bc1_rgba(const uint8_t* block, uint8_t pixels[16][4]) {
+  decode_s3tc_colors(block, pixels, true, true);
+}
+
+static void decode_bc2(const uint8_t* block, uint8_t pixels[16][4]) {
+  decode_s3tc_colors(block + 8, pixels, false, false);
+  for (int i = 0; i < 16; i++) {
+    pixels[i][3] = (uint8_t)((block[i / 2] >> 4 * (i % 2) & 15) * 17);
+  }
+}
+
+static void decode_bc3(const uint8_t* block, uint8_t pixels[16][4]) {
+  decode_s3tc_colors(block + 8, pixels, false, false);
+  int alphas[8] = { block[0], block[1] };
+  for (int k = 2; k < 8; k++) {
+    if (alphas[0] > alphas[1]) {
+      alphas[k] = ((8 - k) * alphas[0] + (k - 1) * alphas[1]) / 7;
+    } else if (k < 6) {
+      alphas[k] = ((6 - k) * alphas[0] + (k - 1) * alphas[1]) / 5;
+    } else {
+      alphas[k] = k == 6 ? 0 : 255;
+    }
+  }
+
+  uint64_t indices = 0;
+  for (int i = 7; i >= 2; i--) {
+    indices = indices << 8 | block[i];
+  }
+  for (int i = 0; i < 16; i++) {
+    pixels[i][3] = (uint8_t)alphas[indices >> 3 * i & 7];
+  }
+}
+
+static const int etc_modifiers[8][4] = {
+  { 2, 8, -2, -8 },
+  { 5, 17, -5, -17 },
+  { 9, 29, -9, -29 },
+  { 13, 42, -13, -42 },
+  { 18, 60, -18, -60 },
+  { 24, 80, -24, -80 },
+  { 33, 106, -33, -106 },
+  { 47, 183, -47, -183 },
+};
+static const int etc_distances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+static uint64_t read_big_endian_u64(const uint8_t* bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value = value << 8 | bytes[i];
+  }
+  return value;
+}
+
+// Of 4, 5, 6 or 7 bits to 8.
+static int extend_bits(const int value, const int bits) {
+  return value << (8 - bits) | value >> (2 * bits - 8);
+}
+
+// An ETC2 RGB block, in any of its modes, with punch-through alpha if asked to. Pixel indices go down the columns.
+static void decode_etc2_colors(const uint8_t* block, uint8_t pixels[16][4], const bool punchthrough) {
+  const uint64_t bits = read_big_endian_u64(block);
+  const uint32_t high = (uint32_t)(bits >> 32), low = (uint32_t)bits;
+  // With punch-through alpha, the bit telling differential blocks apart says whether the block is opaque instead.
+  const bool differential = punchthrough || (high >> 1 & 1);
+  const bool opaque = !punchthrough || (high >> 1 & 1);
+
+  int paint[4][3];
+  // Whether the pixels choose between the four paint colors, or between modifiers of the base color of their half.
+  bool painted = true;
+  int bases[2][3], tables[2] = { high >> 5 & 7, high >> 2 & 7 };
+  if (!differential) {
+    for (int c = 0; c < 3; c++) {
+      bases[0][c] = extend_bits(high >> (28 - 8 * c) & 15, 4);
+      bases[1][c] = extend_bits(high >> (24 - 8 * c) & 15, 4);
+    }
+    painted = false;
+  } else {
+    int base[3], second[3];
+    for (int c = 0; c < 3; c++) {
+      base[c] = high >> (27 - 8 * c) & 31;
+      const int delta = high >> (24 - 8 * c) & 7;
+      second[c] = base[c] + (delta >= 4 ? delta - 8 : delta);
+    }
+
+    if (second[0] < 0 || second[0] > 31) {
+      // T mode.
+      const int first[3] = {
+        extend_bits((high >> 27 & 3) << 2 | (high >> 24 & 3), 4),
+        extend_bits(high >> 20 & 15, 4),
+        extend_bits(high >> 16 & 15, 4),
+      };
+      const int distance = etc_distances[(high >> 2 & 3) << 1 | (high & 1)];
+      for (int c = 0; c < 3; c++) {
+        const int other = extend_bits(high >> (12 - 4 * c) & 15, 4);
+        paint[0][c] = first[c];
+        paint[1][c] = clamp_byte(other + distance);
+        paint[2][c] = other;
+        paint[3][c] = clamp_byte(other - distance);
+      }
+    } else if (second[1] < 0 || second[1] > 31) {
+      // H mode.
+      const int first[3] = {
+        high >> 27 & 15,
+        (high >> 24 & 7) << 1 | (high >> 20 & 1),
+        (high >> 19 & 1) << 3 | (high >> 15 & 7),
+      };
+      const int other[3] = { high >> 11 & 15, high >> 7 & 15, high >> 3 & 15 };
+      const int order = (first[0] << 8 | first[1] << 4 | first[2]) >= (other[0] << 8 | other[1] << 4 | other[2]);
+      const int distance = etc_distances[(high >> 2 & 1) << 2 | (high & 1) << 1 | order];
+      for (int c = 0; c < 3; c++) {
+        paint[0][c] = clamp_byte(extend_bits(first[c], 4) + distance);
+        paint[1][c] = clamp_byte(extend_bits(first[c], 4) - distance);
+        paint[2][c] = clamp_byte(extend_bits(other[c], 4) + distance);
+        paint[3][c] = clamp_byte(extend_bits(other[c], 4) - distance);
+      }
+    } else if (second[2] < 0 || second[2] > 31) {
+      // Planar mode, a gradient from an origin color at the corner to colors at the right and bottom edges.
+      const int origin[3] = {
+        extend_bits(high >> 25 & 63, 6),
+        extend_bits((high >> 24 & 1) << 6 | (high >> 17 & 63), 7),
+        extend_bits((high >> 16 & 1) << 5 | (high >> 11 & 3) << 3 | (high >> 7 & 7), 6),
+      };
+      const int horizontal[3] = {
+        extend_bits((high >> 2 & 31) << 1 | (high & 1), 6),
+        extend_bits(low >> 25 & 127, 7),
+        extend_bits(low >> 19 & 63, 6),
+      };
+      const int vertical[3] = {
+        extend_bits(low >> 13 & 63, 6),
+        extend_bits(low >> 6 & 127, 7),
+        extend_bits(low & 63, 6),
+      };
+      for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+          for (int c = 0; c < 3; c++) {
+            const int value = x * (horizontal[c] - origin[c]) + y * (vertical[c] - origin[c]) + 4 * origin[c];
+            pixels[y * 4 + x][c] = clamp_byte((value + 2) >> 2);
+          }
+          pixels[y * 4 + x][3] = 255;
+        }
+      }
+      return;
+    } else {
+      for (int c = 0; c < 3; c++) {
+        bases[0][c] = extend_bits(base[c], 5);
+        bases[1][c] = extend_bits(second[c], 5);
+      }
+      painted = false;
+    }
+  }
+
+  const bool flipped = high & 1;
+  for (int x = 0; x < 4; x++) {
+    for (int y = 0; y < 4; y++) {
+      const int i = x * 4 + y;
+      const int index = (low >> (16 + i) & 1) << 1 | (low >> i & 1);
+      uint8_t* pixel = pixels[y * 4 + x];
+      if (!opaque && index == 2) {
+        pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+        continue;
+      }
+
+      if (painted) {
+        for (int c = 0; c < 3; c++) {
+          pixel[c] = (uint8_t)paint[index][c];
+        }
+      } else {
+        const int half = flipped ? y >= 2 : x >= 2;
+        // Transparent blocks give up the smaller modifiers for the transparent index.
+        const int modifier = !opaque && index == 0 ? 0 : etc_modifiers[tables[half]][index];
+        for (int c = 0; c < 3; c++) {
+          pixel[c] = clamp_byte(bases[half][c] + modifier);
+        }
+      }
+      pixel[3] = 255;
+    }
+  }
+}
+
+static void decode_etc2_rgb(const uint8_t* block, uint8_t pixels[16][4]) {
+  decode_etc2_colors(block, pixels, false);
+}
+
+static void decode_etc2_punchthrough(const uint8_t* block, uint8_t pixels[16][4]) {
+  decode_etc2_colors(block, pixels, true);
+}
+
+static void decode_etc2_eac(const uint8_t* block, uint8_t pixels[16][4]) {
+  static const int eac_modifiers[16][8] = {
+    { -3, -6, -9, -15, 2, 5, 8, 14 },
+    { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5, -8, -13, 1, 4, 7, 12 },
+    { -2, -4, -6, -13, 1, 3, 5, 12 },
+    { -3, -6, -8, -12, 2, 5, 7, 11 },
+    { -3, -7, -9, -11, 2, 6, 8, 10 },
+    { -4, -7, -8, -11, 3, 6, 7, 10 },
+    { -3, -5, -8, -11, 2, 4, 7, 10 },
+    { -2, -6, -8, -10, 1, 5, 7, 9 },
+    { -2, -5, -8, -10, 1, 4, 7, 9 },
+    { -2, -4, -8, -10, 1, 3, 7, 9 },
+    { -2, -5, -7, -10, 1, 4, 6, 9 },
+    { -3, -4, -7, -10, 2, 3, 6, 9 },
+    { -1, -2, -3, -10, 0, 1, 2, 9 },
+    { -4, -6, -8, -9, 3, 5, 7, 8 },
+    { -3, -5, -7, -9, 2, 4, 6, 8 },
+  };
+
+  decode_etc2_colors(block + 8, pixels, false);
+  const uint64_t bits = read_big_endian_u64(block);
+  const int base = block[0], multiplier = block[1] >> 4;
+  const int* modifiers = eac_modifiers[block[1] & 15];
+  for (int x = 0; x < 4; x++) {
+    for (int y = 0; y < 4; y++) {
+      const int index = bits >> (45 - 3 * (x * 4 + y)) & 7;
+      pixels[y * 4 + x][3] = clamp_byte(base + modifiers[index] * multiplier);
+    }
+  }
+}
+
+static const gli_texture_format_t texture_formats[] = {
+  { 37, GL_RGBA8, GLI_TEXTURE_UNCOMPRESSED, 1, 4, NULL, GL_RGBA8 },
+  { 43, GL_SRGB8_ALPHA8, GLI_TEXTURE_UNCOMPRESSED, 1, 4, NULL, GL_SRGB8_ALPHA8 },
+  { 131, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GLI_TEXTURE_S3TC, 4, 8, decode_bc1_rgb, GL_RGBA8 },
+  { 132, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, GLI_TEXTURE_S3TC_SRGB, 4, 8, decode_bc1_rgb, GL_SRGB8_ALPHA8 },
+  { 133, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GLI_TEXTURE_S3TC, 4, 8, decode_bc1_rgba, GL_RGBA8 },
+  { 134, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, GLI_TEXTURE_S3TC_SRGB, 4, 8, decode_bc1_rgba, GL_SRGB8_ALPHA8 },
+  { 135, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, GLI_TEXTURE_S3TC, 4, 16, decode_bc2, GL_RGBA8 },
+  { 136, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, GLI_TEXTURE_S3TC_SRGB, 4, 16, decode_bc2, GL_SRGB8_ALPHA8 },
+  { 137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GLI_TEXTURE_S3TC, 4, 16, decode_bc3, GL_RGBA8 },
+  { 138, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, GLI_TEXTURE_S3TC_SRGB, 4, 16, decode_bc3, GL_SRGB8_ALPHA8 },
+  { 145, GL_COMPRESSED_RGBA_BPTC_UNORM, GLI_TEXTURE_BPTC, 4, 16, NULL, GL_RGBA8 },
+  { 146, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, GLI_TEXTURE_BPTC, 4, 16, NULL, GL_SRGB8_ALPHA8 },
+  { 147, GL_COMPRESSED_RGB8_ETC2, GLI_TEXTURE_ETC2, 4, 8, decode_etc2_rgb, GL_RGBA8 },
+  { 148, GL_COMPRESSED_SRGB8_ETC2, GLI_TEXTURE_ETC2, 4, 8, decode_etc2_rgb, GL_SRGB8_ALPHA8 },
+  { 149, GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, GLI_TEXTURE_ETC2, 4, 8, decode_etc2_punchthrough, GL_RGBA8 },
+  {
+    150,
+    GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2,
+    GLI_TEXTURE_ETC2,
+    4,
+    8,
+    decode_etc2_punchthrough,
+    GL_SRGB8_ALPHA8,
+  },
+  { 151, GL_COMPRESSED_RGBA8_ETC2_EAC, GLI_TEXTURE_ETC2, 4, 16, decode_etc2_eac, GL_RGBA8 },
+  { 152, GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, GLI_TEXTURE_ETC2, 4, 16, decode_etc2_eac, GL_SRGB8_ALPHA8 },
+};
+
+// A file mapped read-only into memory.
+typedef struct gli_mapped_file_t {
+  const uint8_t* data;
+  size_t size;
+#ifdef GLI_WINDOWS
+  HANDLE file, mapping;
+#endif
+} gli_mapped_file_t;
+
+static bool map_file(const char* path, gli_mapped_file_t* file) {
+#ifdef GLI_WINDOWS
+  file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file->file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  file->mapping = NULL;
+  file->data = NULL;
+  if (GetFileSizeEx(file->file, &size) && size.QuadPart > 0) {
+    file->size = (size_t)size.QuadPart;
+    file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  }
+  if (file->mapping) {
+    file->data = MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+  }
+  if (!file->data) {
+    if (file->mapping) {
+      CloseHandle(file->mapping);
+    }
+    CloseHandle(file->file);
+    return false;
+  }
+  return true;
+#else
+  const int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    return false;
+  }
+
+  struct stat status;
+  void* data = MAP_FAILED;
+  if (fstat(descriptor, &status) == 0 && status.st_size > 0) {
+    file->size = (size_t)status.st_size;
+    data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  }
+  // The mapping keeps the file open on its own.
+  close(descriptor);
+  file->data = data;
+  return data != MAP_FAILED;
+#endif
+}
+
+static void unmap_file(const gli_mapped_file_t* file) {
+#ifdef GLI_WINDOWS
+  UnmapViewOfFile(file->data);
+  CloseHandle(file->mapping);
+  CloseHandle(file->file);
+#else
+  munmap((void*)file->data, file->size);
+#endif
+}
+
+#define GLI_MAX_TEXTURE_LEVELS 16
+
+// Where the levels of a texture are in its mapped file.
+typedef struct gli_texture_file_t {
+  const gli_texture_format_t* format;
+  int width, height, layers, levels_count;
+  const uint8_t* levels[GLI_MAX_TEXTURE_LEVELS];
+  uint64_t level_sizes[GLI_MAX_TEXTURE_LEVELS];
+} gli_texture_file_t;
+
+// Both formats are little-endian, like everything that we run on.
+static uint32_t read_u32(const uint8_t* bytes) {
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static uint64_t read_u64(const uint8_t* bytes) {
+  uint64_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+// Finds the levels in a file and checks that they are all there. Prints why it can't when it returns false.
+static bool read_texture_file(const char* path, const uint8_t* data, const size_t size, gli_texture_file_t* texture) {
+  static const uint8_t ktx_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+  static const uint8_t ktx2_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+  uint32_t width, height, depth, layers, faces, levels, format;
+  const bool ktx2 = size >= 80 && memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) == 0;
+  if (ktx2) {
+    format = read_u32(data + 12);
+    width = read_u32(data + 20);
+    height = read_u32(data + 24);
+    depth = read_u32(data + 28);
+    layers = read_u32(data + 32);
+    faces = read_u32(data + 36);
+    levels = read_u32(data + 40);
+    if (read_u32(data + 44) != 0) {
+      fprintf(stderr, "%s is supercompressed, which isn't supported.\n", path);
+      return false;
+    }
+  } else if (size >= 64 && memcmp(data, ktx_identifier, sizeof(ktx_identifier)) == 0) {
+    if (read_u32(data + 12) != 0x04030201) {
+      fprintf(stderr, "%s has the wrong endianness.\n", path);
+      return false;
+    }
+    format = read_u32(data + 28);
+    width = read_u32(data + 36);
+    height = read_u32(data + 40);
+    depth = read_u32(data + 44);
+    layers = read_u32(data + 48);
+    faces = read_u32(data + 52);
+    levels = read_u32(data + 56);
+  } else {
+    fprintf(stderr, "%s isn't a KTX or KTX2 file.\n", path);
+    return false;
+  }
+
+  texture->format = NULL;
+  for (unsigned i = 0; i < GLI_COUNTOF(texture_formats); i++) {
+    if ((ktx2 ? texture_formats[i].vk_format : texture_formats[i].gl_format) == format) {
+      texture->format = texture_formats + i;
+    }
+  }
+  if (!texture->format) {
+    fprintf(stderr, "%s has a texture format that isn't supported.\n", path);
+    return false;
+  }
+
+  if (width == 0 || width > 16384 || height == 0 || height > 16384 || depth > 1 || faces != 1 || layers > 2048 ||
+      levels > GLI_MAX_TEXTURE_LEVELS) {
+    fprintf(stderr, "%s isn't a 2D texture that we can load.\n", path);
+    return false;
+  }
+  texture->width = (int)width;
+  texture->height = (int)height;
+  texture->layers = vkm_maxi((int)layers, 1);
+  texture->levels_count = vkm_maxi((int)levels, 1);
+
+  // KTX2 has an index of the levels, KTX puts them one after the other with their sizes.
+  size_t offset = ktx2 ? 80 : 64 + (size_t)read_u32(data + 60);
+  for (int i = 0; i < texture->levels_count; i++) {
+    uint64_t level_offset, level_size;
+    if (ktx2) {
+      if (offset + 24 > size) {
+        break;
+      }
+      level_offset = read_u64(data + offset);
+      level_size = read_u64(data + offset + 8);
+      offset += 24;
+    } else {
+      if (offset + 4 > size) {
+        break;
+      }
+      level_offset = offset + 4;
+      level_size = read_u32(data + offset);
+      offset = level_offset + ((level_size + 3) & ~(uint64_t)3);
+    }
+    if (level_offset > size || level_size > size - level_offset) {
+      break;
+    }
+
+    // The blocks of every layer, that are all we read.
+    const int block_size = texture->format->block_size;
+    const uint64_t expected_size = (uint64_t)((vkm_maxi(texture->width >> i, 1) + block_size - 1) / block_size) *
+      (uint64_t)((vkm_maxi(texture->height >> i, 1) + block_size - 1) / block_size) *
+      (uint64_t)texture->format->block_bytes * (uint64_t)texture->layers;
+    if (level_size < expected_size) {
+      break;
+    }
+    texture->levels[i] = data + level_offset;
+    texture->level_sizes[i] = expected_size;
+    if (i == texture->levels_count - 1) {
+      return true;
+    }
+  }
+
+  fprintf(stderr, "%s is truncated.\n", path);
+  return false;
+}
+
+// Decodes the blocks of a level, layer after layer, into RGBA pixels.
+static void decode_texture_level(
+  const gli_texture_format_t* format,
+  const uint8_t* blocks,
+  const int width,
+  const int height,
+  const int layers,
+  uint8_t* pixels
+) {
+  for (int layer = 0; layer < layers; layer++) {
+    for (int block_y = 0; block_y < height; block_y += 4) {
+      for (int block_x = 0; block_x < width; block_x += 4) {
+        uint8_t block_pixels[16][4];
+        format->decode(blocks, block_pixels);
+        blocks += format->block_bytes;
+        for (int y = 0; y < vkm_mini(height - block_y, 4); y++) {
+          const size_t row = ((size_t)layer * height + block_y + y) * width + block_x;
+          memcpy(pixels + row * 4, block_pixels[y * 4], (size_t)vkm_mini(width - block_x, 4) * 4);
+        }
+      }
+    }
+  }
+}
+
+// Whether the levels of a texture are decoded on the CPU, because the driver doesn't support its format.
+static bool texture_file_decoded(const gli_texture_file_t* texture) {
+  return texture->format->block_size > 1 && !texture_families_supported[texture->format->family];
+}
+
+// What a level takes on the GPU.
+static int64_t texture_level_bytes(const gli_texture_file_t* texture, const int level) {
+  if (texture_file_decoded(texture)) {
+    return (int64_t)vkm_maxi(texture->width >> level, 1) * vkm_maxi(texture->height >> level, 1) * texture->layers * 4;
+  }
+  return (int64_t)texture->level_sizes[level];
+}
+
+// Decodes the blocks of a level into pixels big enough for it.
+static void decode_texture_file_level(const gli_texture_file_t* texture, const int level, uint8_t* pixels) {
+  const int width = vkm_maxi(texture->width >> level, 1), height = vkm_maxi(texture->height >> level, 1);
+  decode_texture_level(texture->format, texture->levels[level], width, height, texture->layers, pixels);
+}
+
+// Hands a level to the bound texture, straight from the mapped file unless the level was decoded into pixels.
+static void upload_texture_level(const gli_texture_file_t* texture, const int level, const uint8_t* pixels) {
+  const gli_texture_format_t* format = texture->format;
+  const int width = vkm_maxi(texture->width >> level, 1), height = vkm_maxi(texture->height >> level, 1);
+  if (pixels) {
+    glTexImage3D(
+      GL_TEXTURE_2D_ARRAY,
+      level,
+      (GLint)format->decoded_format,
+      width,
+      height,
+      texture->layers,
+      0,
+      GL_RGBA,
+      GL_UNSIGNED_BYTE,
+      pixels
+    );
+  } else if (format->block_size > 1) {
+    glCompressedTexImage3D(
+      GL_TEXTURE_2D_ARRAY,
+      level,
+      format->gl_format,
+      width,
+      height,
+      texture->layers,
+      0,
+      (GLsizei)texture->level_sizes[level],
+      texture->levels[level]
+    );
+  } else {
+    glTexImage3D(
+      GL_TEXTURE_2D_ARRAY,
+      level,
+      (GLint)format->gl_format,
+      width,
+      height,
+      texture->layers,
+      0,
+      GL_RGBA,
+      GL_UNSIGNED_BYTE,
+      texture->levels[level]
+    );
+  }
+  frame_stats.uploaded_bytes += texture_level_bytes(texture, level);
+}
+
+// Makes an array texture of the levels from first_level on, which becomes its base level. Returns 0 when the format
+// can't be used.
+static GLuint upload_texture_file(const char* path, const gli_texture_file_t* texture, const int first_level) {
+  const bool compressed = texture->format->block_size > 1, decoded = texture_file_decoded(texture);
+  if (decoded && !texture->format->decode) {
+    fprintf(stderr, "%s has a texture format that this driver doesn't support.\n", path);
+    return 0;
+  }
+
+  GLuint name;
+  glGenTextures(1, &name);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, name);
+  frame_stats.texture_binds++;
+
+  // Big enough for the first level, and so for all of the others.
+  uint8_t* pixels = decoded ? malloc((size_t)texture_level_bytes(texture, first_level)) : NULL;
+  for (int i = first_level; i < texture->levels_count; i++) {
+    if (decoded) {
+      decode_texture_file_level(texture, i, pixels);
+    }
+    upload_texture_level(texture, i, pixels);
+  }
+  free(pixels);
+
+  // Compressed textures can't generate their own mipmaps, so those without stay without.
+  if (texture->levels_count == 1 && !compressed) {
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+  } else {
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, first_level);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, texture->levels_count - 1);
+  }
+  glTexParameteri(
+    GL_TEXTURE_2D_ARRAY,
+    GL_TEXTURE_MIN_FILTER,
+    texture->levels_count == 1 && compressed ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR
+  );
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  return name;
+}
+
+#pragma region Texture streaming
+// What a StreamedTexture reads its levels from. The file stays mapped for as long as the texture is streamed.
+struct gli_texture_source_t {
+  gli_mapped_file_t file;
+  gli_texture_file_t texture;
+  // What the levels from each one on take on the GPU.
+  int64_t bytes_from[GLI_MAX_TEXTURE_LEVELS + 1];
+  // Only for the main thread: the finest level wanted by the entities measured in this frame.
+  int measured_level;
+  // Protected by the mutex: the level being read, -1 if none, whether it's done, and its pixels if it was decoded.
+  int reading_level;
+  bool read;
+  uint8_t* pixels;
+  // Set when the component goes away while its level is being read, leaving the source to the thread to free.
+  bool released;
+};
+
+static ecs_query_t* streamed_textures_query;
+static ecs_os_thread_t streaming_thread;
+static ecs_os_mutex_t streaming_mutex;
+static ecs_os_cond_t streaming_cond;
+// Protected by the mutex: the sources with a level to read, in order.
+static gli_texture_source_t** streaming_queue;
+static int streaming_queue_count, streaming_queue_capacity;
+static bool streaming_thread_quit;
+
+static void free_texture_source(gli_texture_source_t* source) {
+  free(source->pixels);
+  unmap_file(&source->file);
+  free(source);
+}
+
+static void release_texture_source(gli_texture_source_t* source) {
+  if (!source) {
+    return;
+  }
+
+  if (streaming_mutex) {
+    ecs_os_mutex_lock(streaming_mutex);
+  }
+  const bool reading = source->reading_level >= 0 && !source->read;
+  source->released = reading;
+  if (streaming_mutex) {
+    ecs_os_mutex_unlock(streaming_mutex);
+  }
+
+  if (!reading) {
+    free_texture_source(source);
+  }
+}
+
+ECS_CTOR(StreamedTexture, ptr, {
+  *ptr = (StreamedTexture){ 0 };
+})
+
+ECS_MOVE(StreamedTexture, dst, src, {
+  release_texture_source(dst->source);
+  *dst = *src;
+  *src = (StreamedTexture){ 0 };
+})
+
+ECS_DTOR(StreamedTexture, ptr, {
+  release_texture_source(ptr->source);
+  *ptr = (StreamedTexture){ 0 };
+})
+
+// Reads a level so that uploading it doesn't wait for the disk: decoded if it has to be, or else touched page by page
+// to fault the mapping in.
+static uint8_t* read_texture_source_level(const gli_texture_source_t* source, const int level) {
+  const gli_texture_file_t* texture = &source->texture;
+  if (texture_file_decoded(texture)) {
+    uint8_t* pixels = malloc((size_t)texture_level_bytes(texture, level));
+    decode_texture_file_level(texture, level, pixels);
+    return pixels;
+  }
+
+  volatile uint8_t touched = 0;
+  for (uint64_t offset = 0; offset < texture->level_sizes[level]; offset += 4096) {
+    touched ^= texture->levels[level][offset];
+  }
+  (void)touched;
+  return NULL;
+}
+
+static void* streaming_thread_main(void* argument) {
+  (void)argument;
+
+  ecs_os_mutex_lock(streaming_mutex);
+  while (true) {
+    while (!streaming_queue_count && !streaming_thread_quit) {
+      ecs_os_cond_wait(streaming_cond, streaming_mutex);
+    }
+    if (streaming_thread_quit) {
+      break;
+    }
+
+    gli_texture_source_t* source = streaming_queue[0];
+    streaming_queue_count--;
+    memmove(streaming_queue, streaming_queue + 1, streaming_queue_count * sizeof(gli_texture_source_t*));
+    if (source->released) {
+      free_texture_source(source);
+      continue;
+    }
+    const int level = source->reading_level;
+    ecs_os_mutex_unlock(streaming_mutex);
+
+    uint8_t* pixels = read_texture_source_level(source, level);
+
+    ecs_os_mutex_lock(streaming_mutex);
+    source->pixels = pixels;
+    source->read = true;
+    if (source->released) {
+      free_texture_source(source);
+    }
+  }
+  ecs_os_mutex_unlock(streaming_mutex);
+  return NULL;
+}
+
+// Must be called with the mutex locked.
+static void request_texture_level(gli_texture_source_t* source, const int level) {
+  source->reading_level = level;
+  source->read = false;
+#ifdef GLI_EMSCRIPTEN
+  source->pixels = read_texture_source_level(source, level);
+  source->read = true;
+#else
+  if (!streaming_thread) {
+    streaming_thread = ecs_os_thread_new(streaming_thread_main, NULL);
+  }
+  if (streaming_queue_count == streaming_queue_capacity) {
+    streaming_queue_capacity = streaming_queue_capacity ? streaming_queue_capacity * 2 : 16;
+    streaming_queue = realloc(streaming_queue, streaming_queue_capacity * sizeof(gli_texture_source_t*));
+  }
+  streaming_queue[streaming_queue_count++] = source;
+  ecs_os_cond_signal(streaming_cond);
+#endif
+}
+
+static void stop_streaming_thread(void) {
+  if (!streaming_mutex) {
+    return;
+  }
+
+  if (streaming_thread) {
+    ecs_os_mutex_lock(streaming_mutex);
+    streaming_thread_quit = true;
+    ecs_os_cond_broadcast(streaming_cond);
+    ecs_os_mutex_unlock(streaming_mutex);
+    ecs_os_thread_join(streaming_thread);
+    streaming_thread = 0;
+    streaming_thread_quit = false;
+  }
+
+  // What was still queued won't be read.
+  for (int i = 0; i < streaming_queue_count; i++) {
+    if (streaming_queue[i]->released) {
+      free_texture_source(streaming_queue[i]);
+    } else {
+      streaming_queue[i]->reading_level = -1;
+    }
+  }
+  free(streaming_queue);
+  streaming_queue = NULL;
+  streaming_queue_count = streaming_queue_capacity = 0;
+
+  ecs_os_cond_free(streaming_cond);
+  ecs_os_mutex_free(streaming_mutex);
+  streaming_mutex = 0;
+}
+
+// Keeps a loaded file mapped for streaming, with only the levels from tail_level on resident. Takes the file.
+static void stream_texture(
+  ecs_world_t* world,
+  const ecs_entity_t entity,
+  const gli_mapped_file_t* file,
+  const gli_texture_file_t* texture,
+  const int tail_level
+) {
+  gli_texture_source_t* source = malloc(sizeof(gli_texture_source_t));
+  *source = (gli_texture_source_t){
+    .file = *file,
+    .texture = *texture,
+    .measured_level = tail_level,
+    .reading_level = -1,
+  };
+  for (int i = texture->levels_count - 1; i >= 0; i--) {
+    source->bytes_from[i] = source->bytes_from[i + 1] + texture_level_bytes(texture, i);
+  }
+
+  ecs_set(world, entity, StreamedTexture, {
+    .wanted_level = tail_level,
+    .target_level = tail_level,
+    .resident_level = tail_level,
+    .tail_level = tail_level,
+    .source = source,
+  });
+}
+
+// Lowers the level that a texture wants to the one whose texels are about as big as the pixels that an entity showing
+// it covers, taking its mesh to span a unit of length.
+static void want_texture_level(const StreamedTexture* streamed_texture, const TextureRegion* region, vkm_vec2 pixels) {
+  gli_texture_source_t* source = streamed_texture->source;
+  const float texels_per_pixel = vkm_maxf(
+    region->z * (float)source->texture.width / vkm_maxf(pixels.x, FLT_EPSILON),
+    region->w * (float)source->texture.height / vkm_maxf(pixels.y, FLT_EPSILON)
+  );
+  const int level = texels_per_pixel > 1.0f ? (int)log2f(texels_per_pixel) : 0;
+  source->measured_level = vkm_mini(source->measured_level, level);
+}
+
+static void MeasureStreamedTextures2D(ecs_iter_t* it) {
+  if (skip_rendering) {
+    return;
+  }
+
+  const Scale2D* scales = ecs_field(it, Scale2D, 2);
+  const TextureRegion* regions = ecs_field(it, TextureRegion, 3);
+  const StreamedTexture* streamed_texture = ecs_field(it, StreamedTexture, 5);
+  const Camera2D* camera = ecs_field(it, Camera2D, 6);
+
+  const bool own_scales = scales && ecs_field_is_self(it, 2), own_regions = ecs_field_is_self(it, 3);
+  for (int i = 0; i < it->count; i++) {
+    const Scale2D scale = scales ? scales[own_scales ? i : 0] : (Scale2D){ { 1.0f, 1.0f } };
+    const vkm_vec2 pixels = { { fabsf(scale.x) * camera->zoom, fabsf(scale.y) * camera->zoom } };
+    want_texture_level(streamed_texture, regions + (own_regions ? i : 0), pixels);
+  }
+}
+
+static void MeasureStreamedTextures3D(ecs_iter_t* it) {
+  if (skip_rendering) {
+    return;
+  }
+
+  const Position3D* positions = ecs_field(it, Position3D, 1);
+  const Scale3D* scales = ecs_field(it, Scale3D, 2);
+  const TextureRegion* regions = ecs_field(it, TextureRegion, 3);
+  const StreamedTexture* streamed_texture = ecs_field(it, StreamedTexture, 5);
+  const Camera3D* camera = ecs_field(it, Camera3D, 6);
+  const Position3D* camera_position = ecs_field(it, Position3D, 7);
+  const GLitchWindow* window = ecs_field(it, GLitchWindow, 8);
+
+  // How many pixels a unit of length covers at a unit of distance in front of the camera.
+  const float pixels_per_unit =
+    (float)window->size.y / (2.0f * vkm_tan(camera->field_of_view * CVKM_DEG_2_RAD_F * 0.5f));
+
+  const bool own_scales = scales && ecs_field_is_self(it, 2), own_regions = ecs_field_is_self(it, 3);
+  for (int i = 0; i < it->count; i++) {
+    const Scale3D* scale = scales ? scales + (own_scales ? i : 0) : NULL;
+    const float size = scale ? vkm_maxf(vkm_maxf(fabsf(scale->x), fabsf(scale->y)), fabsf(scale->z)) : 1.0f;
+    vkm_vec3 offset;
+    vkm_sub(positions + i, camera_position, &offset);
+    const float distance = vkm_maxf(vkm_magnitude(&offset) - size * 0.5f, camera->near_plane);
+    const float pixels = size * pixels_per_unit / distance;
+    want_texture_level(streamed_texture, regions + (own_regions ? i : 0), (vkm_vec2){ { pixels, pixels } });
+  }
+}
+
+// Uploads the levels read by the background thread, evicts those that aren't needed anymore, and asks for the next
+// ones, one level per texture at a time from the coarsest.
+static void StreamTextures(ecs_iter_t* it) {
+  TextureStreaming* streaming = ecs_field(it, TextureStreaming, 0);
+  const int64_t budget = streaming->budget > 0 ? streaming->budget : (int64_t)256 << 20;
+
+  // What every texture would take with each number of levels dropped.
+  int64_t biased_bytes[GLI_MAX_TEXTURE_LEVELS] = { 0 };
+  streaming->textures = 0;
+  streaming->resident_bytes = 0;
+  ecs_iter_t textures_it = ecs_query_iter(it->world, streamed_textures_query);
+  while (ecs_query_next(&textures_it)) {
+    StreamedTexture* streamed_textures = ecs_field(&textures_it, StreamedTexture, 0);
+    for (int i = 0; i < textures_it.count; i++) {
+      StreamedTexture* streamed_texture = streamed_textures + i;
+      gli_texture_source_t* source = streamed_texture->source;
+      if (!skip_rendering) {
+        streamed_texture->wanted_level = source->measured_level;
+        source->measured_level = streamed_texture->tail_level;
+      }
+      for (int bias = 0; bias < GLI_MAX_TEXTURE_LEVELS; bias++) {
+        const int level = vkm_mini(streamed_texture->wanted_level + bias, streamed_texture->tail_level);
+        biased_bytes[bias] += source->bytes_from[level];
+      }
+      streaming->textures++;
+      streaming->resident_bytes += source->bytes_from[streamed_texture->resident_level];
+    }
+  }
+  streaming->wanted_bytes = biased_bytes[0];
+  streaming->bias = 0;
+  while (streaming->bias < GLI_MAX_TEXTURE_LEVELS - 1 && biased_bytes[streaming->bias] > budget) {
+    streaming->bias++;
+  }
+
+  if (!streaming_mutex) {
+    streaming_mutex = ecs_os_mutex_new();
+    streaming_cond = ecs_os_cond_new();
+  }
+  streaming->pending_levels = streaming->loaded_levels = streaming->evicted_levels = 0;
+  ecs_os_mutex_lock(streaming_mutex);
+  textures_it = ecs_query_iter(it->world, streamed_textures_query);
+  while (ecs_query_next(&textures_it)) {
+    StreamedTexture* streamed_textures = ecs_field(&textures_it, StreamedTexture, 0);
+    const TextureAtlas* atlases = ecs_field(&textures_it, TextureAtlas, 1);
+    for (int i = 0; i < textures_it.count; i++) {
+      StreamedTexture* streamed_texture = streamed_textures + i;
+      gli_texture_source_t* source = streamed_texture->source;
+      const int target = vkm_mini(streamed_texture->wanted_level + streaming->bias, streamed_texture->tail_level);
+      streamed_texture->target_level = target;
+
+      // A level that was read goes in if it's still the next one wanted.
+      if (source->reading_level >= 0 && source->read) {
+        const int level = source->reading_level;
+        if (level == streamed_texture->resident_level - 1 && level >= target) {
+          acquire_context();
+          glBindTexture(GL_TEXTURE_2D_ARRAY, atlases[i].texture);
+          frame_stats.texture_binds++;
+          upload_texture_level(&source->texture, level, source->pixels);
+          glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+          streaming->resident_bytes += texture_level_bytes(&source->texture, level);
+          streaming->loaded_levels++;
+          streamed_texture->resident_level = level;
+        }
+        free(source->pixels);
+        source->pixels = NULL;
+        source->reading_level = -1;
+        source->read = false;
+      }
+
+      // Over budget, levels go as soon as they aren't needed. Otherwise one more is kept, so that entities sitting
+      // right at the size of a level don't make it come and go.
+      const int evicted_until = streaming->resident_bytes > budget ? target : target - 1;
+      if (streamed_texture->resident_level < evicted_until) {
+        acquire_context();
+        glBindTexture(GL_TEXTURE_2D_ARRAY, atlases[i].texture);
+        frame_stats.texture_binds++;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, evicted_until);
+        for (int level = streamed_texture->resident_level; level < evicted_until; level++) {
+          // An empty image frees the memory of the level.
+          glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+          streaming->resident_bytes -= texture_level_bytes(&source->texture, level);
+          streaming->evicted_levels++;
+        }
+        streamed_texture->resident_level = evicted_until;
+      }
+
+      if (source->reading_level < 0 && target < streamed_texture->resident_level) {
+        request_texture_level(source, streamed_texture->resident_level - 1);
+      }
+      streaming->pending_levels += source->reading_level >= 0;
+    }
+  }
+  ecs_os_mutex_unlock(streaming_mutex);
+
+  // Frames keep coming while levels are on their way, even with RenderOnDemand.
+  if (streaming->pending_levels || streaming->loaded_levels || streaming->evicted_levels) {
+    redraw_requested = true;
+  }
+}
+
+static void OnAddTextureStreaming(ecs_iter_t* it) {
+  streamed_textures_query = ecs_query(it->world, {
+    .terms = {
+      { .id = ecs_id(StreamedTexture), .inout = EcsInOut },
+      { .id = ecs_id(TextureAtlas), .inout = EcsIn },
+    },
+    .cache_kind = EcsQueryCacheAuto,
+  });
+}
+
+static void OnRemoveTextureStreaming(ecs_iter_t* it) {
+  (void)it;
+  stop_streaming_thread();
+  ecs_query_fini(streamed_textures_query);
+  streamed_textures_query = NULL;
+}
+#pragma endregion
+
+static void LoadTextureFiles(ecs_iter_t* it) {
+  const TextureFile* files = ecs_field(it, TextureFile, 0);
+  const bool streaming = ecs_field_is_set(it, 2);
+  acquire_context();
+
+  for (int i = 0; i < it->count; i++) {
+    const ecs_entity_t entity = it->entities[i];
+    const char* path = files[i].path ? files[i].path : "";
+    gli_mapped_file_t file;
+    gli_texture_file_t texture;
+    GLuint name = 0;
+    if (!map_file(path, &file)) {
+      fprintf(stderr, "Cannot open %s.\n", path);
+    } else {
+      // Streamed textures start with their smallest levels, and keep the file mapped for the others.
+      int tail_level = 0;
+      if (read_texture_file(path, file.data, file.size, &texture)) {
+        while (
+          streaming
+          && tail_level < texture.levels_count - 1
+          && vkm_maxi(texture.width, texture.height) >> tail_level > GLI_STREAMING_TAIL_SIZE
+        ) {
+          tail_level++;
+        }
+        name = upload_texture_file(path, &texture, tail_level);
+      }
+
+      if (name && tail_level > 0) {
+        stream_texture(it->world, entity, &file, &texture, tail_level);
+      } else {
+        unmap_file(&file);
+      }
+    }
+
+    if (name) {
+      ecs_set(it->world, entity, TextureAtlas, {
+        .size = { { texture.width, texture.height } },
+        .layers = texture.layers,
+        .texture = name,
+        .layer = texture.layers,
+      });
+      ecs_set(it->world, entity, TextureRegion, { { 0.0f, 0.0f, 1.0f, 1.0f } });
+      ecs_set(it->world, entity, TextureLayer, { 0.0f });
+    }
+    ecs_remove(it->world, entity, TextureFile);
+  }
+  redraw_requested = true;
+}
+
+#pragma region Model files
+typedef enum gli_json_type_t {
+  GLI_JSON_OBJECT,
+  GLI_JSON_ARRAY,
+  GLI_JSON_STRING,
+  // Numbers, true, false and null.
+  GLI_JSON_PRIMITIVE,
+} gli_json_type_t;
+
+// A value of a JSON document, pointing into its text.
+typedef struct gli_json_token_t {
+  gli_json_type_t type;
+  // Without the quotes of strings.
+  int start, end;
+  // Counting both the keys and the values of objects.
+  int children;
+  // The token after this one and all of its children.
+  int next;
+} gli_json_token_t;
+
+#define GLI_MAX_JSON_DEPTH 64
+
+// Splits the whole document into tokens in a single pass. Lenient with commas and colons, strict with nesting.
+static gli_json_token_t* parse_json(const char* text, const int length, int* tokens_count) {
+  int capacity = 256, count = 0, depth = 0;
+  int open[GLI_MAX_JSON_DEPTH];
+  gli_json_token_t* tokens = malloc(capacity * sizeof(gli_json_token_t));
+  for (int i = 0; i < length; i++) {
+    const char c = text[i];
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' || c == ':') {
+      continue;
+    }
+
+    if (c == '}' || c == ']') {
+      if (depth == 0 || tokens[open[depth - 1]].type != (c == '}' ? GLI_JSON_OBJECT : GLI_JSON_ARRAY)) {
+        goto invalid;
+      }
+      gli_json_token_t* container = tokens + open[--depth];
+      container->end = i + 1;
+      container->next = count;
+      continue;
+    }
+
+    // A single value at the top.
+    if (depth == 0 && count > 0) {
+      goto invalid;
+    }
+    if (count == capacity) {
+      capacity *= 2;
+      tokens = realloc(tokens, capacity * sizeof(gli_json_token_t));
+    }
+    if (depth > 0) {
+      tokens[open[depth - 1]].children++;
+    }
+    gli_json_token_t* token = tokens + count++;
+    token->start = i;
+    token->children = 0;
+
+    if (c == '{' || c == '[') {
+      if (depth == GLI_MAX_JSON_DEPTH) {
+        goto invalid;
+      }
+      token->type = c == '{' ? GLI_JSON_OBJECT : GLI_JSON_ARRAY;
+      open[depth++] = count - 1;
+      continue;
+    }
+
+    if (c == '"') {
+      token->type = GLI_JSON_STRING;
+      token->start = i + 1;
+      for (i++; i < length && text[i] != '"'; i++) {
+        if (text[i] == '\\') {
+          i++;
+        }
+      }
+      if (i >= length) {
+        goto invalid;
+      }
+      token->end = i;
+    } else {
+      token->type = GLI_JSON_PRIMITIVE;
+      while (i + 1 < length && !strchr(" \t\r\n,:]}", text[i + 1])) {
+        i++;
+      }
+      token->end = i + 1;
+    }
+    token->next = count;
+  }
+
+  if (depth == 0 && count > 0) {
+    *tokens_count = count;
+    return tokens;
+  }
+
+invalid:
+  free(tokens);
+  return NULL;
+}
+
+// The value of a member of an object, or -1.
+static int json_member(const char* text, const gli_json_token_t* tokens, const int object, const char* key) {
+  if (object < 0 || tokens[object].type != GLI_JSON_OBJECT) {
+    return -1;
+  }
+
+  const size_t key_length = strlen(key);
+  // Keys are followed by their values.
+  const int end = tokens[object].next;
+  for (int i = object + 1; i < end && tokens[i].next < end; i = tokens[tokens[i].next].next) {
+    if (
+      tokens[i].type == GLI_JSON_STRING
+      && (size_t)(tokens[i].end - tokens[i].start) == key_length
+      && memcmp(text + tokens[i].start, key, key_length) == 0
+    ) {
+      return tokens[i].next;
+    }
+  }
+  return -1;
+}
+
+// The tokens of the elements of an array, none if it isn't one.
+static int* json_elements(const gli_json_token_t* tokens, const int array, int* count) {
+  *count = 0;
+  if (array < 0 || tokens[array].type != GLI_JSON_ARRAY) {
+    return NULL;
+  }
+
+  int* elements = malloc(tokens[array].children * sizeof(int));
+  for (int i = array + 1; i < tokens[array].next; i = tokens[i].next) {
+    elements[(*count)++] = i;
+  }
+  return elements;
+}
+
+static double json_number(const char* text, const gli_json_token_t* tokens, const int token, const double fallback) {
+  if (token < 0 || tokens[token].type != GLI_JSON_PRIMITIVE) {
+    return fallback;
+  }
+
+  // The text isn't terminated where the number ends.
+  char buffer[64];
+  const int length = tokens[token].end - tokens[token].start;
+  if (length >= (int)sizeof(buffer)) {
+    return fallback;
+  }
+  memcpy(buffer, text + tokens[token].start, length);
+  buffer[length] = '\0';
+  char* end;
+  const double value = strtod(buffer, &end);
+  return end == buffer + length ? value : fallback;
+}
+
+// A non-negative integer, the fallback if the token is missing, or -1 if it isn't one. Counts, indices, offsets and
+// enumerations in glTF are all of those.
+static int64_t json_integer(
+  const char* text,
+  const gli_json_token_t* tokens,
+  const int token,
+  const int64_t fallback
+) {
+  if (token < 0) {
+    return fallback;
+  }
+  const double value = json_number(text, tokens, token, -1.0);
+  return value >= 0.0 && value < 9007199254740992.0 && (double)(int64_t)value == value ? (int64_t)value : -1;
+}
+
+static bool json_string_is(const char* text, const gli_json_token_t* tokens, const int token, const char* string) {
+  return token >= 0
+    && tokens[token].type == GLI_JSON_STRING
+    && (size_t)(tokens[token].end - tokens[token].start) == strlen(string)
+    && memcmp(text + tokens[token].start, string, strlen(string)) == 0;
+}
+
+static bool json_true(const char* text, const gli_json_token_t* tokens, const int token) {
+  return token >= 0 && tokens[token].type == GLI_JSON_PRIMITIVE && text[tokens[token].start] == 't';
+}
+
+// Reads an array of exactly count numbers, leaving the values alone otherwise.
+static void json_floats(
+  const char* text,
+  const gli_json_token_t* tokens,
+  const int token,
+  float* values,
+  const int count
+) {
+  if (token < 0 || tokens[token].type != GLI_JSON_ARRAY || tokens[token].children != count) {
+    return;
+  }
+  for (int i = 0, element = token + 1; i < count; i++, element = tokens[element].next) {
+    values[i] = (float)json_number(text, tokens, element, values[i]);
+  }
+}
+
+#define GLI_GLB_MAGIC 0x46546C67
+#define GLI_GLB_JSON 0x4E4F534A
+#define GLI_GLB_BIN 0x004E4942
+// Accessors are copied in pieces of about this many bytes, so that big ones are shared by the workers.
+#define GLI_MODEL_COPY_SIZE (256 * 1024)
+#define GLI_MAX_MODEL_THREADS 8
+
+// The elements of an accessor, checked against the buffer.
+typedef struct gli_accessor_t {
+  gli_data_type_t type;
+  bool normalized;
+  size_t count;
+  // NULL when it has no buffer view, so it's all zeros.
+  const uint8_t* data;
+  size_t stride;
+  // Replacements for some of the elements, tightly packed.
+  size_t sparse_count;
+  const uint8_t* sparse_indices, *sparse_values;
+  int sparse_index_size;
+} gli_accessor_t;
+
+// A piece of an accessor to copy into MeshData.
+typedef struct gli_accessor_copy_t {
+  const uint8_t* source;
+  uint8_t* destination;
+  size_t stride, size, count;
+  // The size of the source elements when widening indices to unsigned, zero when they're copied as they are.
+  int index_size;
+} gli_accessor_copy_t;
+
+// The file of a model, mapped until the loader and every MeshData borrowing from it are done with it.
+typedef struct gli_model_mapping_t {
+  gli_mapped_file_t file;
+  int32_t references;
+} gli_model_mapping_t;
+
+// Releases MeshData borrowing from the file of a model, freeing whatever was copied instead.
+static void release_model_mapping(const void* data, const unsigned* indices, void* context) {
+  gli_model_mapping_t* mapping = context;
+  const uintptr_t begin = (uintptr_t)mapping->file.data, end = begin + mapping->file.size;
+  // What isn't in the file was copied, and is owned.
+  if ((uintptr_t)data < begin || (uintptr_t)data >= end) {
+    free((void*)data);
+  }
+  if ((uintptr_t)indices < begin || (uintptr_t)indices >= end) {
+    free((void*)indices);
+  }
+  if (!ecs_os_adec(&mapping->references)) {
+    unmap_file(&mapping->file);
+    free(mapping);
+  }
+}
+
+typedef struct gli_model_t {
+  gli_model_mapping_t* mapping;
+  const char* path, *json;
+  const gli_json_token_t* tokens;
+  const uint8_t* bin;
+  size_t bin_size;
+  int* accessors, *views;
+  int accessors_count, views_count;
+  gli_accessor_copy_t* copies;
+  int copies_count, copies_capacity;
+  // Sparse accessors are applied after the copies, with the elements they replace.
+  gli_accessor_t* sparse;
+  uint8_t** sparse_destinations;
+  int sparse_count, sparse_capacity;
+  size_t copied_bytes;
+  // Claimed by the workers one by one.
+  int32_t next_copy;
+} gli_model_t;
+
+// The bytes of a buffer view from an offset, if it has that many.
+static const uint8_t* read_buffer_view(
+  const gli_model_t* model,
+  const int64_t index,
+  const int64_t offset,
+  const size_t size,
+  size_t* stride
+) {
+  if (index < 0 || index >= model->views_count || offset < 0 || !model->bin) {
+    return NULL;
+  }
+
+  const int view = model->views[index];
+  const int64_t buffer = json_integer(
+    model->json,
+    model->tokens,
+    json_member(model->json, model->tokens, view, "buffer"),
+    -1
+  );
+  const int64_t view_offset = json_integer(
+    model->json,
+    model->tokens,
+    json_member(model->json, model->tokens, view, "byteOffset"),
+    0
+  );
+  const int64_t length = json_integer(
+    model->json,
+    model->tokens,
+    json_member(model->json, model->tokens, view, "byteLength"),
+    -1
+  );
+  if (
+    buffer != 0
+    || view_offset < 0
+    || length < 0
+    || (uint64_t)view_offset + (uint64_t)length > model->bin_size
+    || (uint64_t)offset + size > (uint64_t)length
+  ) {
+    return NULL;
+  }
+  if (stride) {
+    *stride = (size_t)json_integer(
+      model->json,
+      model->tokens,
+      json_member(model->json, model->tokens, view, "byteStride"),
+      0
+    );
+  }
+  return model->bin + view_offset + offset;
+}
+
+static bool read_accessor(const gli_model_t* model, const int64_t index, gli_accessor_t* accessor) {
+  if (index < 0 || index >= model->accessors_count) {
+    return false;
+  }
+
+  const char* json = model->json;
+  const gli_json_token_t* tokens = model->tokens;
+  const int token = model->accessors[index];
+  const int type = json_member(json, tokens, token, "type");
+  const int components = json_string_is(json, tokens, type, "SCALAR") ? 1
+    : json_string_is(json, tokens, type, "VEC2") ? 2
+    : json_string_is(json, tokens, type, "VEC3") ? 3
+    : json_string_is(json, tokens, type, "VEC4") ? 4
+    : 0;
+  const int64_t component_type = json_integer(json, tokens, json_member(json, tokens, token, "componentType"), -1);
+  // The component types of glTF, from GL_BYTE to GL_FLOAT without GL_INT, follow the order of gli_data_type_t.
+  if (!components || component_type < GL_BYTE || component_type > GL_FLOAT || component_type == GL_INT) {
+    return false;
+  }
+
+  *accessor = (gli_accessor_t){
+    .type = (gli_data_type_t)(GLI_BYTE + (GLI_BVEC2 - GLI_BYTE) * (components - 1) + component_type - GL_BYTE),
+    .normalized = json_true(json, tokens, json_member(json, tokens, token, "normalized")),
+  };
+  const size_t size = type_infos[accessor->type].size;
+  const int64_t count = json_integer(json, tokens, json_member(json, tokens, token, "count"), -1);
+  if (count < 1 || count > INT_MAX / (int64_t)size) {
+    return false;
+  }
+  accessor->count = (size_t)count;
+
+  const int view = json_member(json, tokens, token, "bufferView");
+  if (view >= 0) {
+    const int64_t offset = json_integer(json, tokens, json_member(json, tokens, token, "byteOffset"), 0);
+    if (!read_buffer_view(model, json_integer(json, tokens, view, -1), offset, size, &accessor->stride)) {
+      return false;
+    }
+    if (!accessor->stride) {
+      accessor->stride = size;
+    }
+    accessor->data = read_buffer_view(
+      model,
+      json_integer(json, tokens, view, -1),
+      offset,
+      (accessor->count - 1) * accessor->stride + size,
+      NULL
+    );
+    if (!accessor->data) {
+      return false;
+    }
+  }
+
+  const int sparse = json_member(json, tokens, token, "sparse");
+  if (sparse >= 0) {
+    const int indices = json_member(json, tokens, sparse, "indices");
+    const int values = json_member(json, tokens, sparse, "values");
+    const int64_t sparse_count = json_integer(json, tokens, json_member(json, tokens, sparse, "count"), -1);
+    const int64_t index_type = json_integer(json, tokens, json_member(json, tokens, indices, "componentType"), -1);
+    accessor->sparse_index_size = index_type == GL_UNSIGNED_BYTE ? 1
+      : index_type == GL_UNSIGNED_SHORT ? 2
+      : index_type == GL_UNSIGNED_INT ? 4
+      : 0;
+    if (sparse_count < 1 || sparse_count > count || !accessor->sparse_index_size) {
+      return false;
+    }
+    accessor->sparse_count = (size_t)sparse_count;
+    accessor->sparse_indices = read_buffer_view(
+      model,
+      json_integer(json, tokens, json_member(json, tokens, indices, "bufferView"), -1),
+      json_integer(json, tokens, json_member(json, tokens, indices, "byteOffset"), 0),
+      accessor->sparse_count * accessor->sparse_index_size,
+      NULL
+    );
+    accessor->sparse_values = read_buffer_view(
+      model,
+      json_integer(json, tokens, json_member(json, tokens, values, "bufferView"), -1),
+      json_integer(json, tokens, json_member(json, tokens, values, "byteOffset"), 0),
+      accessor->sparse_count * size,
+      NULL
+    );
+    if (!accessor->sparse_indices || !accessor->sparse_values) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Queues the copies of an accessor into the destination, as unsigned elements for indices.
+static void copy_accessor_later(
+  gli_model_t* model,
+  const gli_accessor_t* accessor,
+  uint8_t* destination,
+  const bool indices
+) {
+  const size_t source_size = type_infos[accessor->type].size;
+  const size_t size = indices ? sizeof(unsigned) : source_size;
+  const size_t chunk = GLI_MODEL_COPY_SIZE / size;
+  for (size_t first = 0; first < accessor->count; first += chunk) {
+    if (model->copies_count == model->copies_capacity) {
+      model->copies_capacity = vkm_maxi(model->copies_capacity * 2, 64);
+      model->copies = realloc(model->copies, model->copies_capacity * sizeof(gli_accessor_copy_t));
+    }
+    model->copies[model->copies_count++] = (gli_accessor_copy_t){
+      .source = accessor->data ? accessor->data + first * accessor->stride : NULL,
+      .destination = destination + first * size,
+      .stride = accessor->stride,
+      .size = size,
+      .count = accessor->count - first < chunk ? accessor->count - first : chunk,
+      .index_size = indices && source_size < sizeof(unsigned) ? (int)source_size : 0,
+    };
+  }
+  model->copied_bytes += accessor->count * size;
+
+  if (accessor->sparse_count) {
+    if (model->sparse_count == model->sparse_capacity) {
+      model->sparse_capacity = vkm_maxi(model->sparse_capacity * 2, 8);
+      model->sparse = realloc(model->sparse, model->sparse_capacity * sizeof(gli_accessor_t));
+      model->sparse_destinations = realloc(model->sparse_destinations, model->sparse_capacity * sizeof(uint8_t*));
+    }
+    model->sparse[model->sparse_count] = *accessor;
+    model->sparse_destinations[model->sparse_count++] = destination;
+  }
+}
+
+static void copy_accessor(const gli_accessor_copy_t* copy) {
+  if (!copy->source) {
+    memset(copy->destination, 0, copy->count * copy->size);
+  } else if (copy->index_size == 1) {
+    unsigned* destination = (unsigned*)copy->destination;
+    for (size_t i = 0; i < copy->count; i++) {
+      destination[i] = copy->source[i * copy->stride];
+    }
+  } else if (copy->index_size == 2) {
+    unsigned* destination = (unsigned*)copy->destination;
+    for (size_t i = 0; i < copy->count; i++) {
+      uint16_t index;
+      memcpy(&index, copy->source + i * copy->stride, sizeof(index));
+      destination[i] = index;
+    }
+  } else if (copy->stride == copy->size) {
+    memcpy(copy->destination, copy->source, copy->count * copy->size);
+  } else {
+    for (size_t i = 0; i < copy->count; i++) {
+      memcpy(copy->destination + i * copy->size, copy->source + i * copy->stride, copy->size);
+    }
+  }
+}
+
+static void* copy_accessors_main(void* argument) {
+  gli_model_t* model = argument;
+  for (int i = ecs_os_ainc(&model->next_copy) - 1; i < model->copies_count; i = ecs_os_ainc(&model->next_copy) - 1) {
+    copy_accessor(model->copies + i);
+  }
+  return NULL;
+}
+
+static int processors_count(void) {
+#ifdef GLI_WINDOWS
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#elif defined(GLI_LINUX)
+  return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+  return 1;
+#endif
+}
+
+// Runs the queued copies on as many threads as it's worth, then the sparse accessors on top.
+static void copy_accessors(gli_model_t* model) {
+  ecs_os_thread_t threads[GLI_MAX_MODEL_THREADS - 1];
+  int threads_count = 0;
+#ifndef GLI_EMSCRIPTEN
+  // Threads are only worth starting for a few copies each.
+  const size_t worth_threads = model->copied_bytes / (4 * GLI_MODEL_COPY_SIZE);
+  threads_count = vkm_mini(processors_count(), GLI_MAX_MODEL_THREADS);
+  if (worth_threads < (size_t)threads_count) {
+    threads_count = (int)worth_threads;
+  }
+  threads_count = vkm_maxi(threads_count, 1) - 1;
+  for (int i = 0; i < threads_count; i++) {
+    threads[i] = ecs_os_thread_new(copy_accessors_main, model);
+  }
+#endif
+  copy_accessors_main(model);
+  for (int i = 0; i < threads_count; i++) {
+    ecs_os_thread_join(threads[i]);
+  }
+
+  for (int i = 0; i < model->sparse_count; i++) {
+    const gli_accessor_t* accessor = model->sparse + i;
+    const size_t size = type_infos[accessor->type].size;
+    for (size_t j = 0; j < accessor->sparse_count; j++) {
+      uint32_t index = 0;
+      memcpy(&index, accessor->sparse_indices + j * accessor->sparse_index_size, accessor->sparse_index_size);
+      if (index < accessor->count) {
+        memcpy(model->sparse_destinations[i] + index * size, accessor->sparse_values + j * size, size);
+      }
+    }
+  }
+}
+
+// Splits a transform without shear into the components that the renderer composes back.
+static void decompose_transform(const vkm_mat4* transform, Position3D* position, Rotation3D* rotation, Scale3D* scale) {
+  vkm_vec3 axes[3];
+  for (int i = 0; i < 3; i++) {
+    axes[i] = (vkm_vec3){ { transform->columns[i].x, transform->columns[i].y, transform->columns[i].z } };
+    scale->raw[i] = vkm_magnitude(&axes[i]);
+  }
+  *position = (Position3D){ { transform->m30, transform->m31, transform->m32 } };
+
+  vkm_vec3 cross;
+  vkm_cross(&axes[0], &axes[1], &cross);
+  if (vkm_dot(&cross, &axes[2]) < 0.0f) {
+    scale->x = -scale->x;
+  }
+  if (scale->x == 0.0f || scale->y == 0.0f || scale->z == 0.0f) {
+    *rotation = CVKM_QUAT_IDENTITY;
+    return;
+  }
+
+  // The rotation matrix, by rows.
+  float r[3][3];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      r[j][i] = axes[i].raw[j] / scale->raw[i];
+    }
+  }
+  // Starting from the biggest component, for precision.
+  const float trace = r[0][0] + r[1][1] + r[2][2];
+  if (trace > 0.0f) {
+    const float s = 0.5f / sqrtf(trace + 1.0f);
+    rotation->x = (r[2][1] - r[1][2]) * s;
+    rotation->y = (r[0][2] - r[2][0]) * s;
+    rotation->z = (r[1][0] - r[0][1]) * s;
+    rotation->w = 0.25f / s;
+  } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+    const float s = 2.0f * sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]);
+    rotation->x = 0.25f * s;
+    rotation->y = (r[0][1] + r[1][0]) / s;
+    rotation->z = (r[0][2] + r[2][0]) / s;
+    rotation->w = (r[2][1] - r[1][2]) / s;
+  } else if (r[1][1] > r[2][2]) {
+    const float s = 2.0f * sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]);
+    rotation->x = (r[0][1] + r[1][0]) / s;
+    rotation->y = 0.25f * s;
+    rotation->z = (r[1][2] + r[2][1]) / s;
+    rotation->w = (r[0][2] - r[2][0]) / s;
+  } else {
+    const float s = 2.0f * sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]);
+    rotation->x = (r[0][2] + r[2][0]) / s;
+    rotation->y = (r[1][2] + r[2][1]) / s;
+    rotation->z = 0.25f * s;
+    rotation->w = (r[1][0] - r[0][1]) / s;
+  }
+}
+
+// The transform of a node relative to its parent.
+static void read_node_transform(const char* json, const gli_json_token_t* tokens, const int node, vkm_mat4* transform) {
+  const int matrix = json_member(json, tokens, node, "matrix");
+  if (matrix >= 0) {
+    *transform = CVKM_MAT4_IDENTITY;
+    json_floats(json, tokens, matrix, transform->raw, 16);
+    return;
+  }
+
+  Position3D translation = { { 0.0f, 0.0f, 0.0f } };
+  Rotation3D rotation = CVKM_QUAT_IDENTITY;
+  Scale3D scale = { { 1.0f, 1.0f, 1.0f } };
+  json_floats(json, tokens, json_member(json, tokens, node, "translation"), translation.raw, 3);
+  json_floats(json, tokens, json_member(json, tokens, node, "rotation"), rotation.raw, 4);
+  json_floats(json, tokens, json_member(json, tokens, node, "scale"), scale.raw, 3);
+  vkm_quat_to_mat4(&rotation, transform);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      transform->columns[i].raw[j] *= scale.raw[i];
+    }
+  }
+  transform->columns[3] = (vkm_vec4){ { translation.x, translation.y, translation.z, 1.0f } };
+}
+
+// A node waiting for its entity.
+typedef struct gli_pending_node_t {
+  int64_t node;
+  ecs_entity_t parent;
+  vkm_mat4 parent_transform;
+} gli_pending_node_t;
+
+// Makes the entities of the nodes of the scene, or of every node without a parent when there are no scenes.
+static void spawn_model_nodes(
+  ecs_world_t* world,
+  const ecs_entity_t entity,
+  const ModelFile* file,
+  const gli_model_t* model,
+  const ecs_entity_t* primitive_entities,
+  const int* first_primitives,
+  const int meshes_count
+) {
+  const char* json = model->json;
+  const gli_json_token_t* tokens = model->tokens;
+  int nodes_count, roots_count;
+  int* nodes = json_elements(tokens, json_member(json, tokens, 0, "nodes"), &nodes_count);
+  int scenes_count;
+  int* scenes = json_elements(tokens, json_member(json, tokens, 0, "scenes"), &scenes_count);
+  const int64_t scene = json_integer(json, tokens, json_member(json, tokens, 0, "scene"), 0);
+  int* roots = json_elements(
+    tokens,
+    scene >= 0 && scene < scenes_count ? json_member(json, tokens, scenes[scene], "nodes") : -1,
+    &roots_count
+  );
+  free(scenes);
+
+  // Also guards against cycles and shared children, which glTF doesn't allow.
+  bool* spawned = calloc(nodes_count, sizeof(bool));
+  const int pending_capacity = nodes_count + roots_count;
+  gli_pending_node_t* pending = malloc(pending_capacity * sizeof(gli_pending_node_t));
+  int pending_count = 0;
+  if (roots) {
+    for (int i = roots_count - 1; i >= 0; i--) {
+      const int64_t root = json_integer(json, tokens, roots[i], -1);
+      pending[pending_count++] = (gli_pending_node_t){ root, entity, CVKM_MAT4_IDENTITY };
+    }
+  } else {
+    for (int i = 0; i < nodes_count; i++) {
+      int children_count;
+      int* children = json_elements(tokens, json_member(json, tokens, nodes[i], "children"), &children_count);
+      for (int j = 0; j < children_count; j++) {
+        const int64_t child = json_integer(json, tokens, children[j], -1);
+        if (child >= 0 && child < nodes_count) {
+          spawned[child] = true;
+        }
+      }
+      free(children);
+    }
+    for (int i = nodes_count - 1; i >= 0; i--) {
+      if (!spawned[i]) {
+        pending[pending_count++] = (gli_pending_node_t){ i, entity, CVKM_MAT4_IDENTITY };
+      }
+    }
+    memset(spawned, 0, nodes_count * sizeof(bool));
+  }
+
+  while (pending_count > 0) {
+    const gli_pending_node_t current = pending[--pending_count];
+    if (current.node < 0 || current.node >= nodes_count || spawned[current.node]) {
+      continue;
+    }
+    spawned[current.node] = true;
+    const int node = nodes[current.node];
+
+    vkm_mat4 local_transform, transform;
+    read_node_transform(json, tokens, node, &local_transform);
+    vkm_mat4_mul(&current.parent_transform, &local_transform, &transform);
+    Position3D position;
+    Rotation3D rotation;
+    Scale3D scale;
+    decompose_transform(&transform, &position, &rotation, &scale);
+
+    const ecs_entity_t node_entity = ecs_new_w_pair(world, EcsChildOf, current.parent);
+    ecs_set_ptr(world, node_entity, Position3D, &position);
+    ecs_set_ptr(world, node_entity, Rotation3D, &rotation);
+    ecs_set_ptr(world, node_entity, Scale3D, &scale);
+
+    const int64_t mesh = json_integer(json, tokens, json_member(json, tokens, node, "mesh"), -1);
+    if (mesh >= 0 && mesh < meshes_count) {
+      for (int j = first_primitives[mesh]; j < first_primitives[mesh + 1]; j++) {
+        ecs_add_pair(world, node_entity, ecs_id(Uses), primitive_entities[j]);
+      }
+      if (file->program) {
+        ecs_add_pair(world, node_entity, ecs_id(Uses), file->program);
+      }
+    }
+
+    int children_count;
+    int* children = json_elements(tokens, json_member(json, tokens, node, "children"), &children_count);
+    for (int j = children_count - 1; j >= 0; j--) {
+      const int64_t child = json_integer(json, tokens, children[j], -1);
+      if (child >= 0 && child < nodes_count && !spawned[child] && pending_count < pending_capacity) {
+        pending[pending_count++] = (gli_pending_node_t){ child, node_entity, transform };
+      }
+    }
+    free(children);
+  }
+
+  free(pending);
+  free(spawned);
+  free(roots);
+  free(nodes);
+}
+
+// The vertex attributes that we load, in the order that they take in MeshData.
+static const char* model_attributes[] = { "POSITION", "NORMAL", "TEXCOORD_0", "TEXCOORD_1", "TANGENT", "COLOR_0" };
+
+// Makes the MeshData of a primitive release the file of the model, once something is borrowed from it.
+static void borrow_model_mapping(const gli_model_t* model, MeshData* mesh_data) {
+  if (!mesh_data->release) {
+    mesh_data->release = release_model_mapping;
+    mesh_data->release_context = model->mapping;
+    ecs_os_ainc(&model->mapping->references);
+  }
+}
+
+// Fills the MeshData of a primitive and queues the copies of its accessors.
+static bool read_model_primitive(gli_model_t* model, const int primitive, MeshData* mesh_data) {
+  const char* json = model->json;
+  const gli_json_token_t* tokens = model->tokens;
+  const int attributes = json_member(json, tokens, primitive, "attributes");
+  gli_accessor_t accessors[GLI_COUNTOF(model_attributes)];
+  int attributes_count = 0;
+  size_t size = 0;
+  for (unsigned i = 0; i < GLI_COUNTOF(model_attributes); i++) {
+    const int attribute = json_member(json, tokens, attributes, model_attributes[i]);
+    if (attribute < 0) {
+      continue;
+    }
+
+    gli_accessor_t* accessor = accessors + attributes_count;
+    if (
+      !read_accessor(model, json_integer(json, tokens, attribute, -1), accessor)
+      || (attributes_count > 0 && accessor->count != accessors[0].count)
+      || size + accessor->count * type_infos[accessor->type].size > INT_MAX
+    ) {
+      return false;
+    }
+    mesh_data->vertex_attributes[attributes_count].type = (int8_t)accessor->type;
+    mesh_data->vertex_attributes[attributes_count].normalize = accessor->normalized;
+    size += accessor->count * type_infos[accessor->type].size;
+    attributes_count++;
+  }
+
+  const int64_t mode = json_integer(json, tokens, json_member(json, tokens, primitive, "mode"), GL_TRIANGLES);
+  if (!attributes_count || mode < GL_POINTS || mode > GL_TRIANGLE_FAN) {
+    return false;
+  }
+  // The modes of glTF are those of OpenGL.
+  mesh_data->primitive = (gli_primitive_t)(mode + 1);
+  mesh_data->vertices_count = (int)accessors[0].count;
+  // The attributes are borrowed from the file if they already follow each other there, tightly packed.
+  bool borrowed = accessors[0].data && (uintptr_t)accessors[0].data % sizeof(float) == 0;
+  for (int i = 0, offset = 0; borrowed && i < attributes_count; i++) {
+    const size_t element_size = type_infos[accessors[i].type].size;
+    borrowed = accessors[i].data == accessors[0].data + offset
+      && accessors[i].stride == element_size
+      && !accessors[i].sparse_count;
+    offset += (int)(accessors[i].count * element_size);
+  }
+  if (borrowed) {
+    mesh_data->data = accessors[0].data;
+    borrow_model_mapping(model, mesh_data);
+  } else {
+    uint8_t* copied_data = malloc(size);
+    mesh_data->data = copied_data;
+    if (!copied_data) {
+      return false;
+    }
+    for (int i = 0, offset = 0; i < attributes_count; i++) {
+      copy_accessor_later(model, accessors + i, copied_data + offset, false);
+      offset += (int)accessors[i].count * type_infos[accessors[i].type].size;
+    }
+  }
+
+  const int indices = json_member(json, tokens, primitive, "indices");
+  if (indices >= 0) {
+    gli_accessor_t accessor;
+    if (
+      !read_accessor(model, json_integer(json, tokens, indices, -1), &accessor)
+      || (accessor.type != GLI_UBYTE && accessor.type != GLI_USHORT && accessor.type != GLI_UINT)
+      || accessor.sparse_count
+      || accessor.count > INT_MAX / sizeof(unsigned)
+    ) {
+      return false;
+    }
+    mesh_data->indices_count = (int)accessor.count;
+    if (
+      accessor.type == GLI_UINT
+      && accessor.data
+      && accessor.stride == sizeof(unsigned)
+      && (uintptr_t)accessor.data % sizeof(unsigned) == 0
+    ) {
+      mesh_data->indices = (const unsigned*)accessor.data;
+      borrow_model_mapping(model, mesh_data);
+    } else {
+      unsigned* copied_indices = malloc(accessor.count * sizeof(unsigned));
+      mesh_data->indices = copied_indices;
+      if (!copied_indices) {
+        return false;
+      }
+      copy_accessor_later(model, &accessor, (uint8_t*)copied_indices, true);
+    }
+  }
+
+  return true;
+}
+
+static void load_model_file(ecs_world_t* world, const ecs_entity_t entity, const ModelFile* file) {
+  const char* path = file->path ? file->path : "";
+  gli_model_mapping_t* mapping = malloc(sizeof(gli_model_mapping_t));
+  if (!map_file(path, &mapping->file)) {
+    fprintf(stderr, "Cannot open %s.\n", path);
+    free(mapping);
+    return;
+  }
+  mapping->references = 1;
+
+  gli_model_t model = { .mapping = mapping, .path = path };
+  gli_json_token_t* tokens = NULL;
+  int* meshes = NULL, *first_primitives = NULL;
+  int meshes_count = 0, primitives_count = 0;
+  MeshData* primitives = NULL;
+
+  const uint8_t* data = mapping->file.data;
+  const size_t size = mapping->file.size;
+  if (
+    size < 20
+    || read_u32(data) != GLI_GLB_MAGIC
+    || read_u32(data + 4) != 2
+    || read_u32(data + 16) != GLI_GLB_JSON
+  ) {
+    fprintf(stderr, "%s isn't a GLB file of glTF 2.0.\n", path);
+    goto done;
+  }
+  const size_t json_size = read_u32(data + 12);
+  if (json_size > size - 20 || json_size > INT_MAX) {
+    fprintf(stderr, "%s is truncated.\n", path);
+    goto done;
+  }
+  const size_t bin_offset = 20 + json_size;
+  if (bin_offset + 8 <= size && read_u32(data + bin_offset + 4) == GLI_GLB_BIN) {
+    model.bin = data + bin_offset + 8;
+    model.bin_size = read_u32(data + bin_offset);
+    if (model.bin_size > size - bin_offset - 8) {
+      fprintf(stderr, "%s is truncated.\n", path);
+      goto done;
+    }
+  }
+
+  int tokens_count;
+  model.json = (const char*)data + 20;
+  model.tokens = tokens = parse_json(model.json, (int)json_size, &tokens_count);
+  if (!tokens || tokens[0].type != GLI_JSON_OBJECT) {
+    fprintf(stderr, "%s has invalid JSON.\n", path);
+    goto done;
+  }
+  const char* json = model.json;
+
+  int required_count;
+  int* required = json_elements(tokens, json_member(json, tokens, 0, "extensionsRequired"), &required_count);
+  free(required);
+  if (required_count > 0) {
+    fprintf(stderr, "%s requires extensions, which aren't supported.\n", path);
+    goto done;
+  }
+  int buffers_count;
+  int* buffers = json_elements(tokens, json_member(json, tokens, 0, "buffers"), &buffers_count);
+  const bool external_buffers = buffers_count > 1
+    || (buffers_count == 1 && json_member(json, tokens, buffers[0], "uri") >= 0);
+  free(buffers);
+  if (external_buffers) {
+    fprintf(stderr, "%s has buffers outside of it, which aren't supported.\n", path);
+    goto done;
+  }
+
+  model.accessors = json_elements(tokens, json_member(json, tokens, 0, "accessors"), &model.accessors_count);
+  model.views = json_elements(tokens, json_member(json, tokens, 0, "bufferViews"), &model.views_count);
+  meshes = json_elements(tokens, json_member(json, tokens, 0, "meshes"), &meshes_count);
+  first_primitives = malloc((meshes_count + 1) * sizeof(int));
+  for (int i = 0; i < meshes_count; i++) {
+    const int mesh_primitives = json_member(json, tokens, meshes[i], "primitives");
+    first_primitives[i] = primitives_count;
+    primitives_count += mesh_primitives >= 0 && tokens[mesh_primitives].type == GLI_JSON_ARRAY
+      ? tokens[mesh_primitives].children
+      : 0;
+  }
+  first_primitives[meshes_count] = primitives_count;
+
+  primitives = calloc(primitives_count, sizeof(MeshData));
+  for (int i = 0; i < meshes_count; i++) {
+    int mesh_primitives_count;
+    int* mesh_primitives = json_elements(
+      tokens,
+      json_member(json, tokens, meshes[i], "primitives"),
+      &mesh_primitives_count
+    );
+    for (int j = 0; j < mesh_primitives_count; j++) {
+      if (!read_model_primitive(&model, mesh_primitives[j], primitives + first_primitives[i] + j)) {
+        fprintf(stderr, "%s has a mesh primitive that can't be loaded.\n", path);
+        free(mesh_primitives);
+        goto done;
+      }
+    }
+    free(mesh_primitives);
+  }
+
+  copy_accessors(&model);
+
+  // Out of range indices would make the CPU read out of bounds, for occluders and simplification.
+  for (int i = 0; i < primitives_count; i++) {
+    unsigned max_index = 0;
+    for (int j = 0; j < primitives[i].indices_count; j++) {
+      max_index = vkm_maxui(max_index, primitives[i].indices[j]);
+    }
+    if (primitives[i].indices_count && max_index >= (unsigned)primitives[i].vertices_count) {
+      fprintf(stderr, "%s has indices out of range.\n", path);
+      goto done;
+    }
+  }
+
+  ecs_entity_t* primitive_entities = malloc(primitives_count * sizeof(ecs_entity_t));
+  for (int i = 0; i < primitives_count; i++) {
+    primitive_entities[i] = ecs_new_w_pair(world, EcsChildOf, entity);
+    // Handing over the buffers, no copies.
+    *ecs_ensure(world, primitive_entities[i], MeshData) = primitives[i];
+    primitives[i] = (MeshData){ 0 };
+    ecs_modified(world, primitive_entities[i], MeshData);
+  }
+  spawn_model_nodes(world, entity, file, &model, primitive_entities, first_primitives, meshes_count);
+  free(primitive_entities);
+
+done:
+  for (int i = 0; i < primitives_count; i++) {
+    release_mesh_data(primitives + i);
+  }
+  free(primitives);
+  free(first_primitives);
+  free(meshes);
+  free(model.copies);
+  free(model.sparse);
+  free(model.sparse_destinations);
+  free(model.accessors);
+  free(model.views);
+  free(tokens);
+  release_model_mapping(NULL, NULL, mapping);
+}
+
+static void LoadModelFiles(ecs_iter_t* it) {
+  const ModelFile* files = ecs_field(it, ModelFile, 0);
+
+  for (int i = 0; i < it->count; i++) {
+    load_model_file(it->world, it->entities[i], files + i);
+    ecs_remove(it->world, it->entities[i], ModelFile);
+  }
+}
+#pragma endregion
+
+#pragma region Mesh files
+static_assert(sizeof(gli_mesh_file_header_t) == 216, "Mesh files would change!");
+
+// The vertices and the indices start at multiples of this.
+#define GLI_MESH_FILE_ALIGNMENT 16
+
+static size_t align_mesh_file_offset(const size_t offset) {
+  return (offset + GLI_MESH_FILE_ALIGNMENT - 1) / GLI_MESH_FILE_ALIGNMENT * GLI_MESH_FILE_ALIGNMENT;
+}
+
+static bool write_mesh_file_padding(FILE* file, const size_t offset) {
+  static const uint8_t zeros[GLI_MESH_FILE_ALIGNMENT] = { 0 };
+  const size_t padding = align_mesh_file_offset(offset) - offset;
+  return fwrite(zeros, 1, padding, file) == padding;
+}
+
+bool gli_cook_mesh(const MeshData* mesh_data, const char* path) {
+  Mesh mesh = { .vertices_count = mesh_data->vertices_count, .primitive = mesh_data->primitive };
+  if (mesh_data->data) {
+    measure_mesh_bounds(mesh_data, &mesh);
+  }
+  const unsigned* indices = mesh_data->indices;
+  int indices_count = mesh_data->indices_count;
+  unsigned* lod_chain = NULL;
+  if (
+    indices
+    && mesh_data->lods_count > 0
+    && mesh_data->vertex_attributes[0].type == GLI_VEC3
+    && mesh_data->primitive == GLI_TRIANGLES
+  ) {
+    indices = lod_chain = build_lod_chain(mesh_data, &mesh, &indices_count);
+  }
+
+  gli_mesh_file_header_t header = {
+    .magic = GLI_MESH_FILE_MAGIC,
+    .version = GLI_MESH_FILE_VERSION,
+    .primitive = mesh_data->primitive,
+    .vertices_count = (uint32_t)mesh_data->vertices_count,
+    .indices_count = indices ? (uint32_t)indices_count : 0,
+    .index_size = !indices ? 0 : mesh_data->vertices_count <= UINT16_MAX + 1 ? sizeof(uint16_t) : sizeof(unsigned),
+    .bounds_min = mesh.bounds_min,
+    .bounds_max = mesh.bounds_max,
+    .lods_count = (uint32_t)mesh.lods_count,
+    .vertices_offset = align_mesh_file_offset(sizeof(gli_mesh_file_header_t)),
+  };
+  memcpy(header.vertex_attributes, mesh_data->vertex_attributes, sizeof(header.vertex_attributes));
+  memcpy(header.lods, mesh.lods, sizeof(header.lods));
+  header.vertices_size = mesh_data->data ? vertices_size(mesh_data->vertex_attributes, mesh_data->vertices_count) : 0;
+  header.indices_offset = align_mesh_file_offset(header.vertices_offset + header.vertices_size);
+  header.indices_size = (uint64_t)header.indices_count * header.index_size;
+
+  FILE* file = fopen(path, "wb");
+  bool written = file
+    && fwrite(&header, sizeof(header), 1, file) == 1
+    && write_mesh_file_padding(file, sizeof(header))
+    && fwrite(mesh_data->data, 1, header.vertices_size, file) == header.vertices_size
+    && write_mesh_file_padding(file, header.vertices_offset + header.vertices_size);
+  if (written && header.index_size == sizeof(uint16_t)) {
+    uint16_t narrowed[1024];
+    for (int i = 0; written && i < indices_count; i += GLI_COUNTOF(narrowed)) {
+      const int count = vkm_mini(indices_count - i, GLI_COUNTOF(narrowed));
+      for (int j = 0; j < count; j++) {
+        narrowed[j] = (uint16_t)indices[i + j];
+      }
+      written = fwrite(narrowed, sizeof(uint16_t), count, file) == (size_t)count;
+    }
+  } else if (written) {
+    written = fwrite(indices, 1, header.indices_size, file) == header.indices_size;
+  }
+  if (file) {
+    written = fclose(file) == 0 && written;
+  }
+  if (!written) {
+    fprintf(stderr, "Cannot write %s.\n", path);
+  }
+
+  free(lod_chain);
+  return written;
+}
+
+static bool read_mesh_file(const char* path, const gli_mapped_file_t* file, gli_mesh_file_header_t* header) {
+  if (file->size < sizeof(*header)) {
+    fprintf(stderr, "%s isn't a mesh file.\n", path);
+    return false;
+  }
+  memcpy(header, file->data, sizeof(*header));
+  if (header->magic != GLI_MESH_FILE_MAGIC) {
+    fprintf(stderr, "%s isn't a mesh file.\n", path);
+    return false;
+  }
+  if (header->version != GLI_MESH_FILE_VERSION) {
+    fprintf(stderr, "%s was cooked for another version of GLitch.\n", path);
+    return false;
+  }
+
+  bool valid = header->primitive >= GLI_POINTS
+    && header->primitive <= GLI_TRIANGLE_FAN
+    && header->vertices_count <= INT_MAX
+    && header->indices_count <= INT_MAX
+    && (header->index_size == 0 || header->index_size == sizeof(uint16_t) || header->index_size == sizeof(unsigned))
+    && (header->index_size || !header->indices_count)
+    && header->indices_size == (uint64_t)header->indices_count * header->index_size
+    && header->vertices_offset <= file->size
+    && header->vertices_size <= file->size - header->vertices_offset
+    && header->indices_offset <= file->size
+    && header->indices_size <= file->size - header->indices_offset
+    && header->lods_count <= GLI_MAX_LODS;
+  for (int i = 0; valid && i < GLI_MAX_ATTRIBUTES && header->vertex_attributes[i].type; i++) {
+    valid = header->vertex_attributes[i].type > 0 && header->vertex_attributes[i].type < GLI_MAT4;
+  }
+  valid = valid && (
+    header->vertices_size == 0
+    || header->vertices_size == vertices_size(header->vertex_attributes, header->vertices_count)
+  );
+  for (uint32_t i = 0; valid && i < header->lods_count; i++) {
+    valid = header->lods[i].first_index >= 0
+      && header->lods[i].indices_count >= 0
+      && (uint32_t)header->lods[i].first_index + (uint32_t)header->lods[i].indices_count <= header->indices_count;
+  }
+  if (!valid) {
+    fprintf(stderr, "%s is corrupt.\n", path);
+  }
+  return valid;
+}
+
+static void LoadMeshFiles(ecs_iter_t* it) {
+  const MeshFile* files = ecs_field(it, MeshFile, 0);
+  acquire_context();
+
+  for (int i = 0; i < it->count; i++) {
+    const ecs_entity_t entity = it->entities[i];
+    const char* path = files[i].path ? files[i].path : "";
+    gli_mapped_file_t file;
+    gli_mesh_file_header_t header;
+    if (!map_file(path, &file)) {
+      fprintf(stderr, "Cannot open %s.\n", path);
+    } else {
+      if (read_mesh_file(path, &file, &header)) {
+        Mesh* mesh = ecs_ensure(it->world, entity, Mesh);
+        mesh->primitive = header.primitive;
+        mesh->vertices_count = (int)header.vertices_count;
+        // The full mesh, like MakeMeshes leaves it, the rest of the indices being its levels of detail.
+        mesh->indices_count = header.lods_count ? header.lods[0].indices_count : (int)header.indices_count;
+        mesh->bounds_min = header.bounds_min;
+        mesh->bounds_max = header.bounds_max;
+        memcpy(mesh->lods, header.lods, sizeof(mesh->lods));
+        mesh->lods_count = (int)header.lods_count;
+
+        if (header.vertices_size) {
+          upload_mesh_vertices(
+            mesh,
+            header.vertex_attributes,
+            file.data + header.vertices_offset,
+            mesh->vertices_count,
+            GL_STATIC_DRAW
+          );
+          if (header.index_size) {
+            const GLenum type = header.index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            const void* indices = file.data + header.indices_offset;
+            upload_mesh_indices(mesh, indices, type, (int)header.indices_count, GL_STATIC_DRAW);
+          }
+
+          if (
+            header.vertex_attributes[0].type == GLI_VEC3
+            && mesh->primitive == GLI_TRIANGLES
+            && ecs_has(it->world, entity, Occluder)
+          ) {
+            set_occluder_geometry(
+              it->world,
+              entity,
+              (const vkm_vec3*)(file.data + header.vertices_offset),
+              mesh->vertices_count,
+              header.index_size ? file.data + header.indices_offset : NULL,
+              (int)header.index_size,
+              mesh->indices_count
+            );
+          }
+        } else {
+          mesh->vertex_array = attributeless_vertex_array;
+        }
+        ecs_modified(it->world, entity, Mesh);
+      }
+      unmap_file(&file);
+    }
+
+    ecs_remove(it->world, entity, MeshFile);
+    redraw_requested = true;
+  }
+}
+#pragma endregion
+
+// Reads the active uniforms and attributes of a linked program, and matches the uniforms with components to fill the
+// description of the query that finds the entities rendered with it.
+static void reflect_program(
+  ecs_world_t* world,
+  const ecs_entity_t entity,
+  ShaderProgram* shader_program,
+  ecs_query_desc_t* query_description
+) {
+  GLint max_length;
+  glGetProgramiv(shader_program->program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+  char* name_buffer = malloc(max_length);
+
+  glGetProgramiv(shader_program->program, GL_ACTIVE_UNIFORMS, &shader_program->uniforms_count);
+  shader_program->uniforms = malloc(shader_program->uniforms_count * sizeof(gli_shader_input_data));
+  int skipped = 0;
+  for (int j = 0; j < shader_program->uniforms_count; j++) {
+    gli_shader_input_data* uniform = shader_program->uniforms + j - skipped;
+
+    GLint size;
+    glGetActiveUniform(shader_program->program, j, max_length, NULL, &size, &uniform->type, name_buffer);
+
+    // Pretend built-in uniforms don't exist here.
+    for (unsigned k = 0; k < GLI_COUNTOF(built_in_names); k++) {
+      if (strcmp(name_buffer, built_in_names[k]) == 0) {
+        skipped++;
+        goto next;
+      }
+    }
+
+    // Samplers read the atlas that Render binds, not a component.
+    if (uniform->type == GL_SAMPLER_2D_ARRAY) {
+      skipped++;
+      goto next;
+    }
+
+    uniform->name = strdup(name_buffer);
+    uniform->location = glGetUniformLocation(shader_program->program, name_buffer);
+  next:;
+  }
+
+  shader_program->uniforms_count -= skipped;
+  assert(shader_program->uniforms_count >= 0);
+  if (shader_program->uniforms_count > GLI_MAX_UNIFORMS) {
+    // Trim the excess uniforms in case there are too many of them.
+    shader_program->uniforms_count = GLI_MAX_UNIFORMS;
+  }
+
+  // Compact memory.
+  if (shader_program->uniforms_count > 0) {
+    shader_program->uniforms = realloc(
+      shader_program->uniforms,
+      shader_program->uniforms_count * sizeof(gli_shader_input_data)
+    );
+  } else {
+    free(shader_program->uniforms);
+    shader_program->uniforms = NULL;
+  }
+
+  free(name_buffer);
+
+  glGetProgramiv(shader_program->program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+  name_buffer = malloc(max_length);
+
+  glGetProgramiv(shader_program->program, GL_ACTIVE_ATTRIBUTES, &shader_program->attributes_count);
+  shader_program->attributes = malloc(shader_program->attributes_count * sizeof(gli_shader_input_data));
+  for (int j = 0; j < shader_program->attributes_count; j++) {
+    GLint size;
+    glGetActiveAttrib(
+      shader_program->program,
+      j,
+      max_length,
+      NULL,
+      &size,
+      &shader_program->attributes[j].type,
+      name_buffer
+    );
+    shader_program->attributes[j].name = strdup(name_buffer);
+    shader_program->attributes[j].location = glGetAttribLocation(shader_program->program, name_buffer);
+  }
+
+  free(name_buffer);
+
+  // Build the query to find all entities that provide the necessary uniforms.
+
+  // If you change the terms here, remember to update the static variable called "reserved_terms"!!
+  *query_description = (ecs_query_desc_t){
+    .terms = {
+      {
+        .id = ecs_id(Position2D),
+        .inout = EcsIn,
+        .oper = EcsOr,
+      },
+      {
+        .id = ecs_id(Position3D),
+        .inout = EcsIn,
+      },
+      {
+        .id = ecs_id(Rotation2D),
+        .inout = EcsIn,
+        .oper = EcsOptional,
+      },
+      {
+        .id = ecs_id(Rotation3D),
+        .inout = EcsIn,
+        .oper = EcsOptional,
+      },
+      {
+        .id = ecs_id(Scale2D),
+        .inout = EcsIn,
+        .oper = EcsOptional,
+      },
+      {
+        .id = ecs_id(Scale3D),
+        .inout = EcsIn,
+        .oper = EcsOptional,
+      },
+      {
+        .first.id = ecs_id(Uses),
+        .second.id = entity,
+        .inout = EcsInOutNone,
+      },
+      {
+        .first.id = ecs_id(Uses),
+        .second.name = "$mesh",
+        .inout = EcsInOutNone,
+      },
+      {
+        .id = ecs_id(Mesh),
+        .src.name = "$mesh",
+        .inout = EcsIn,
+      },
+    },
+    .cache_kind = EcsQueryCacheAuto,
+  };
+
+  bool provided_by_entities[GLI_MAX_UNIFORMS];
+  for (int j = 0, count = shader_program->uniforms_count, skipped_uniforms = 0; j < count; j++) {
+    const gli_shader_input_data* uniform = shader_program->uniforms + j - skipped_uniforms;
+    uint8_t* ecs_uniform_type = shader_program->ecs_uniform_types + j - skipped_uniforms;
+
+    const bool provided_by_entity = strncmp("entity", uniform->name, 6) == 0;
+    provided_by_entities[j - skipped_uniforms] = provided_by_entity;
+    const char* component_name = uniform->name + (provided_by_entity ? 6 : 0);
+
+    const ecs_entity_t component = ecs_lookup_symbol(world, component_name, false, false);
+    if (!component) {
+      fprintf(stderr, "Component %s not found.\n", component_name);
+      goto invalid_component;
+    }
+
+    bool type_matches = false;
+    const EcsPrimitive* primitive = ecs_get(world, component, EcsPrimitive);
+    if (primitive) {
+      switch (uniform->type) {
+        case GL_FLOAT:
+          type_matches = primitive->kind == EcsF32;
+          *ecs_uniform_type = GLI_FLOAT;
+          break;
+        case GL_INT:
+          type_matches = primitive->kind == EcsI32;
+          *ecs_uniform_type = GLI_INT;
+          break;
+        case GL_UNSIGNED_INT:
+          type_matches = primitive->kind == EcsU32;
+          *ecs_uniform_type = GLI_UINT;
+          break;
+        default:
+          break;
+      }
+    }
+
+    if (!type_matches) {
+      switch (uniform->type) {
+        case GL_FLOAT_VEC2:
+          type_matches = ecs_has_pair(world, component, EcsIsA, ecs_id(vkm_vec2));
+          *ecs_uniform_type = GLI_VEC2;
+          break;
+        case GL_FLOAT_VEC3:
+          type_matches = ecs_has_pair(world, component, EcsIsA, ecs_id(vkm_vec3));
+          *ecs_uniform_type = GLI_VEC3;
+          break;
+        case GL_FLOAT_VEC4:
+          type_matches = ecs_has_pair(world, component, EcsIsA, ecs_id(vkm_vec4));
+          *ecs_uniform_type = GLI_VEC4;
+          break;
+        case GL_INT_VEC2:
+          type_matches = ecs_has_pair(world, component, EcsIsA, ecs_id(vkm_ivec2));
+          *ecs_uniform_type = GLI_IVEC2;
+          break;
+        case GL_INT_VEC3:
+          type_matches = ecs_has_pair(world, component, EcsIsA, ecs_id(vkm_ivec3));
+          *ecs_uniform_type = GLI_IVEC3;
+          break;
+        case GL_INT_VEC4:
+          type_matches = ecs_has_pair(world, component, EcsIsA, ecs_id(vkm_ivec4));
+          *ecs_uniform_type = GLI_IVEC4;
+          break;
+        case GL_UNSIGNED_INT_VEC2:
+          type_matches = ecs_has_pair(world, component, EcsIsA, ecs_id(vkm_uvec2));
+          *ecs_uniform_type = GLI_UVEC2;
+          break;
+        case GL_UNSIGNED_INT_VEC3:
+          type_matches = ecs_has_pair(world, component, EcsIsA, ecs_id(vkm_uvec3));
+          *ecs_uniform_type = GLI_UVEC3;
+          break;
+        case GL_UNSIGNED_INT_VEC4:
+          type_matches = ecs_has_pair(world, component, EcsIsA, ecs_id(vkm_uvec4));
+          *ecs_uniform_type = GLI_UVEC4;
+          break;
+        case GL_FLOAT_MAT4:
+          type_matches = ecs_has_pair(world, component, EcsIsA, ecs_id(vkm_mat4));
+          *ecs_uniform_type = GLI_MAT4;
+          break;
+        default:
+          break;
+      }
+    }
+
+    if (!type_matches) {
+      char buffer[22];
+      const char* name = ecs_get_name(world, component);
+      if (!name) {
+        name = ecs_get_symbol(world, component);
+      }
+      if (!name) {
+        sprintf(buffer, "#%llu", (unsigned long long)component);
+      }
+      printf(
+        "The type of the component %s doesn't match the type the shader requires (0x%x).\n",
+        name ? name : buffer,
+        uniform->type
+      );
+      goto invalid_component;
+    }
+
+    assert(j + GLI_RESERVED_TERMS - skipped_uniforms < FLECS_TERM_COUNT_MAX);
+    query_description->terms[j + GLI_RESERVED_TERMS - skipped_uniforms] = (ecs_term_t){
+      .id = component,
+      .src.id = provided_by_entity ? 0 : entity,
+      .inout = EcsIn,
+    };
+
+    continue;
+
+  invalid_component:
+    // Delete the uniform registry.
+    shader_program->uniforms_count--;
+    assert(shader_program->uniforms_count >= 0);
+
+    if (shader_program->uniforms_count > 0) {
+      free(shader_program->uniforms[j - skipped_uniforms].name);
+      memmove(
+        shader_program->uniforms + j - skipped_uniforms,
+        shader_program->uniforms + j - skipped_uniforms + 1,
+        (shader_program->uniforms_count - j + skipped_uniforms) * sizeof(gli_shader_input_data)
+      );
+      shader_program->uniforms = realloc(
+        shader_program->uniforms,
+        shader_program->uniforms_count * sizeof(gli_shader_input_data)
+      );
+    } else {
+      free(shader_program->uniforms);
+      shader_program->uniforms = NULL;
+    }
+
+    skipped_uniforms++;
+  }
+
+  // The uniforms of each entity go first, so that they are contiguous for Render, then those of the program.
+  shader_program->entity_uploads_count = shader_program->entity_values_size = shader_program->uniform_values_size = 0;
+  for (int pass = 0, k = 0; pass < 2; pass++) {
+    for (int j = 0; j < shader_program->uniforms_count; j++) {
+      if (provided_by_entities[j] != (pass == 0)) {
+        continue;
+      }
+
+      const gli_data_type_t type = shader_program->ecs_uniform_types[j];
+      shader_program->uploads[k] = (gli_uniform_upload_t){
+        .upload = uniform_uploads[type],
+        .location = shader_program->uniforms[j].location,
+        .size = type_infos[type].size,
+      };
+      shader_program->upload_uniforms[k++] = (uint8_t)j;
+      shader_program->uniform_values_size += type_infos[type].size;
+    }
+
+    if (pass == 0) {
+      shader_program->entity_uploads_count = k;
+      shader_program->entity_values_size = shader_program->uniform_values_size;
+    }
+  }
+
+  // Linking sets every uniform to zero, which is then what the shadow holds.
+  shader_program->uniform_shadow = calloc(1, shader_program->uniform_values_size);
+}
+
+// Whether both programs read the same components as uniforms, so that they can share the query of rendered entities.
+static bool same_uniforms(const ShaderProgram* a, const ShaderProgram* b) {
+  if (a->uniforms_count != b->uniforms_count) {
+    return false;
+  }
+
+  for (int j = 0; j < a->uniforms_count; j++) {
+    if (strcmp(a->uniforms[j].name, b->uniforms[j].name) != 0 || a->ecs_uniform_types[j] != b->ecs_uniform_types[j]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void CompileShaders(ecs_iter_t* it) {
+  const ShaderProgramSource* sources = ecs_field(it, ShaderProgramSource, 0);
+  acquire_context();
+
+  for (int i = 0; i < it->count; i++) {
+    const ShaderProgramSource* source = sources + i;
+
+    GLuint vertex_shader = 0, fragment_shader = 0;
+    ShaderProgram shader_program = { 0 };
+
+    char* vertex_shader_source = load_shader_source(source->vertex_shader, source->vertex_shader_path);
+    char* fragment_shader_source = load_shader_source(source->fragment_shader, source->fragment_shader_path);
+    if (vertex_shader_source && fragment_shader_source) {
+      vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
+      fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
+    }
+    free(vertex_shader_source);
+    free(fragment_shader_source);
+
+    if (!vertex_shader || !fragment_shader) {
+      ecs_delete(it->world, it->entities[i]);
+      goto cleanup;
+    }
+
+    shader_program.program = glCreateProgram();
+    glAttachShader(shader_program.program, vertex_shader);
+    glAttachShader(shader_program.program, fragment_shader);
+    glLinkProgram(shader_program.program);
+
+    if (!check_program(shader_program.program)) {
+      glDeleteProgram(shader_program.program);
+      ecs_delete(it->world, it->entities[i]);
+      goto cleanup;
+    }
+
+    ecs_query_desc_t query_description;
+    reflect_program(it->world, it->entities[i], &shader_program, &query_description);
+    shader_program.rendered_entities_query = ecs_query_init(it->world, &query_description);
+
+    ecs_set_id(it->world, it->entities[i], ecs_id(ShaderProgram), sizeof(ShaderProgram), &shader_program);
+    redraw_requested = true;
+
+  cleanup:
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+  }
+}
+
+// Swaps in the programs that were relinked in the background as soon as they are ready.
+static void FinishShaderReloads(ecs_iter_t* it) {
+  ShaderProgram* shader_programs = ecs_field(it, ShaderProgram, 0);
+
+  for (int i = 0; i < it->count; i++) {
+    ShaderProgram* shader_program = shader_programs + i;
+    const GLuint program = shader_program->pending_program;
+    if (!program) {
+      continue;
+    }
+
+    acquire_context();
+    if (parallel_shader_compile) {
+      GLint completed;
+      glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+      if (!completed) {
+        continue;
+      }
+    }
+
+    shader_program->pending_program = 0;
+    if (!check_program(program)) {
+      // Keep rendering with the old version.
+      glDeleteProgram(program);
+      continue;
+    }
+
+    ShaderProgram reloaded = { .program = program };
+    ecs_query_desc_t query_description;
+    reflect_program(it->world, it->entities[i], &reloaded, &query_description);
+
+    if (same_uniforms(shader_program, &reloaded)) {
+      reloaded.rendered_entities_query = shader_program->rendered_entities_query;
+    } else {
+      reloaded.rendered_entities_query = ecs_query_init(it->world, &query_description);
+      ecs_query_fini(shader_program->rendered_entities_query);
+    }
+
+    free_shader_inputs(shader_program);
+    glDeleteProgram(shader_program->program);
+    *shader_program = reloaded;
+    redraw_requested = true;
+  }
+}
+
+#ifdef GLI_LINUX
+typedef struct gli_file_watch_t {
+  ecs_entity_t entity;
+  // The watch descriptor of the directory containing the file. Editors usually save by replacing files, which would
+  // silently end watches on the files themselves.
+  int descriptor;
+  char* path;
+  const char* name;
+  bool changed;
+} gli_file_watch_t;
+
+static int inotify_descriptor = -1;
+static gli_file_watch_t* file_watches;
+static int file_watches_count;
+
+static void unwatch_shader_files(const ecs_entity_t entity) {
+  for (int i = 0; i < file_watches_count; i++) {
+    if (file_watches[i].entity != entity) {
+      continue;
+    }
+
+    const int descriptor = file_watches[i].descriptor;
+    free(file_watches[i].path);
+    file_watches[i--] = file_watches[--file_watches_count];
+
+    bool directory_still_watched = false;
+    for (int j = 0; j < file_watches_count; j++) {
+      directory_still_watched |= file_watches[j].descriptor == descriptor;
+    }
+    if (!directory_still_watched) {
+      inotify_rm_watch(inotify_descriptor, descriptor);
+    }
+  }
+}
+
+static void watch_file(const ecs_entity_t entity, const char* path) {
+  if (inotify_descriptor < 0) {
+    inotify_descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_descriptor < 0) {
+      perror("Cannot watch shader files");
+      return;
+    }
+  }
+
+  const char* slash = strrchr(path, '/');
+  char* directory = slash ? strndup(path, slash == path ? 1 : slash - path) : strdup(".");
+  const int descriptor = inotify_add_watch(inotify_descriptor, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+  free(directory);
+  if (descriptor < 0) {
+    perror(path);
+    return;
+  }
+
+  file_watches = realloc(file_watches, (file_watches_count + 1) * sizeof(gli_file_watch_t));
+  gli_file_watch_t* watch = file_watches + file_watches_count++;
+  *watch = (gli_file_watch_t){
+    .entity = entity,
+    .descriptor = descriptor,
+    .path = strdup(path),
+  };
+  slash = strrchr(watch->path, '/');
+  watch->name = slash ? slash + 1 : watch->path;
+}
+
+static void watch_shader_files(const ecs_entity_t entity, const ShaderProgramSource* source) {
+  const char* paths[] = { source->vertex_shader_path, source->fragment_shader_path };
+
+  // Nothing to do if the paths didn't change, which is the case when we are the ones reloading the files.
+  int matches = 0, watches = 0;
+  for (int i = 0; i < file_watches_count; i++) {
+    if (file_watches[i].entity == entity) {
+      watches++;
+      for (unsigned j = 0; j < GLI_COUNTOF(paths); j++) {
+        if (paths[j] && strcmp(paths[j], file_watches[i].path) == 0) {
+          matches++;
+          break;
+        }
+      }
+    }
+  }
+  if (matches == watches && watches == (paths[0] != NULL) + (paths[1] != NULL)) {
+    return;
+  }
+
+  unwatch_shader_files(entity);
+  for (unsigned i = 0; i < GLI_COUNTOF(paths); i++) {
+    if (paths[i]) {
+      watch_file(entity, paths[i]);
+    }
+  }
+}
+
+static void WatchShaderFiles(ecs_iter_t* it) {
+  if (inotify_descriptor < 0) {
+    return;
+  }
+
+  alignas(struct inotify_event) char buffer[4096];
+  ssize_t length;
+  while ((length = read(inotify_descriptor, buffer, sizeof(buffer))) > 0) {
+    for (const char* pointer = buffer; pointer < buffer + length;) {
+      const struct inotify_event* event = (const struct inotify_event*)pointer;
+      pointer += sizeof(struct inotify_event) + event->len;
+
+      for (int i = 0; event->len && i < file_watches_count; i++) {
+        if (file_watches[i].descriptor == event->wd && strcmp(file_watches[i].name, event->name) == 0) {
+          file_watches[i].changed = true;
+        }
+      }
+    }
+  }
+
+  // Saving a file usually produces several events, so reload each program at most once.
+  for (int i = 0; i < file_watches_count; i++) {
+    if (!file_watches[i].changed) {
+      continue;
+    }
+
+    for (int j = i; j < file_watches_count; j++) {
+      if (file_watches[j].entity == file_watches[i].entity) {
+        file_watches[j].changed = false;
+      }
+    }
+    ecs_modified(it->world, file_watches[i].entity, ShaderProgramSource);
+  }
+}
+
+static void OnRemoveShaderProgramSource(ecs_iter_t* it) {
+  for (int i = 0; i < it->count; i++) {
+    unwatch_shader_files(it->entities[i]);
+  }
+}
+#endif
+
+static void OnSetShaderProgramSource(ecs_iter_t* it) {
+  const ShaderProgramSource* sources = ecs_field(it, ShaderProgramSource, 0);
+
+  for (int i = 0; i < it->count; i++) {
+#ifdef GLI_LINUX
+    watch_shader_files(it->entities[i], sources + i);
+#endif
+
+    // Programs that don't exist yet will be compiled by CompileShaders, the existing ones are reloaded in place.
+    ShaderProgram* shader_program = ecs_get_mut(it->world, it->entities[i], ShaderProgram);
+    if (shader_program) {
+      acquire_context();
+      // Whatever was still compiling is outdated now.
+      glDeleteProgram(shader_program->pending_program);
+      shader_program->pending_program = start_linking_program(sources + i);
+    }
+  }
+}
+
+#pragma region GPU timers
+// Counts frames to pick the slot of the query rings. A slot is reused GLI_GPU_TIMER_FRAMES frames later, when its
+// results are most likely there already.
+static unsigned gpu_timer_frame;
+
+// Reads the result of a query in nanoseconds, only if it is available.
+static bool read_gpu_timer(const GLuint query, GLuint64* result) {
+  if (!query) {
+    return false;
+  }
+
+  GLuint available;
+  glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (available) {
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, result);
+  }
+  return available;
+}
+
+// Makes the query on first use. Only on the main thread, which has the context.
+static GLuint gpu_timer_query(GLuint* query) {
+  if (!*query) {
+    glGenQueries(1, query);
+  }
+  return *query;
+}
+
+static void begin_gpu_timer(gli_command_buffer_t* commands, const GLuint query) {
+  record_command(
+    commands,
+    GLI_COMMAND_BEGIN_QUERY,
+    &(gli_query_command_t){ .target = GL_TIME_ELAPSED, .query = query },
+    sizeof(gli_query_command_t)
+  );
+}
+
+static void end_gpu_timer(gli_command_buffer_t* commands) {
+  record_command(
+    commands,
+    GLI_COMMAND_END_QUERY,
+    &(gli_query_command_t){ .target = GL_TIME_ELAPSED },
+    sizeof(gli_query_command_t)
+  );
+}
+
+static void write_gpu_timestamp(GLuint* query) {
+  glQueryCounter(gpu_timer_query(query), GL_TIMESTAMP);
+}
+
+static void AddGpuTimes(ecs_iter_t* it) {
+  for (int i = 0; i < it->count; i++) {
+    ecs_add(it->world, it->entities[i], GpuTime);
+  }
+}
+
+#ifndef GLI_EMSCRIPTEN
+// Render may run on worker threads, so the results of the programs are read, and their queries made, before it.
+static void ReadGpuTimes(ecs_iter_t* it) {
+  if (skip_rendering || render_thread_enabled) {
+    return;
+  }
+
+  GpuTime* gpu_times = ecs_field(it, GpuTime, 0);
+
+  const unsigned timer_slot = gpu_timer_frame % GLI_GPU_TIMER_FRAMES;
+  for (int i = 0; i < it->count; i++) {
+    GLuint64 elapsed;
+    if (read_gpu_timer(gpu_times[i].queries[timer_slot], &elapsed)) {
+      gpu_times[i].milliseconds = (float)elapsed / 1e6f;
+    }
+    gpu_timer_query(gpu_times[i].queries + timer_slot);
+  }
+}
+#endif
+
+static void OnRemoveGpuFrameTime(ecs_iter_t* it) {
+  ecs_remove_all(it->world, ecs_id(GpuTime));
+}
+#pragma endregion
+
+#pragma region Software occlusion
+#define GLI_OCCLUSION_BANDS 16
+#define GLI_MAX_HI_Z_LEVELS 16
+
+// Screen space triangles of the occluders for this frame, with x and y in pixels of the depth buffer.
+typedef struct gli_occluder_triangle_t {
+  vkm_vec3 vertices[3];
+} gli_occluder_triangle_t;
+
+// Bands of rows of the depth buffer, so that the worker threads can share rasterizing it.
+typedef struct OcclusionBand {
+  int index;
+} OcclusionBand;
+static ECS_COMPONENT_DECLARE(OcclusionBand);
+
+// Only one depth buffer as there is only one window. Each level of the hierarchy stores the farthest depth of the 2x2
+// texels below it, so that a box nearer than all of the texels it covers in any level is hidden.
+typedef struct gli_depth_buffer_t {
+  float* levels[GLI_MAX_HI_Z_LEVELS];
+  vkm_ivec2 sizes[GLI_MAX_HI_Z_LEVELS];
+  int levels_count;
+  gli_occluder_triangle_t* triangles;
+  int triangles_count, triangles_capacity;
+} gli_depth_buffer_t;
+static gli_depth_buffer_t depth_buffer;
+
+static void free_depth_buffer(void) {
+  free(depth_buffer.levels[0]);
+  free(depth_buffer.triangles);
+  depth_buffer = (gli_depth_buffer_t){ 0 };
+}
+
+static void prepare_depth_buffer(const SoftwareOcclusion* software_occlusion, const GLitchWindow* window) {
+  depth_buffer.triangles_count = 0;
+
+  // Rows are rasterized four pixels at a time.
+  const int width = ((software_occlusion->width > 0 ? software_occlusion->width : 256) + 3) & ~3;
+  const int height = vkm_maxi(1, width * window->size.y / vkm_maxi(1, window->size.x));
+  if (depth_buffer.levels[0] && depth_buffer.sizes[0].x == width && depth_buffer.sizes[0].y == height) {
+    return;
+  }
+
+  free(depth_buffer.levels[0]);
+  size_t texels_count = 0;
+  vkm_ivec2 size = { { width, height } };
+  for (depth_buffer.levels_count = 0; depth_buffer.levels_count < GLI_MAX_HI_Z_LEVELS; depth_buffer.levels_count++) {
+    depth_buffer.sizes[depth_buffer.levels_count] = size;
+    texels_count += (size_t)size.x * size.y;
+    if (size.x == 1 && size.y == 1) {
+      depth_buffer.levels_count++;
+      break;
+    }
+    size = (vkm_ivec2){ { (size.x + 1) / 2, (size.y + 1) / 2 } };
+  }
+
+  depth_buffer.levels[0] = malloc(texels_count * sizeof(float));
+  for (int i = 1; i < depth_buffer.levels_count; i++) {
+    depth_buffer.levels[i] = depth_buffer.levels[i - 1] + depth_buffer.sizes[i - 1].x * depth_buffer.sizes[i - 1].y;
+  }
+}
+
+// Transforms a point to clip space, where the depth is z / w.
+static vkm_vec4 transform_point(const vkm_mat4* matrix, const vkm_vec3* point) {
+  vkm_vec4 result;
+  for (int i = 0; i < 4; i++) {
+    result.raw[i] = matrix->columns[0].raw[i] * point->x
+      + matrix->columns[1].raw[i] * point->y
+      + matrix->columns[2].raw[i] * point->z
+      + matrix->columns[3].raw[i];
+  }
+  return result;
+}
+
+// Projects the triangles of the occluders to the depth buffer, keeping the front faces fully in front of the camera.
+static void TransformOccluders(ecs_iter_t* it) {
+  if (skip_rendering) {
+    return;
+  }
+
+  const Position3D* positions = ecs_field(it, Position3D, 0);
+  const Rotation3D* rotations = ecs_field(it, Rotation3D, 1);
+  const Scale3D* scales = ecs_field(it, Scale3D, 2);
+  const OccluderGeometry* geometry = ecs_field(it, OccluderGeometry, 4);
+  const Camera3D* camera = ecs_field(it, Camera3D, 5);
+  SoftwareOcclusion* software_occlusion = ecs_field(it, SoftwareOcclusion, 6);
+
+  if (!depth_buffer.levels[0]) {
+    return;
+  }
+
+  const float width = (float)depth_buffer.sizes[0].x, height = (float)depth_buffer.sizes[0].y;
+  vkm_mat4 view_projection;
+  vkm_mat4_mul(&camera->projection, &camera->view, &view_projection);
+
+  const int triangles_count = geometry->indices_count / 3;
+  if (depth_buffer.triangles_count + it->count * triangles_count > depth_buffer.triangles_capacity) {
+    depth_buffer.triangles_capacity = vkm_maxi(
+      depth_buffer.triangles_capacity * 2,
+      depth_buffer.triangles_count + it->count * triangles_count
+    );
+    depth_buffer.triangles = realloc(
+      depth_buffer.triangles,
+      depth_buffer.triangles_capacity * sizeof(gli_occluder_triangle_t)
+    );
+  }
+
+  for (int i = 0; i < it->count; i++) {
+    vkm_mat4 model = CVKM_MAT4_IDENTITY;
+    vkm_translate(&model, positions + i);
+    if (rotations) {
+      vkm_mat4 rotation;
+      vkm_quat_to_mat4(rotations + i, &rotation);
+      vkm_mat4_mul_rotation(&model, &rotation, &model);
+    }
+    if (scales) {
+      vkm_scale(&model, scales + i);
+    }
+    vkm_mat4 model_view_projection;
+    vkm_mat4_mul(&view_projection, &model, &model_view_projection);
+
+    for (int j = 0; j < triangles_count; j++) {
+      gli_occluder_triangle_t* triangle = depth_buffer.triangles + depth_buffer.triangles_count;
+      bool outside[4] = { true, true, true, true };
+      for (int k = 0; k < 3; k++) {
+        const int index = geometry->indices ? (int)geometry->indices[j * 3 + k] : j * 3 + k;
+        const vkm_vec4 clip = transform_point(&model_view_projection, geometry->positions + index);
+        // Clipping against the near plane isn't worth it, just drop the triangle.
+        if (clip.w < camera->near_plane) {
+          goto next_triangle;
+        }
+
+        outside[0] &= clip.x < -clip.w;
+        outside[1] &= clip.x > clip.w;
+        outside[2] &= clip.y < -clip.w;
+        outside[3] &= clip.y > clip.w;
+        triangle->vertices[k] = (vkm_vec3){ {
+          (clip.x / clip.w * 0.5f + 0.5f) * width,
+          (clip.y / clip.w * 0.5f + 0.5f) * height,
+          clip.z / clip.w,
+        } };
+      }
+
+      if (outside[0] || outside[1] || outside[2] || outside[3]) {
+        continue;
+      }
+
+      // Counter-clockwise triangles face the camera.
+      const vkm_vec3* v = triangle->vertices;
+      if ((v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y) > 0.0f) {
+        depth_buffer.triangles_count++;
+      }
+    next_triangle:;
+    }
+  }
+
+  software_occlusion->occluder_triangles = depth_buffer.triangles_count;
+}
+
+// Rasterizes one triangle into the rows [first_row, end_row) of the depth buffer, sampling at pixel centers.
+static void rasterize_triangle(const gli_occluder_triangle_t* triangle, const int first_row, const int end_row) {
+  const vkm_vec3* v = triangle->vertices;
+  const int width = depth_buffer.sizes[0].x;
+  const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+
+  // Depth is linear in screen space, as a plane.
+  const float depth_dx = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+  const float depth_dy = ((v[1].x - v[0].x) * (v[2].z - v[0].z) - (v[2].x - v[0].x) * (v[1].z - v[0].z)) / area;
+
+  const int min_x = vkm_maxi(0, (int)floorf(vkm_minf(vkm_minf(v[0].x, v[1].x), v[2].x)));
+  const int max_x = vkm_mini(width - 1, (int)ceilf(vkm_maxf(vkm_maxf(v[0].x, v[1].x), v[2].x)));
+  const int min_y = vkm_maxi(first_row, (int)floorf(vkm_minf(vkm_minf(v[0].y, v[1].y), v[2].y)));
+  const int max_y = vkm_mini(end_row - 1, (int)ceilf(vkm_maxf(vkm_maxf(v[0].y, v[1].y), v[2].y)));
+  if (min_x > max_x || min_y > max_y) {
+    return;
+  }
 
-  for (int i = 0; i < it->count; i++) {
-    const MeshData* mesh_data = mesh_datas + i;
+  // Edge functions, positive inside, and how much they change per pixel.
+  float edge_dx[3], edge_dy[3], edge_row_start[3];
+  const int first_x = min_x & ~3;
+  for (int i = 0; i < 3; i++) {
+    const vkm_vec3* a = v + (i + 1) % 3;
+    const vkm_vec3* b = v + (i + 2) % 3;
+    edge_dx[i] = a->y - b->y;
+    edge_dy[i] = b->x - a->x;
+    edge_row_start[i] = (b->x - a->x) * ((float)min_y + 0.5f - a->y) - (b->y - a->y) * ((float)first_x + 0.5f - a->x);
+  }
+  float depth_row_start = v[0].z
+    + depth_dx * ((float)first_x + 0.5f - v[0].x)
+    + depth_dy * ((float)min_y + 0.5f - v[0].y);
+
+  for (int y = min_y; y <= max_y; y++) {
+    float* row = depth_buffer.levels[0] + y * width;
+#ifdef GLI_SSE2
+    const __m128 steps = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    __m128 edges[3], edges_step[3];
+    for (int i = 0; i < 3; i++) {
+      edges[i] = _mm_add_ps(_mm_set1_ps(edge_row_start[i]), _mm_mul_ps(steps, _mm_set1_ps(edge_dx[i])));
+      edges_step[i] = _mm_set1_ps(edge_dx[i] * 4.0f);
+    }
+    __m128 depth = _mm_add_ps(_mm_set1_ps(depth_row_start), _mm_mul_ps(steps, _mm_set1_ps(depth_dx)));
+    const __m128 depth_step = _mm_set1_ps(depth_dx * 4.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (int x = first_x; x <= max_x; x += 4) {
+      const __m128 inside = _mm_and_ps(
+        _mm_and_ps(_mm_cmpge_ps(edges[0], zero), _mm_cmpge_ps(edges[1], zero)),
+        _mm_cmpge_ps(edges[2], zero)
+      );
+      const __m128 old_depth = _mm_loadu_ps(row + x);
+      const __m128 new_depth = _mm_min_ps(old_depth, depth);
+      _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_depth), _mm_andnot_ps(inside, old_depth)));
 
-    Mesh* mesh = ecs_ensure(it->world, it->entities[i], Mesh);
+      for (int i = 0; i < 3; i++) {
+        edges[i] = _mm_add_ps(edges[i], edges_step[i]);
+      }
+      depth = _mm_add_ps(depth, depth_step);
+    }
+#else
+    float edges[3] = { edge_row_start[0], edge_row_start[1], edge_row_start[2] };
+    float depth = depth_row_start;
+    for (int x = first_x; x <= max_x; x++) {
+      if (edges[0] >= 0.0f && edges[1] >= 0.0f && edges[2] >= 0.0f && depth < row[x]) {
+        row[x] = depth;
+      }
 
-    mesh->vertices_count = mesh_data->vertices_count;
-    mesh->indices_count = mesh_data->indices_count;
-    mesh->primitive = mesh_data->primitive;
-    assert(mesh->primitive);
+      for (int i = 0; i < 3; i++) {
+        edges[i] += edge_dx[i];
+      }
+      depth += depth_dx;
+    }
+#endif
 
-    if (mesh_data->data) {
-      glGenVertexArrays(1, &mesh->vertex_array);
-      glBindVertexArray(mesh->vertex_array);
+    for (int i = 0; i < 3; i++) {
+      edge_row_start[i] += edge_dy[i];
+    }
+    depth_row_start += depth_dy;
+  }
+}
 
-      glGenBuffers(1, &mesh->vertex_buffer);
-      glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer);
+// Runs on the worker threads, each band clearing its rows and rasterizing every triangle touching them.
+static void RasterizeOccluders(ecs_iter_t* it) {
+  if (skip_rendering) {
+    return;
+  }
 
-      // As we iterate the vertex attributes, the buffer size serves as an offset, too.
-      GLsizeiptr buffer_size = 0;
-      for (int j = 0; mesh_data->vertex_attributes[j].type && j < GLI_MAX_ATTRIBUTES; j++) {
-        const gli_type_info_t info = type_infos[mesh_data->vertex_attributes[j].type];
-
-        if (info.type == GL_FLOAT) {
-          glVertexAttribPointer(
-            j,
-            info.vector_components,
-            info.type,
-            mesh_data->vertex_attributes[j].normalize,
-            0,
-            (const GLvoid*)buffer_size
-          );
-        } else {
-          glVertexAttribIPointer(j, info.vector_components, info.type, 0, (const GLvoid*)buffer_size);
-        }
+  const OcclusionBand* bands = ecs_field(it, OcclusionBand, 0);
 
-        glEnableVertexAttribArray(j);
-        buffer_size += info.size * mesh_data->vertices_count;
-      }
+  if (!depth_buffer.levels[0]) {
+    return;
+  }
+
+  const int width = depth_buffer.sizes[0].x, height = depth_buffer.sizes[0].y;
+  const int rows_per_band = (height + GLI_OCCLUSION_BANDS - 1) / GLI_OCCLUSION_BANDS;
+  for (int i = 0; i < it->count; i++) {
+    const int first_row = vkm_mini(height, bands[i].index * rows_per_band);
+    const int end_row = vkm_mini(height, first_row + rows_per_band);
 
-      glBufferData(GL_ARRAY_BUFFER, buffer_size, mesh_data->data, GL_STATIC_DRAW);
+    // The far plane, whether depth goes from -1 or 0.
+    for (int j = first_row * width; j < end_row * width; j++) {
+      depth_buffer.levels[0][j] = 1.0f;
+    }
 
-      if (mesh_data->indices) {
-        glGenBuffers(1, &mesh->index_buffer);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->index_buffer);
-        glBufferData(
-          GL_ELEMENT_ARRAY_BUFFER,
-          (int)sizeof(*mesh_data->indices) * mesh_data->indices_count,
-          mesh_data->indices,
-          GL_STATIC_DRAW
+    for (int j = 0; j < depth_buffer.triangles_count; j++) {
+      rasterize_triangle(depth_buffer.triangles + j, first_row, end_row);
+    }
+  }
+}
+
+static void BuildHierarchicalDepth(ecs_iter_t* it) {
+  if (skip_rendering) {
+    return;
+  }
+
+  (void)it;
+
+  for (int i = 1; i < depth_buffer.levels_count; i++) {
+    const float* source = depth_buffer.levels[i - 1];
+    const vkm_ivec2 source_size = depth_buffer.sizes[i - 1];
+    float* destination = depth_buffer.levels[i];
+    const vkm_ivec2 size = depth_buffer.sizes[i];
+    for (int y = 0; y < size.y; y++) {
+      const int y0 = y * 2, y1 = vkm_mini(y * 2 + 1, source_size.y - 1);
+      for (int x = 0; x < size.x; x++) {
+        const int x0 = x * 2, x1 = vkm_mini(x * 2 + 1, source_size.x - 1);
+        destination[y * size.x + x] = vkm_maxf(
+          vkm_maxf(source[y0 * source_size.x + x0], source[y0 * source_size.x + x1]),
+          vkm_maxf(source[y1 * source_size.x + x0], source[y1 * source_size.x + x1])
         );
       }
-    } else {
-      mesh->vertex_array = attributeless_vertex_array;
     }
+  }
+}
 
-    ecs_modified(it->world, it->entities[i], Mesh);
-    ecs_remove(it->world, it->entities[i], MeshData);
+static void OnAddSoftwareOcclusion(ecs_iter_t* it) {
+  for (int i = 0; i < GLI_OCCLUSION_BANDS; i++) {
+    ecs_set(it->world, ecs_new(it->world), OcclusionBand, { i });
   }
 }
 
-static void CompileShaders(ecs_iter_t* it) {
-  const ShaderProgramSource* sources = ecs_field(it, ShaderProgramSource, 0);
+static void OnRemoveSoftwareOcclusion(ecs_iter_t* it) {
+  ecs_delete_with(it->world, ecs_id(OcclusionBand));
+  free_depth_buffer();
+}
 
-  for (int i = 0; i < it->count; i++) {
-    const ShaderProgramSource* source = sources + i;
+// Whether the bounding box, transformed by the matrix to clip space, is certainly behind the occluders.
+static bool is_occluded(const vkm_mat4* model_view_projection, const vkm_vec3* bounds_min, const vkm_vec3* bounds_max) {
+  const float width = (float)depth_buffer.sizes[0].x, height = (float)depth_buffer.sizes[0].y;
+  float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX, min_depth = FLT_MAX;
+  for (int i = 0; i < 8; i++) {
+    const vkm_vec3 corner = { {
+      i & 1 ? bounds_max->x : bounds_min->x,
+      i & 2 ? bounds_max->y : bounds_min->y,
+      i & 4 ? bounds_max->z : bounds_min->z,
+    } };
+    const vkm_vec4 clip = transform_point(model_view_projection, &corner);
+    // Crossing the near plane, so it's in the face of the camera.
+    if (clip.w <= 0.0f) {
+      return false;
+    }
 
-    GLuint vertex_shader = 0, fragment_shader = 0;
-    ShaderProgram shader_program;
+    const float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+    const float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+    min_x = vkm_minf(min_x, x);
+    max_x = vkm_maxf(max_x, x);
+    min_y = vkm_minf(min_y, y);
+    max_y = vkm_maxf(max_y, y);
+    min_depth = vkm_minf(min_depth, clip.z / clip.w);
+  }
 
-    vertex_shader = compile_shader(GL_VERTEX_SHADER, source->vertex_shader);
-    fragment_shader = compile_shader(GL_FRAGMENT_SHADER, source->fragment_shader);
+  // Nothing to say about boxes out of the screen.
+  if (max_x < 0.0f || max_y < 0.0f || min_x >= width || min_y >= height) {
+    return false;
+  }
 
-    if (!vertex_shader || !fragment_shader) {
-      ecs_delete(it->world, it->entities[i]);
-      goto cleanup;
+  vkm_ivec2 first = { { vkm_maxi(0, (int)min_x), vkm_maxi(0, (int)min_y) } };
+  vkm_ivec2 last = { { vkm_mini((int)width - 1, (int)max_x), vkm_mini((int)height - 1, (int)max_y) } };
+
+  // Go up the hierarchy until the box covers a few texels at most.
+  int level = 0;
+  while (level < depth_buffer.levels_count - 1 && (last.x - first.x > 3 || last.y - first.y > 3)) {
+    level++;
+    first = (vkm_ivec2){ { first.x / 2, first.y / 2 } };
+    last = (vkm_ivec2){ { last.x / 2, last.y / 2 } };
+  }
+
+  const float* texels = depth_buffer.levels[level];
+  const int level_width = depth_buffer.sizes[level].x;
+  for (int y = first.y; y <= last.y; y++) {
+    for (int x = first.x; x <= last.x; x++) {
+      if (min_depth <= texels[y * level_width + x]) {
+        return false;
+      }
     }
+  }
 
-    shader_program.program = glCreateProgram();
-    glAttachShader(shader_program.program, vertex_shader);
-    glAttachShader(shader_program.program, fragment_shader);
-    glLinkProgram(shader_program.program);
+  return true;
+}
+#pragma endregion
 
-    GLint success;
-    glGetProgramiv(shader_program.program, GL_LINK_STATUS, &success);
-    if (!success) {
-      char info_log[1000];
-      glGetProgramInfoLog(shader_program.program, sizeof(info_log), NULL, info_log);
-      fprintf(stderr, "Program linking failed: %s\n", info_log);
-      glDeleteProgram(shader_program.program);
-      ecs_delete(it->world, it->entities[i]);
-      goto cleanup;
+#pragma region Frame capture
+#define GLI_CAPTURE_BANDS 16
+
+// Bands of rows of the captured frame, so that the worker threads can share converting it.
+typedef struct CaptureBand {
+  int index;
+} CaptureBand;
+static ECS_COMPONENT_DECLARE(CaptureBand);
+
+// The frame being delivered, mapped between ReadFrameCapture and DeliverFrameCapture. Rows from bottom to top.
+static const uint8_t* captured_pixels;
+
+// BT.601 with limited range, in 8.8 fixed point.
+static void convert_to_luma(const uint8_t* rgba, uint8_t* luma, const int count) {
+  int i = 0;
+#ifdef GLI_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i coefficients = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+  const __m128i rounding = _mm_set1_epi32(128);
+  const __m128i offset = _mm_set1_epi16(16);
+  for (; i + 16 <= count; i += 16) {
+    __m128i sums[4];
+    for (int j = 0; j < 4; j++) {
+      const __m128i pixels = _mm_loadu_si128((const __m128i*)(rgba + (i + j * 4) * 4));
+      // Per pixel, 66 r + 129 g and 25 b in adjacent lanes...
+      const __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), coefficients);
+      const __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), coefficients);
+      // ...which are gathered apart to be added.
+      const __m128i low_halves = _mm_shuffle_epi32(low, _MM_SHUFFLE(3, 1, 2, 0));
+      const __m128i high_halves = _mm_shuffle_epi32(high, _MM_SHUFFLE(3, 1, 2, 0));
+      const __m128i sum = _mm_add_epi32(
+        _mm_unpacklo_epi64(low_halves, high_halves),
+        _mm_unpackhi_epi64(low_halves, high_halves)
+      );
+      sums[j] = _mm_srai_epi32(_mm_add_epi32(sum, rounding), 8);
     }
+    const __m128i first = _mm_add_epi16(_mm_packs_epi32(sums[0], sums[1]), offset);
+    const __m128i second = _mm_add_epi16(_mm_packs_epi32(sums[2], sums[3]), offset);
+    _mm_storeu_si128((__m128i*)(luma + i), _mm_packus_epi16(first, second));
+  }
+#endif
+  for (; i < count; i++) {
+    const uint8_t* pixel = rgba + i * 4;
+    luma[i] = (uint8_t)(((66 * pixel[0] + 129 * pixel[1] + 25 * pixel[2] + 128) >> 8) + 16);
+  }
+}
 
-    GLint max_length;
-    glGetProgramiv(shader_program.program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
-    char* name_buffer = malloc(max_length);
+// Averages each 2x2 block of pixels, the ones past the edges repeat the last row or column.
+static void convert_to_chroma(
+  const uint8_t* rgba_row,
+  const uint8_t* rgba_next_row,
+  uint8_t* u,
+  uint8_t* v,
+  const int width
+) {
+  for (int x = 0; x < (width + 1) / 2; x++) {
+    const int left = x * 2 * 4, right = vkm_mini(x * 2 + 1, width - 1) * 4;
+    int r = 0, g = 0, b = 0;
+    for (int i = 0; i < 2; i++) {
+      const uint8_t* row = i == 0 ? rgba_row : rgba_next_row;
+      r += row[left] + row[right];
+      g += row[left + 1] + row[right + 1];
+      b += row[left + 2] + row[right + 2];
+    }
+    r = (r + 2) / 4;
+    g = (g + 2) / 4;
+    b = (b + 2) / 4;
+    u[x] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    v[x] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+  }
+}
 
-    glGetProgramiv(shader_program.program, GL_ACTIVE_UNIFORMS, &shader_program.uniforms_count);
-    shader_program.uniforms = malloc(shader_program.uniforms_count * sizeof(gli_shader_input_data));
-    for (int j = 0, skipped = 0; j < shader_program.uniforms_count; j++) {
-      gli_shader_input_data* uniform = shader_program.uniforms + j - skipped;
+static size_t capture_size(const gli_capture_format_t format, const vkm_usvec2 size) {
+  const size_t pixels = (size_t)size.x * size.y;
+  if (format == GLI_CAPTURE_YUV420) {
+    return pixels + 2 * (size_t)((size.x + 1) / 2) * ((size.y + 1) / 2);
+  }
+  return pixels * 4;
+}
 
-      GLint size;
-      glGetActiveUniform(shader_program.program, j, max_length, NULL, &size, &uniform->type, name_buffer);
+#ifndef GLI_EMSCRIPTEN
+// Maps the oldest buffer of the ring, which the frame about to be rendered will use again.
+static void ReadFrameCapture(ecs_iter_t* it) {
+  if (skip_rendering || render_thread_enabled) {
+    return;
+  }
 
-      // Pretend built-in uniforms don't exist here.
-      for (unsigned k = 0; k < GLI_COUNTOF(built_in_names); k++) {
-        if (strcmp(name_buffer, built_in_names[k]) == 0) {
-          skipped++;
-          goto next;
-        }
-      }
+  FrameCapture* capture = ecs_field(it, FrameCapture, 0);
 
-      uniform->name = strdup(name_buffer);
-      uniform->location = glGetUniformLocation(shader_program.program, name_buffer);
-    next:;
-    }
+  const int slot = (int)(capture->issued % GLI_CAPTURE_FRAMES);
+  if (!capture->fences[slot]) {
+    return;
+  }
+
+  if (glClientWaitSync(capture->fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) {
+    capture->stalls++;
+    // A second, wasting the frame is better than waiting forever on a lost context.
+    glClientWaitSync(capture->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+  }
+  glDeleteSync(capture->fences[slot]);
+  capture->fences[slot] = NULL;
+
+  const vkm_usvec2 size = capture->sizes[slot];
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffers[slot]);
+  captured_pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size.x * size.y * 4, GL_MAP_READ_BIT);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  if (!captured_pixels) {
+    return;
+  }
+
+  const size_t needed = capture_size(capture->format, size);
+  if (capture->size != needed) {
+    free(capture->pixels);
+    capture->pixels = malloc(needed);
+    capture->size = needed;
+  }
+  capture->frame_size = size;
+  capture->frame = capture->issued - GLI_CAPTURE_FRAMES;
+}
+
+// Flips the rows to go from top to bottom and converts them to the format.
+static void ConvertFrameCapture(ecs_iter_t* it) {
+  if (skip_rendering || render_thread_enabled) {
+    return;
+  }
+
+  const CaptureBand* bands = ecs_field(it, CaptureBand, 0);
+  FrameCapture* capture = ecs_field(it, FrameCapture, 1);
+
+  if (!captured_pixels) {
+    return;
+  }
 
-    // Assuming we always insert all the built-in uniforms into the shader code.
-    shader_program.uniforms_count -= GLI_BUILT_IN_UNIFORMS_COUNT;
-    assert(shader_program.uniforms_count >= 0);
-    if (shader_program.uniforms_count > GLI_MAX_UNIFORMS) {
-      // Trim the excess uniforms in case there are too many of them.
-      shader_program.uniforms_count = GLI_MAX_UNIFORMS;
+  const int width = capture->frame_size.x, height = capture->frame_size.y;
+  // Even, so that each band has whole rows of chroma.
+  const int rows_per_band = ((height + GLI_CAPTURE_BANDS - 1) / GLI_CAPTURE_BANDS + 1) & ~1;
+  for (int i = 0; i < it->count; i++) {
+    const int first_row = vkm_mini(height, bands[i].index * rows_per_band);
+    const int end_row = vkm_mini(height, first_row + rows_per_band);
+
+    if (capture->format == GLI_CAPTURE_RGBA) {
+      for (int y = first_row; y < end_row; y++) {
+        memcpy(
+          capture->pixels + (size_t)y * width * 4,
+          captured_pixels + (size_t)(height - 1 - y) * width * 4,
+          (size_t)width * 4
+        );
+      }
+      continue;
     }
 
-    // Compact memory.
-    if (shader_program.uniforms_count > 0) {
-      shader_program.uniforms = realloc(
-        shader_program.uniforms,
-        shader_program.uniforms_count * sizeof(gli_shader_input_data)
+    const int chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+    uint8_t* u_plane = capture->pixels + (size_t)width * height;
+    uint8_t* v_plane = u_plane + (size_t)chroma_width * chroma_height;
+    for (int y = first_row; y < end_row; y++) {
+      const uint8_t* source = captured_pixels + (size_t)(height - 1 - y) * width * 4;
+      convert_to_luma(source, capture->pixels + (size_t)y * width, width);
+    }
+    for (int y = first_row / 2; y < (end_row + 1) / 2; y++) {
+      const int top = height - 1 - y * 2, bottom = vkm_maxi(0, top - 1);
+      convert_to_chroma(
+        captured_pixels + (size_t)top * width * 4,
+        captured_pixels + (size_t)bottom * width * 4,
+        u_plane + (size_t)y * chroma_width,
+        v_plane + (size_t)y * chroma_width,
+        width
       );
-    } else {
-      free(shader_program.uniforms);
-      shader_program.uniforms = NULL;
     }
+  }
+}
 
-    free(name_buffer);
+static void DeliverFrameCapture(ecs_iter_t* it) {
+  if (skip_rendering || render_thread_enabled) {
+    return;
+  }
 
-    glGetProgramiv(shader_program.program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
-    name_buffer = malloc(max_length);
+  FrameCapture* capture = ecs_field(it, FrameCapture, 0);
 
-    glGetProgramiv(shader_program.program, GL_ACTIVE_ATTRIBUTES, &shader_program.attributes_count);
-    shader_program.attributes = malloc(shader_program.attributes_count * sizeof(gli_shader_input_data));
-    for (int j = 0; j < shader_program.attributes_count; j++) {
-      GLint size;
-      glGetActiveAttrib(
-        shader_program.program,
-        j,
-        max_length,
-        NULL,
-        &size,
-        &shader_program.attributes[j].type,
-        name_buffer
-      );
-      shader_program.attributes[j].name = strdup(name_buffer);
-      shader_program.attributes[j].location = glGetAttribLocation(shader_program.program, name_buffer);
-    }
-
-    free(name_buffer);
-
-    // Build the query to find all entities that provide the necessary uniforms.
-
-    // If you change the terms here, remember to update the static variable called "reserved_terms"!!
-    ecs_query_desc_t query_description = {
-      .terms = {
-        {
-          .id = ecs_id(Position2D),
-          .inout = EcsIn,
-          .oper = EcsOr,
-        },
-        {
-          .id = ecs_id(Position3D),
-          .inout = EcsIn,
-        },
-        {
-          .id = ecs_id(Rotation2D),
-          .inout = EcsIn,
-          .oper = EcsOptional,
-        },
-        {
-          .id = ecs_id(Rotation3D),
-          .inout = EcsIn,
-          .oper = EcsOptional,
-        },
-        {
-          .id = ecs_id(Scale2D),
-          .inout = EcsIn,
-          .oper = EcsOptional,
-        },
-        {
-          .id = ecs_id(Scale3D),
-          .inout = EcsIn,
-          .oper = EcsOptional,
-        },
-        {
-          .first.id = ecs_id(Uses),
-          .second.id = it->entities[i],
-          .inout = EcsInOutNone,
-        },
-        {
-          .first.id = ecs_id(Uses),
-          .second.name = "$mesh",
-          .inout = EcsInOutNone,
-        },
-        {
-          .id = ecs_id(Mesh),
-          .src.name = "$mesh",
-          .inout = EcsIn,
-        },
-      },
-      .cache_kind = EcsQueryCacheAuto,
-    };
+  if (!captured_pixels) {
+    return;
+  }
 
-    for (int j = 0, count = shader_program.uniforms_count, skipped_uniforms = 0; j < count; j++) {
-      const gli_shader_input_data* uniform = shader_program.uniforms + j - skipped_uniforms;
-      uint8_t* ecs_uniform_type = shader_program.ecs_uniform_types + j - skipped_uniforms;
-
-      const bool provided_by_entity = strncmp("entity", uniform->name, 6) == 0;
-      const char* component_name = uniform->name + (provided_by_entity ? 6 : 0);
-
-      const ecs_entity_t component = ecs_lookup_symbol(it->world, component_name, false, false);
-      if (!component) {
-        fprintf(stderr, "Component %s not found.\n", component_name);
-        goto invalid_component;
-      }
-
-      bool type_matches = false;
-      const EcsPrimitive* primitive = ecs_get(it->world, component, EcsPrimitive);
-      if (primitive) {
-        switch (uniform->type) {
-          case GL_FLOAT:
-            type_matches = primitive->kind == EcsF32;
-            *ecs_uniform_type = GLI_FLOAT;
-            break;
-          case GL_INT:
-            type_matches = primitive->kind == EcsI32;
-            *ecs_uniform_type = GLI_INT;
-            break;
-          case GL_UNSIGNED_INT:
-            type_matches = primitive->kind == EcsU32;
-            *ecs_uniform_type = GLI_UINT;
-            break;
-          default:
-            break;
-        }
-      }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffers[capture->issued % GLI_CAPTURE_FRAMES]);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  captured_pixels = NULL;
 
-      if (!type_matches) {
-        switch (uniform->type) {
-          case GL_FLOAT_VEC2:
-            type_matches = ecs_has_pair(it->world, component, EcsIsA, ecs_id(vkm_vec2));
-            *ecs_uniform_type = GLI_VEC2;
-            break;
-          case GL_FLOAT_VEC3:
-            type_matches = ecs_has_pair(it->world, component, EcsIsA, ecs_id(vkm_vec3));
-            *ecs_uniform_type = GLI_VEC3;
-            break;
-          case GL_FLOAT_VEC4:
-            type_matches = ecs_has_pair(it->world, component, EcsIsA, ecs_id(vkm_vec4));
-            *ecs_uniform_type = GLI_VEC4;
-            break;
-          case GL_INT_VEC2:
-            type_matches = ecs_has_pair(it->world, component, EcsIsA, ecs_id(vkm_ivec2));
-            *ecs_uniform_type = GLI_IVEC2;
-            break;
-          case GL_INT_VEC3:
-            type_matches = ecs_has_pair(it->world, component, EcsIsA, ecs_id(vkm_ivec3));
-            *ecs_uniform_type = GLI_IVEC3;
-            break;
-          case GL_INT_VEC4:
-            type_matches = ecs_has_pair(it->world, component, EcsIsA, ecs_id(vkm_ivec4));
-            *ecs_uniform_type = GLI_IVEC4;
-            break;
-          case GL_UNSIGNED_INT_VEC2:
-            type_matches = ecs_has_pair(it->world, component, EcsIsA, ecs_id(vkm_uvec2));
-            *ecs_uniform_type = GLI_UVEC2;
-            break;
-          case GL_UNSIGNED_INT_VEC3:
-            type_matches = ecs_has_pair(it->world, component, EcsIsA, ecs_id(vkm_uvec3));
-            *ecs_uniform_type = GLI_UVEC3;
-            break;
-          case GL_UNSIGNED_INT_VEC4:
-            type_matches = ecs_has_pair(it->world, component, EcsIsA, ecs_id(vkm_uvec4));
-            *ecs_uniform_type = GLI_UVEC4;
-            break;
-          case GL_FLOAT_MAT4:
-            type_matches = ecs_has_pair(it->world, component, EcsIsA, ecs_id(vkm_mat4));
-            *ecs_uniform_type = GLI_MAT4;
-            break;
-          default:
-            break;
-        }
-      }
+  if (capture->callback) {
+    capture->callback(it->world, capture, capture->callback_context);
+  }
+}
 
-      if (!type_matches) {
-        char buffer[22];
-        const char* name = ecs_get_name(it->world, component);
-        if (!name) {
-          name = ecs_get_symbol(it->world, component);
-        }
-        if (!name) {
-          sprintf(buffer, "#%llu", (unsigned long long)component);
-        }
-        printf(
-          "The type of the component %s doesn't match the type the shader requires (0x%x).\n",
-          name ? name : buffer,
-          uniform->type
-        );
-        goto invalid_component;
-      }
+// Starts reading back what was just rendered. Nothing waits for it until the slot comes around again.
+static void IssueFrameCapture(ecs_iter_t* it) {
+  if (skip_rendering || render_thread_enabled) {
+    return;
+  }
 
-      assert(j + GLI_RESERVED_TERMS - skipped_uniforms < FLECS_TERM_COUNT_MAX);
-      query_description.terms[j + GLI_RESERVED_TERMS - skipped_uniforms] = (ecs_term_t){
-        .id = component,
-        .src.id = provided_by_entity ? 0 : it->entities[i],
-        .inout = EcsIn,
-      };
+  FrameCapture* capture = ecs_field(it, FrameCapture, 0);
+  const GLitchWindow* window = ecs_field(it, GLitchWindow, 1);
 
-      continue;
+  const int slot = (int)(capture->issued % GLI_CAPTURE_FRAMES);
+  if (!capture->buffers[slot]) {
+    glGenBuffers(1, capture->buffers + slot);
+  }
 
-    invalid_component:
-      // Delete the uniform registry.
-      shader_program.uniforms_count--;
-      assert(shader_program.uniforms_count >= 0);
-
-      if (shader_program.uniforms_count > 0) {
-        free(shader_program.uniforms[j - skipped_uniforms].name);
-        memmove(
-          shader_program.uniforms + j - skipped_uniforms,
-          shader_program.uniforms + j - skipped_uniforms + 1,
-          (shader_program.uniforms_count - j + skipped_uniforms) * sizeof(gli_shader_input_data)
-        );
-        shader_program.uniforms = realloc(
-          shader_program.uniforms,
-          shader_program.uniforms_count * sizeof(gli_shader_input_data)
-        );
-      } else {
-        free(shader_program.uniforms);
-        shader_program.uniforms = NULL;
-      }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffers[slot]);
+  if (!vkm_eq(&capture->sizes[slot], &window->size)) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)window->size.x * window->size.y * 4, NULL, GL_STREAM_READ);
+    capture->sizes[slot] = window->size;
+  }
+  glReadPixels(0, 0, window->size.x, window->size.y, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  capture->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  capture->issued++;
+}
+#endif
+
+static void OnAddFrameCapture(ecs_iter_t* it) {
+  for (int i = 0; i < GLI_CAPTURE_BANDS; i++) {
+    ecs_set(it->world, ecs_new(it->world), CaptureBand, { i });
+  }
+}
+
+static void OnRemoveFrameCapture(ecs_iter_t* it) {
+  ecs_delete_with(it->world, ecs_id(CaptureBand));
+}
+#pragma endregion
+
+#pragma region Frame pacing
+// Room for the time that the thread takes to wake up after sleeping, in nanoseconds.
+#define GLI_PACING_MARGIN 500000
 
-      skipped_uniforms++;
+// Whether FramePacing::swap_interval still has to be given to the window.
+static bool swap_interval_outdated;
+// When the last frame was done rendering, before the swap.
+static int64_t frame_rendered_at;
+
+// Nanoseconds on the clock that the deadlines are on.
+static int64_t pacing_now(void) {
+#ifdef GLI_WINDOWS
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (int64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+static void sleep_until(const int64_t deadline) {
+#ifdef GLI_LINUX
+  const struct timespec time = { .tv_sec = deadline / 1000000000, .tv_nsec = deadline % 1000000000 };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL) == EINTR) {}
+#elif defined(GLI_WINDOWS)
+  // Sleep only counts whole milliseconds, and often oversleeps by one. Spin for the rest.
+  const int64_t remaining = deadline - pacing_now();
+  if (remaining > 2000000) {
+    Sleep((DWORD)(remaining / 1000000 - 1));
+  }
+  while (pacing_now() < deadline) {
+    YieldProcessor();
+  }
+#else
+  (void)deadline;
+#endif
+}
+
+#ifdef GLI_LINUX
+// Whether the list of extensions separated by spaces has this one, and not only one that starts with its name, like
+// GLX_EXT_swap_control_tear for GLX_EXT_swap_control.
+static bool has_glx_extension(const char* extensions, const char* name) {
+  if (!extensions) {
+    return false;
+  }
+  const size_t length = strlen(name);
+  for (const char* found = strstr(extensions, name); found; found = strstr(found + length, name)) {
+    if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || !found[length])) {
+      return true;
     }
+  }
 
-    shader_program.rendered_entities_query = ecs_query_init(it->world, &query_description);
+  return false;
+}
+#endif
 
-    ecs_set_id(it->world, it->entities[i], ecs_id(ShaderProgram), sizeof(ShaderProgram), &shader_program);
+static void set_swap_interval(const GLitchWindow* window, const int interval) {
+#ifdef GLI_LINUX
+  const char* extensions = glXQueryExtensionsString(window->display, DefaultScreen(window->display));
+  const glXSwapIntervalEXTProc glXSwapIntervalEXT = has_glx_extension(extensions, "GLX_EXT_swap_control")
+    ? (glXSwapIntervalEXTProc)glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalEXT")
+    : NULL;
+  const glXSwapIntervalMESAProc glXSwapIntervalMESA = has_glx_extension(extensions, "GLX_MESA_swap_control")
+    ? (glXSwapIntervalMESAProc)glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalMESA")
+    : NULL;
+  if (glXSwapIntervalEXT) {
+    glXSwapIntervalEXT(window->display, window->window, interval);
+  } else if (glXSwapIntervalMESA) {
+    // No adaptive vsync here.
+    glXSwapIntervalMESA((unsigned)abs(interval));
+  } else {
+    fprintf(stderr, "Can't set the swap interval: no GLX_EXT_swap_control nor GLX_MESA_swap_control\n");
+  }
+#elif defined(GLI_WINDOWS)
+  (void)window;
+  const PFNWGLSWAPINTERVALEXTPROC wglSwapIntervalEXT =
+    (PFNWGLSWAPINTERVALEXTPROC)wglGetProcAddress("wglSwapIntervalEXT");
+  if (!wglSwapIntervalEXT || !wglSwapIntervalEXT(interval)) {
+    fprintf(stderr, "Can't set the swap interval to %d\n", interval);
+  }
+#else
+  (void)window;
+  (void)interval;
+#endif
+}
 
-  cleanup:
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+static void PaceFrame(ecs_iter_t* it) {
+  FramePacing* pacing = ecs_field(it, FramePacing, 0);
+  const GLitchWindow* window = ecs_field(it, GLitchWindow, 1);
+
+  if (swap_interval_outdated && window->backend == GLI_BACKEND_WINDOW && window->context) {
+    // The interval is set on the current context, which the render thread may have.
+    acquire_context();
+    set_swap_interval(window, pacing->swap_interval);
+    swap_interval_outdated = false;
+  }
+
+  if (pacing->target_fps > 0.0f) {
+    const int64_t period = (int64_t)(1e9 / pacing->target_fps);
+    const int64_t predicted_cost = (int64_t)(pacing->predicted_cost * 1e6f);
+    const int64_t now = pacing_now();
+    pacing->deadline += period;
+    if (now > pacing->deadline) {
+      // Way too late, or the first frame: we don't try to catch up.
+      pacing->deadline = now + predicted_cost;
+    } else if (now < pacing->deadline - predicted_cost) {
+      sleep_until(pacing->deadline - predicted_cost);
+    }
+  }
+
+  pacing->frame_start = pacing_now();
+}
+
+static void FinishFramePacing(ecs_iter_t* it) {
+  FramePacing* pacing = ecs_field(it, FramePacing, 0);
+
+  if (pacing->finish && !skip_rendering && !render_thread_enabled) {
+    glFinish();
+  }
+
+  const int64_t end = pacing_now();
+  const int64_t rendered = skip_rendering || frame_rendered_at < pacing->frame_start ? end : frame_rendered_at;
+  const int slot = (int)(pacing->frames % GLI_PACING_FRAMES);
+  pacing->costs[slot] = rendered - pacing->frame_start;
+  pacing->frame_times[slot] = pacing->last_frame_end ? end - pacing->last_frame_end : 0;
+  pacing->last_frame_end = end;
+  pacing->frames++;
+  if (pacing->target_fps > 0.0f && end > pacing->deadline) {
+    pacing->missed++;
+  }
+
+  // The worst recent frame predicts the next one. Sleeping too little is cheaper than missing a deadline.
+  const int count = (int)vkm_minl(pacing->frames, GLI_PACING_FRAMES);
+  int64_t worst_cost = 0;
+  double sum = 0.0, squares_sum = 0.0;
+  int frame_times_count = 0;
+  for (int i = 0; i < count; i++) {
+    worst_cost = vkm_maxl(worst_cost, pacing->costs[i]);
+    if (pacing->frame_times[i] > 0) {
+      const double milliseconds = (double)pacing->frame_times[i] * 1e-6;
+      sum += milliseconds;
+      squares_sum += milliseconds * milliseconds;
+      frame_times_count++;
+    }
   }
+
+  pacing->predicted_cost = (float)(worst_cost + GLI_PACING_MARGIN) * 1e-6f;
+  if (frame_times_count > 0) {
+    const double mean = sum / frame_times_count;
+    pacing->frame_time = (float)mean;
+    pacing->frame_time_variance = vkm_maxf((float)(squares_sum / frame_times_count - mean * mean), 0.0f);
+  }
+}
+
+static void OnSetFramePacing(ecs_iter_t* it) {
+  (void)it;
+  swap_interval_outdated = true;
 }
+#pragma endregion
 
 static void PreRenderFrame(ecs_iter_t* it) {
+  if (skip_rendering) {
+    return;
+  }
+
   const ClearColor* clear_color = ecs_field(it, ClearColor, 0);
   Camera2D* camera_2d = ecs_field(it, Camera2D, 1);
   const Position2D* camera_2d_position = ecs_field(it, Position2D, 2);
@@ -731,6 +7070,35 @@ static void PreRenderFrame(ecs_iter_t* it) {
   const Position3D* camera_3d_position = ecs_field(it, Position3D, 4);
   const Rotation3D* camera_3d_rotation = ecs_field(it, Rotation3D, 5);
   GLitchWindow* window = ecs_field(it, GLitchWindow, 6);
+  OcclusionCulling* occlusion_culling = ecs_field(it, OcclusionCulling, 7);
+  SoftwareOcclusion* software_occlusion = ecs_field(it, SoftwareOcclusion, 8);
+  GpuFrameTime* gpu_frame_time = render_thread_enabled ? NULL : ecs_field(it, GpuFrameTime, 9);
+  gli_frame_commands_t* frame = frame_commands + recording_frame;
+  prepare_recordings(frame, ecs_get_stage_count(it->world));
+  gli_command_buffer_t* commands = &frame->main;
+#ifdef GLI_EMSCRIPTEN
+  (void)gpu_frame_time;
+#endif
+
+  // Here rather than in Render, which runs on every worker thread.
+  static bool warned = false;
+  if (!camera_2d && !camera_3d) {
+    if (!warned) {
+      warned = true;
+      printf("Missing both 2D and 3D cameras!\n");
+    }
+  } else {
+    warned = false;
+  }
+
+  if (occlusion_culling) {
+    *occlusion_culling = (OcclusionCulling){ 0 };
+  }
+
+  if (software_occlusion) {
+    software_occlusion->occluder_triangles = software_occlusion->tested = software_occlusion->culled = 0;
+    prepare_depth_buffer(software_occlusion, window);
+  }
 
   if (camera_2d) {
     // Compute 2D projection matrix.
@@ -787,11 +7155,12 @@ static void PreRenderFrame(ecs_iter_t* it) {
   }
 
 #ifdef GLI_LINUX
-  while (XPending(window->display)) {
+  while (window->display && XPending(window->display)) {
     XEvent event;
     XNextEvent(window->display, &event);
     switch (event.type) {
       case ConfigureNotify:
+        acquire_context();
         glViewport(0, 0, window->size.x = event.xconfigure.width, window->size.y = event.xconfigure.height);
         break;
       case ClientMessage:
@@ -813,32 +7182,124 @@ static void PreRenderFrame(ecs_iter_t* it) {
     TranslateMessage(&message);
     DispatchMessage(&message);
   }
-#endif
+#endif
+
+#ifndef GLI_EMSCRIPTEN
+  const unsigned timer_slot = gpu_timer_frame % GLI_GPU_TIMER_FRAMES;
+  if (gpu_frame_time) {
+    GLuint64 start, end, clear;
+    if (read_gpu_timer(gpu_frame_time->end_queries[timer_slot], &end)) {
+      read_gpu_timer(gpu_frame_time->start_queries[timer_slot], &start);
+      gpu_frame_time->frame = (float)(end - start) / 1e6f;
+    }
+    if (read_gpu_timer(gpu_frame_time->clear_queries[timer_slot], &clear)) {
+      gpu_frame_time->clear = (float)clear / 1e6f;
+    }
+
+    write_gpu_timestamp(gpu_frame_time->start_queries + timer_slot);
+  }
+#endif
+
+  if (clear_color) {
+#ifndef GLI_EMSCRIPTEN
+    if (gpu_frame_time) {
+      begin_gpu_timer(commands, gpu_timer_query(gpu_frame_time->clear_queries + timer_slot));
+    }
+#endif
+
+    record_command(commands, GLI_COMMAND_CLEAR, clear_color, sizeof(ClearColor));
+
+#ifndef GLI_EMSCRIPTEN
+    if (gpu_frame_time) {
+      end_gpu_timer(commands);
+    }
+#endif
+  }
+}
+
+// A level only becomes coarser once its error fits in this fraction less than the maximum, so that entities sitting
+// right at the threshold don't keep popping between levels.
+#define GLI_LOD_HYSTERESIS 0.25f
+
+static void SelectLevelsOfDetail(ecs_iter_t* it) {
+  if (skip_rendering) {
+    return;
+  }
+
+  LevelOfDetail* levels_of_detail = ecs_field(it, LevelOfDetail, 0);
+  const Position3D* positions = ecs_field(it, Position3D, 1);
+  const Scale3D* scales = ecs_field(it, Scale3D, 2);
+  const Mesh* mesh = ecs_field(it, Mesh, 4);
+  const Camera3D* camera = ecs_field(it, Camera3D, 5);
+  const Position3D* camera_position = ecs_field(it, Position3D, 6);
+  const GLitchWindow* window = ecs_field(it, GLitchWindow, 7);
+
+  // How many pixels a unit of length covers at a unit of distance in front of the camera.
+  const float pixels_per_unit =
+    (float)window->size.y / (2.0f * vkm_tan(camera->field_of_view * CVKM_DEG_2_RAD_F * 0.5f));
+
+  // The farthest the mesh gets from its origin, so that distances are measured to the closest it can get to the camera.
+  vkm_vec3 farthest;
+  for (int j = 0; j < 3; j++) {
+    farthest.raw[j] = vkm_maxf(fabsf(mesh->bounds_min.raw[j]), fabsf(mesh->bounds_max.raw[j]));
+  }
+  const float radius = vkm_magnitude(&farthest);
 
-  if (clear_color) {
-    glClearColor(clear_color->r, clear_color->g, clear_color->b, clear_color->a);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  for (int i = 0; i < it->count; i++) {
+    LevelOfDetail* level_of_detail = levels_of_detail + i;
+    if (mesh->lods_count < 2) {
+      level_of_detail->level = 0;
+      continue;
+    }
+
+    const float scale = scales ? vkm_maxf(vkm_maxf(scales[i].x, scales[i].y), scales[i].z) : 1.0f;
+    vkm_vec3 offset;
+    vkm_sub(positions + i, camera_position, &offset);
+    const float distance = vkm_maxf(vkm_magnitude(&offset) - radius * scale, camera->near_plane);
+    // Converts errors in the space of the mesh to pixels.
+    const float factor = scale * pixels_per_unit / distance;
+    const float max_error = level_of_detail->max_screen_error;
+
+    int level = level_of_detail->level < mesh->lods_count ? level_of_detail->level : mesh->lods_count - 1;
+    while (level > 0 && mesh->lods[level].error * factor > max_error) {
+      level--;
+    }
+    while (
+      level + 1 < mesh->lods_count
+      && mesh->lods[level + 1].error * factor <= max_error * (1.0f - GLI_LOD_HYSTERESIS)
+    ) {
+      level++;
+    }
+    level_of_detail->level = (uint8_t)level;
   }
 }
 
 static void Render(ecs_iter_t* it) {
+  if (skip_rendering) {
+    return;
+  }
+
   const ShaderProgram* shader_programs = ecs_field(it, ShaderProgram, 0);
   const Camera2D* camera_2d = ecs_field(it, Camera2D, 1);
   const Camera3D* camera_3d = ecs_field(it, Camera3D, 2);
   const GLitchWindow* window = ecs_field(it, GLitchWindow, 3);
+  // With a render thread, what needs the context on the main thread is left out.
+  const OcclusionCulling* occlusion_culling = render_thread_enabled ? NULL : ecs_field(it, OcclusionCulling, 4);
+  const SoftwareOcclusion* software_occlusion = ecs_field(it, SoftwareOcclusion, 5);
+  const GpuTime* gpu_times = render_thread_enabled ? NULL : ecs_field(it, GpuTime, 6);
+#ifdef GLI_EMSCRIPTEN
+  (void)gpu_times;
+#endif
+  ShaderProgramStats* shader_program_stats = ecs_field(it, ShaderProgramStats, 7);
 
-  // No camera? No rendering.
-  static bool warned = false;
+  // No camera? No rendering. PreRenderFrame warns about it.
   if (!camera_2d && !camera_3d) {
-    if (!warned) {
-      warned = true;
-      printf("Missing both 2D and 3D cameras!\n");
-    }
     return;
   }
 
-  warned = false;
-
+  // Each stage records the programs it was given into its own buffer.
+  gli_recording_t* recording = frame_commands[recording_frame].recordings + ecs_stage_get_id(it->world);
+  gli_command_buffer_t* commands = &recording->commands;
   built_ins_t built_ins = {
     .resolution = { { (float)window->size.x, (float)window->size.y } },
     .time = (float)ecs_get_world_info(it->world)->world_time_total,
@@ -847,8 +7308,67 @@ static void Render(ecs_iter_t* it) {
 
   for (int i = 0; i < it->count; i++) {
     const ShaderProgram* shader_program = shader_programs + i;
+    RenderStats stats = { 0 };
+    const size_t begin = commands->size;
+
+#ifndef GLI_EMSCRIPTEN
+    if (gpu_times) {
+      begin_gpu_timer(commands, gpu_times[i].queries[gpu_timer_frame % GLI_GPU_TIMER_FRAMES]);
+    }
+#endif
+
+    record_command(commands, GLI_COMMAND_USE_PROGRAM, &shader_program->program, sizeof(GLuint));
+    stats.program_binds++;
+
+    // The executor skips the bind when the program before left the atlas bound.
+    const TextureAtlas* atlas = NULL;
+    for (int32_t k = 0; !atlas; k++) {
+      const ecs_entity_t target = ecs_get_target(it->world, it->entities[i], ecs_id(Uses), k);
+      if (!target) {
+        break;
+      }
+      atlas = ecs_get(it->world, target, TextureAtlas);
+    }
+    if (atlas && atlas->texture) {
+      record_command(commands, GLI_COMMAND_BIND_TEXTURE, &atlas->texture, sizeof(GLuint));
+      stats.texture_binds++;
+    }
+
+    // Uniforms provided by the program itself are the same for all of its entities, so they are set once. Without
+    // them, the query doesn't match any entity anyway.
+    const int entity_uploads_count = shader_program->entity_uploads_count;
+    const int program_uploads_count = shader_program->uniforms_count - entity_uploads_count;
+    const void* program_values[GLI_MAX_UNIFORMS];
+    bool has_program_values = program_uploads_count > 0;
+    for (int k = 0; k < program_uploads_count; k++) {
+      const int uniform = shader_program->upload_uniforms[entity_uploads_count + k];
+      const ecs_id_t component = shader_program->rendered_entities_query->terms[uniform + GLI_RESERVED_TERMS].id;
+      program_values[k] = ecs_get_id(it->world, it->entities[i], component);
+      has_program_values &= program_values[k] != NULL;
+    }
+    if (has_program_values) {
+      record_uniform_uploads(
+        commands,
+        shader_program->uploads + entity_uploads_count,
+        program_uploads_count,
+        shader_program->uniform_shadow + shader_program->entity_values_size
+      );
+      uint8_t* values = push_command(
+        commands,
+        GLI_COMMAND_SET_UNIFORMS,
+        shader_program->uniform_values_size - shader_program->entity_values_size
+      );
+      for (int k = 0; k < program_uploads_count; k++) {
+        const int size = shader_program->uploads[entity_uploads_count + k].size;
+        memcpy(values, program_values[k], size);
+        values += size;
+      }
+      stats.uniform_values += program_uploads_count;
+    }
 
-    glUseProgram(shader_program->program);
+    if (entity_uploads_count) {
+      record_uniform_uploads(commands, shader_program->uploads, entity_uploads_count, shader_program->uniform_shadow);
+    }
 
     ecs_iter_t rendered_entities_it = ecs_query_iter(it->world, shader_program->rendered_entities_query);
     while (ecs_query_next(&rendered_entities_it)) {
@@ -883,23 +7403,57 @@ static void Render(ecs_iter_t* it) {
       const Scale2D* scales_2d = ecs_field(&rendered_entities_it, Scale2D, 3);
       const Scale3D* scales_3d = ecs_field(&rendered_entities_it, Scale3D, 4);
       const Mesh* mesh = ecs_field(&rendered_entities_it, Mesh, 7);
-      const void* uniform_components[GLI_MAX_UNIFORMS] = { 0 };
-      for (int j = 0; j < shader_program->uniforms_count; j++) {
-        const int8_t field_index = (int8_t)(j + GLI_SHADER_QUERY_TERMS);
-        uniform_components[j] = ecs_field_w_size(
-          &rendered_entities_it,
-          ecs_field_size(&rendered_entities_it, field_index),
-          field_index
-        );
+      const LevelOfDetail* levels_of_detail = is_2d ? NULL : ecs_table_get_id(
+        it->world,
+        rendered_entities_it.table,
+        ecs_id(LevelOfDetail),
+        rendered_entities_it.offset
+      );
+      const OcclusionQuery* occlusion_queries = is_2d || !occlusion_culling ? NULL : ecs_table_get_id(
+        it->world,
+        rendered_entities_it.table,
+        ecs_id(OcclusionQuery),
+        rendered_entities_it.offset
+      );
+      const uint8_t* uniform_components[GLI_MAX_UNIFORMS] = { 0 };
+      size_t uniform_strides[GLI_MAX_UNIFORMS] = { 0 };
+      for (int k = 0; k < entity_uploads_count; k++) {
+        const int8_t field_index = (int8_t)(shader_program->upload_uniforms[k] + GLI_SHADER_QUERY_TERMS);
+        const size_t size = ecs_field_size(&rendered_entities_it, field_index);
+        uniform_components[k] = ecs_field_w_size(&rendered_entities_it, size, field_index);
+        // Inherited values, like the region of an image, are shared by the whole table.
+        uniform_strides[k] = ecs_field_is_self(&rendered_entities_it, field_index) ? size : 0;
       }
 
-      glBindVertexArray(mesh->vertex_array);
+      // Meshes without bounds can't be tested.
+      const bool test_occlusion = !is_2d && software_occlusion && depth_buffer.levels[0] && (
+        mesh->bounds_min.x < mesh->bounds_max.x
+        || mesh->bounds_min.y < mesh->bounds_max.y
+        || mesh->bounds_min.z < mesh->bounds_max.z
+      );
+      vkm_mat4 view_projection;
+      if (test_occlusion) {
+        vkm_mat4_mul(&built_ins.projection, &built_ins.view, &view_projection);
+      }
+
+      record_command(commands, GLI_COMMAND_BIND_VERTEX_ARRAY, &mesh->vertex_array, sizeof(GLuint));
+      stats.vertex_array_binds++;
+      stats.tables++;
 
       for (int j = 0; j < rendered_entities_it.count; j++) {
+        // Entities without a query yet haven't been tested.
+        const OcclusionQuery* occlusion_query = occlusion_queries && occlusion_queries[j].query
+          ? occlusion_queries + j
+          : NULL;
+        if (occlusion_query && !occlusion_query->visible) {
+          recording->occlusion_culled++;
+          continue;
+        }
+
         built_ins.model = CVKM_MAT4_IDENTITY;
 
         if (is_2d) {
-          const Position2D* position = (Position2D*)positions + i;
+          const Position2D* position = (Position2D*)positions + j;
           vkm_translate(&built_ins.model, position);
 
           if (rotations_2d) {
@@ -922,110 +7476,431 @@ static void Render(ecs_iter_t* it) {
           if (scales_3d) {
             vkm_scale(&built_ins.model, scales_3d + j);
           }
-        }
 
-        glBindBuffer(GL_UNIFORM_BUFFER, built_ins_uniform_buffer);
-        glBufferData(GL_UNIFORM_BUFFER, sizeof(built_ins_t), &built_ins, GL_STREAM_DRAW);
-
-        // Set per-entity uniforms.
-        for (int k = 0; k < shader_program->uniforms_count; k++) {
-          const gli_data_type_t data_type = shader_program->ecs_uniform_types[k];
-          if (!data_type) {
-            continue;
+          if (test_occlusion) {
+            vkm_mat4 model_view_projection;
+            vkm_mat4_mul(&view_projection, &built_ins.model, &model_view_projection);
+            recording->software_tested++;
+            if (is_occluded(&model_view_projection, &mesh->bounds_min, &mesh->bounds_max)) {
+              recording->software_culled++;
+              continue;
+            }
           }
+        }
 
-          switch (data_type) {
-            case GLI_INT:
-              glUniform1iv(shader_program->uniforms[k].location, 1, (GLint*)uniform_components[k] + j);
-              break;
-            case GLI_UINT:
-              glUniform1uiv(shader_program->uniforms[k].location, 1, (GLuint*)uniform_components[k] + j);
-              break;
-            case GLI_FLOAT:
-              glUniform1fv(shader_program->uniforms[k].location, 1, (GLfloat*)uniform_components[k] + j);
-              break;
-            case GLI_IVEC2:
-              glUniform2iv(shader_program->uniforms[k].location, 1, (GLint*)((vkm_ivec2*)uniform_components[k] + j));
-              break;
-            case GLI_UVEC2:
-              glUniform2uiv(shader_program->uniforms[k].location, 1, (GLuint*)((vkm_uvec2*)uniform_components[k] + j));
-              break;
-            case GLI_VEC2:
-              glUniform2fv(shader_program->uniforms[k].location, 1, (GLfloat*)((vkm_vec2*)uniform_components[k] + j));
-              break;
-            case GLI_IVEC3:
-              glUniform3iv(shader_program->uniforms[k].location, 1, (GLint*)((vkm_ivec3*)uniform_components[k] + j));
-              break;
-            case GLI_UVEC3:
-              glUniform3uiv(shader_program->uniforms[k].location, 1, (GLuint*)((vkm_uvec3*)uniform_components[k] + j));
-              break;
-            case GLI_VEC3:
-              glUniform3fv(shader_program->uniforms[k].location, 1, (GLfloat*)((vkm_vec3*)uniform_components[k] + j));
-              break;
-            case GLI_IVEC4:
-              glUniform4iv(shader_program->uniforms[k].location, 1, (GLint*)((vkm_ivec4*)uniform_components[k] + j));
-              break;
-            case GLI_UVEC4:
-              glUniform4uiv(shader_program->uniforms[k].location, 1, (GLuint*)((vkm_uvec4*)uniform_components[k] + j));
-              break;
-            case GLI_VEC4:
-              glUniform4fv(shader_program->uniforms[k].location, 1, (GLfloat*)((vkm_vec4*)uniform_components[k] + j));
-              break;
-            case GLI_MAT4:
-              glUniformMatrix4fv(
-                shader_program->uniforms[k].location,
-                1,
-                GL_FALSE,
-                (GLfloat*)((vkm_mat4*)uniform_components[k] + j)
-              );
-              break;
-            default:
-              assert(false);
+        struct mesh_lod lod = { .indices_count = mesh->index_buffer ? mesh->indices_count : mesh->vertices_count };
+        if (mesh->index_buffer && levels_of_detail && mesh->lods_count) {
+          lod = mesh->lods[levels_of_detail[j].level < mesh->lods_count ? levels_of_detail[j].level : 0];
+        }
+        record_command(commands, GLI_COMMAND_UPDATE_BUILT_INS, &built_ins, sizeof(built_ins_t));
+        stats.buffer_binds++;
+        stats.uploaded_bytes += (int64_t)sizeof(built_ins_t);
+
+        // Set per-entity uniforms, copying their values in the order of the uploads.
+        if (entity_uploads_count) {
+          uint8_t* values = push_command(commands, GLI_COMMAND_SET_UNIFORMS, shader_program->entity_values_size);
+          for (int k = 0; k < entity_uploads_count; k++) {
+            memcpy(values, uniform_components[k] + j * uniform_strides[k], shader_program->uploads[k].size);
+            values += shader_program->uploads[k].size;
           }
+          stats.uniform_values += entity_uploads_count;
         }
 
-        if (mesh->index_buffer) {
-          glDrawElements(mesh->primitive - 1, mesh->indices_count, GL_UNSIGNED_INT, NULL);
-        } else {
-          glDrawArrays(mesh->primitive - 1, 0, mesh->vertices_count);
+#ifndef GLI_EMSCRIPTEN
+        // It was visible last time we knew, but there may be a newer result already on the GPU side.
+        const bool conditional = occlusion_query && occlusion_query->pending;
+        if (conditional) {
+          record_command(commands, GLI_COMMAND_BEGIN_CONDITIONAL_RENDER, &occlusion_query->query, sizeof(GLuint));
+        }
+#endif
+
+        const gli_draw_command_t draw = {
+          .primitive = mesh->primitive,
+          .count = lod.indices_count,
+          .first_index = lod.first_index,
+          .index_type = mesh->index_buffer ? mesh->index_type : 0,
+        };
+        record_command(commands, GLI_COMMAND_DRAW, &draw, sizeof(gli_draw_command_t));
+        count_draw(&stats, mesh->primitive, lod.indices_count);
+
+#ifndef GLI_EMSCRIPTEN
+        if (conditional) {
+          record_command(commands, GLI_COMMAND_END_CONDITIONAL_RENDER, NULL, 0);
         }
+#endif
       }
     }
+
+#ifndef GLI_EMSCRIPTEN
+    if (gpu_times) {
+      end_gpu_timer(commands);
+    }
+#endif
+
+    if (shader_program_stats) {
+      shader_program_stats[i] = stats;
+    }
+    add_render_stats(&recording->stats, &stats);
+    // Worker iterators keep the offset of the slice in the results of the query.
+    record_program(recording, it->frame_offset + i, begin);
+  }
+}
+
+static void AddOcclusionQueries(ecs_iter_t* it) {
+  for (int i = 0; i < it->count; i++) {
+    ecs_add(it->world, it->entities[i], OcclusionQuery);
+  }
+}
+
+static void ReadOcclusionQueries(ecs_iter_t* it) {
+  if (skip_rendering || render_thread_enabled) {
+    return;
+  }
+
+  OcclusionQuery* occlusion_queries = ecs_field(it, OcclusionQuery, 0);
+
+  for (int i = 0; i < it->count; i++) {
+    OcclusionQuery* occlusion_query = occlusion_queries + i;
+    if (!occlusion_query->pending) {
+      continue;
+    }
+
+    // Never wait for a result, just keep using the last one.
+    GLuint available;
+    glGetQueryObjectuiv(occlusion_query->query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint any_samples_passed;
+      glGetQueryObjectuiv(occlusion_query->query, GL_QUERY_RESULT, &any_samples_passed);
+      occlusion_query->visible = any_samples_passed;
+      occlusion_query->pending = false;
+    }
+  }
+}
+
+static GLuint occlusion_program, occlusion_box_vertex_array, occlusion_box_buffers[2];
+
+static bool prepare_occlusion_boxes(void) {
+  if (occlusion_program) {
+    return true;
+  }
+
+  const GLuint vertex_shader = compile_shader(
+    GL_VERTEX_SHADER,
+    "layout(location = 0) in vec3 position;\n"
+    "\n"
+    "void main() {\n"
+    "  gl_Position = projection * view * model * vec4(position, 1.0);\n"
+    "}\n"
+  );
+  const GLuint fragment_shader = compile_shader(
+    GL_FRAGMENT_SHADER,
+    "out vec4 fragment_color;\n"
+    "\n"
+    "void main() {\n"
+    "  fragment_color = vec4(1.0);\n"
+    "}\n"
+  );
+  if (vertex_shader && fragment_shader) {
+    occlusion_program = glCreateProgram();
+    glAttachShader(occlusion_program, vertex_shader);
+    glAttachShader(occlusion_program, fragment_shader);
+    glLinkProgram(occlusion_program);
+    if (!check_program(occlusion_program)) {
+      glDeleteProgram(occlusion_program);
+      occlusion_program = 0;
+    }
+  }
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+
+  if (!occlusion_program) {
+    return false;
+  }
+
+  static const float vertices[] = {
+    -0.5f, -0.5f, -0.5f,
+     0.5f, -0.5f, -0.5f,
+    -0.5f,  0.5f, -0.5f,
+     0.5f,  0.5f, -0.5f,
+    -0.5f, -0.5f,  0.5f,
+     0.5f, -0.5f,  0.5f,
+    -0.5f,  0.5f,  0.5f,
+     0.5f,  0.5f,  0.5f,
+  };
+  // Winding doesn't matter, face culling is disabled while testing.
+  static const unsigned char indices[] = {
+    0, 1, 2, 2, 1, 3,
+    4, 6, 5, 5, 6, 7,
+    0, 2, 4, 4, 2, 6,
+    1, 5, 3, 3, 5, 7,
+    0, 4, 1, 1, 4, 5,
+    2, 3, 6, 6, 3, 7,
+  };
+
+  glGenVertexArrays(1, &occlusion_box_vertex_array);
+  glBindVertexArray(occlusion_box_vertex_array);
+  glGenBuffers(2, occlusion_box_buffers);
+  glBindBuffer(GL_ARRAY_BUFFER, occlusion_box_buffers[0]);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, occlusion_box_buffers[1]);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+  return true;
+}
+
+// Tests the bounding boxes against the depth buffer of the frame just rendered. Entities whose last query has no result
+// yet are not tested again, so that we never wait for the GPU.
+static void IssueOcclusionQueries(ecs_iter_t* it) {
+  if (skip_rendering || render_thread_enabled) {
+    return;
+  }
+
+  OcclusionQuery* occlusion_queries = ecs_field(it, OcclusionQuery, 0);
+  const Position3D* positions = ecs_field(it, Position3D, 1);
+  const Rotation3D* rotations = ecs_field(it, Rotation3D, 2);
+  const Scale3D* scales = ecs_field(it, Scale3D, 3);
+  const Mesh* mesh = ecs_field(it, Mesh, 5);
+  const Camera3D* camera = ecs_field(it, Camera3D, 6);
+  const Position3D* camera_position = ecs_field(it, Position3D, 7);
+  OcclusionCulling* occlusion_culling = ecs_field(it, OcclusionCulling, 8);
+  const GLitchWindow* window = ecs_field(it, GLitchWindow, 9);
+
+  vkm_vec3 center, size;
+  vkm_add(&mesh->bounds_min, &mesh->bounds_max, &center);
+  vkm_mul(&center, 0.5f, &center);
+  vkm_sub(&mesh->bounds_max, &mesh->bounds_min, &size);
+  // A bit bigger, so that the box doesn't fight with the surface it encloses in the depth test.
+  vkm_mul(&size, 1.01f, &size);
+  const float half_diagonal = vkm_magnitude(&size) * 0.5f;
+
+  if (half_diagonal <= 0.0f || !prepare_occlusion_boxes()) {
+    return;
+  }
+
+  built_ins_t built_ins = {
+    .view = camera->view,
+    .projection = camera->projection,
+    .resolution = { { (float)window->size.x, (float)window->size.y } },
+    .time = (float)ecs_get_world_info(it->world)->world_time_total,
+    .delta_time = it->delta_time,
+  };
+
+  glUseProgram(occlusion_program);
+  glBindVertexArray(occlusion_box_vertex_array);
+  glBindBuffer(GL_UNIFORM_BUFFER, built_ins_uniform_buffer);
+  frame_stats.program_binds++;
+  frame_stats.vertex_array_binds++;
+  frame_stats.buffer_binds++;
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glDepthMask(GL_FALSE);
+  glDepthFunc(GL_LEQUAL);
+  glDisable(GL_CULL_FACE);
+
+  for (int i = 0; i < it->count; i++) {
+    OcclusionQuery* occlusion_query = occlusion_queries + i;
+    if (occlusion_query->pending) {
+      continue;
+    }
+
+    // Boxes around the camera can't be tested by rasterizing them, and the entity may well be visible anyway.
+    const float scale = scales ? vkm_maxf(vkm_maxf(scales[i].x, scales[i].y), scales[i].z) : 1.0f;
+    vkm_vec3 offset;
+    vkm_sub(positions + i, camera_position, &offset);
+    if (vkm_magnitude(&offset) <= (half_diagonal + vkm_magnitude(&center)) * scale + camera->near_plane) {
+      occlusion_query->visible = true;
+      continue;
+    }
+
+    if (!occlusion_query->query) {
+      glGenQueries(1, &occlusion_query->query);
+    }
+
+    built_ins.model = CVKM_MAT4_IDENTITY;
+    vkm_translate(&built_ins.model, positions + i);
+    if (rotations) {
+      vkm_mat4 rotation;
+      vkm_quat_to_mat4(rotations + i, &rotation);
+      vkm_mat4_mul_rotation(&built_ins.model, &rotation, &built_ins.model);
+    }
+    if (scales) {
+      vkm_scale(&built_ins.model, scales + i);
+    }
+    vkm_translate(&built_ins.model, &center);
+    vkm_scale(&built_ins.model, &size);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(built_ins_t), &built_ins, GL_STREAM_DRAW);
+    frame_stats.uploaded_bytes += (int64_t)sizeof(built_ins_t);
+
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, occlusion_query->query);
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, NULL);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    count_draw(&frame_stats, GLI_TRIANGLES, 36);
+
+    occlusion_query->pending = true;
+    occlusion_culling->tested++;
+  }
+
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glDepthMask(GL_TRUE);
+  glDepthFunc(GL_LESS);
+  glEnable(GL_CULL_FACE);
+}
+
+static void ExecuteCommands(ecs_iter_t* it) {
+  if (skip_rendering) {
+    return;
+  }
+
+  CommandStream* command_stream = ecs_field(it, CommandStream, 0);
+  OcclusionCulling* occlusion_culling = ecs_field(it, OcclusionCulling, 2);
+  SoftwareOcclusion* software_occlusion = ecs_field(it, SoftwareOcclusion, 3);
+
+  // Merge what the stages counted.
+  gli_frame_commands_t* frame = frame_commands + recording_frame;
+  int64_t commands_count = frame->main.count, bytes = (int64_t)frame->main.size;
+  for (int i = 0; i < frame->recordings_count; i++) {
+    gli_recording_t* recording = frame->recordings + i;
+    commands_count += recording->commands.count;
+    bytes += (int64_t)recording->commands.size;
+    add_render_stats(&frame_stats, &recording->stats);
+    if (occlusion_culling) {
+      occlusion_culling->culled += recording->occlusion_culled;
+    }
+    if (software_occlusion) {
+      software_occlusion->tested += recording->software_tested;
+      software_occlusion->culled += recording->software_culled;
+    }
+    recording->stats = (RenderStats){ 0 };
+    recording->occlusion_culled = recording->software_tested = recording->software_culled = 0;
+  }
+
+  if (command_stream) {
+    command_stream->commands = commands_count;
+    command_stream->bytes = bytes;
+  }
+
+  // The render thread executes them instead, once PostRenderFrame submits them.
+  if (render_thread_enabled) {
+    if (command_stream && render_thread) {
+      ecs_os_mutex_lock(render_thread_mutex);
+      command_stream->uniform_calls = render_thread_uniform_calls;
+      command_stream->skipped_uniform_calls = render_thread_skipped_uniform_calls;
+      command_stream->texture_binds = render_thread_texture_binds;
+      ecs_os_mutex_unlock(render_thread_mutex);
+    }
+    return;
+  }
+
+  const int replays = command_stream ? vkm_maxi(command_stream->replays, 0) : 0;
+  int64_t uniform_calls = 0, skipped_uniform_calls = 0, texture_binds = 0;
+  ecs_time_t start = { 0 };
+  ecs_time_measure(&start);
+  for (int i = 0; i <= replays; i++) {
+    execute_frame_commands(frame);
+    uniform_calls += frame->uniform_calls;
+    skipped_uniform_calls += frame->skipped_uniform_calls;
+    texture_binds += frame->texture_binds;
+  }
+  if (command_stream) {
+    command_stream->execute = (float)(ecs_time_measure(&start) * 1e3 / (replays + 1));
+    command_stream->uniform_calls = (int)(uniform_calls / (replays + 1));
+    command_stream->skipped_uniform_calls = (int)(skipped_uniform_calls / (replays + 1));
+    command_stream->texture_binds = (int)(texture_binds / (replays + 1));
   }
+  clear_frame_commands(frame);
 }
 
 static void PostRenderFrame(ecs_iter_t* it) {
+  if (skip_rendering) {
+    return;
+  }
+
   const GLitchWindow* window = ecs_field(it, GLitchWindow, 0);
-#ifdef GLI_LINUX
-  glXSwapBuffers(window->display, window->window);
-#elif defined(GLI_WINDOWS)
-  SwapBuffers(window->device_context_handle);
-#elif defined(GLI_EMSCRIPTEN)
-  (void)window;
+  GpuFrameTime* gpu_frame_time = ecs_field(it, GpuFrameTime, 1);
+  RenderStats* render_stats = ecs_field(it, RenderStats, 2);
+  NullBackendStats* null_backend_stats = ecs_field(it, NullBackendStats, 3);
+  RenderThread* render_thread_stats = ecs_field(it, RenderThread, 4);
+
+  if (render_stats) {
+    *render_stats = frame_stats;
+  }
+  frame_stats = (RenderStats){ 0 };
+
+#ifndef GLI_EMSCRIPTEN
+  // The stubs are called by the render thread too, so their counts are taken once it executed the last frame, which
+  // submitting this one waits for anyway.
+  wait_for_render_thread();
+  if (null_backend_stats) {
+    *null_backend_stats = null_stats;
+  }
+  null_stats = (NullBackendStats){ 0 };
+
+  frame_rendered_at = pacing_now();
+  if (render_thread_enabled) {
+    submit_commands(window);
+    if (render_thread_stats) {
+      render_thread_stats->wait = (float)(render_thread_wait * 1e3);
+      render_thread_stats->draw = (float)(render_thread_draw * 1e3);
+    }
+    render_thread_wait = 0.0;
+    return;
+  }
+
+  if (gpu_frame_time) {
+    write_gpu_timestamp(gpu_frame_time->end_queries + gpu_timer_frame % GLI_GPU_TIMER_FRAMES);
+  }
+  gpu_timer_frame++;
+#else
+  (void)gpu_frame_time;
+  (void)null_backend_stats;
+  (void)render_thread_stats;
 #endif
 
-  GLenum error;
-  while ((error = glGetError()) != GL_NO_ERROR) {
-    fprintf(stderr, "OpenGL error 0x%x\n", error);
+  present_frame(window);
+}
+
+static bool has_extension(const char* name) {
+  GLint count;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++) {
+    if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0) {
+      return true;
+    }
   }
+
+  return false;
 }
 
 #ifdef GLI_LINUX
-#define gli_get_proc_address(fun) glXGetProcAddressARB((const GLubyte*)#fun)
+// Set when the context comes from EGL, which is then the one to ask for entry points.
+static bool egl_context;
+#define gli_get_proc_address(fun) \
+  (egl_context ? eglGetProcAddress(#fun) : glXGetProcAddressARB((const GLubyte*)#fun))
 #elif defined(GLI_WINDOWS)
 #define gli_get_proc_address(fun) wglGetProcAddress((LPCSTR)#fun)
 #endif
 
 #if defined(GLI_LINUX) || defined (GLI_WINDOWS)
 #define GLI_LOAD_PROC_ADDRESS(fun) do {\
-  fun = (fun##Proc)gli_get_proc_address(fun);\
+  fun = null_backend ? null_##fun : (fun##Proc)gli_get_proc_address(fun);\
   if (!fun){\
     fprintf(stderr, "Failed to load "#fun"\n");\
     return;\
   }\
 } while (false)
+#define GLI_LOAD_CORE_PROC(fun) (gli_##fun = null_backend ? null_##fun : fun)
+#define GLI_LOAD_RENAMED_PROC_ADDRESS(fun) do {\
+  gli_##fun = null_backend ? null_##fun : (fun##Proc)gli_get_proc_address(fun);\
+  if (!gli_##fun){\
+    fprintf(stderr, "Failed to load "#fun"\n");\
+    return;\
+  }\
+} while (false)
 #elif defined(GLI_EMSCRIPTEN)
 #define GLI_LOAD_PROC_ADDRESS(fun) ((void)0)
+#define GLI_LOAD_CORE_PROC(fun) ((void)0)
+#define GLI_LOAD_RENAMED_PROC_ADDRESS(fun) ((void)0)
 #endif
 
 #ifndef _MSC_VER
@@ -1054,6 +7929,7 @@ static LRESULT CALLBACK window_proc(
       }
 
       GLitchWindow* window = ecs_ensure_id(world, ecs_id(Window), ecs_id(Window));
+      acquire_context();
       glViewport(0, 0, window->size.x = LOWORD(long_param), window->size.y = HIWORD(long_param));
       ecs_modified_id(world, ecs_id(Window), ecs_id(Window));
       return 0;
@@ -1067,12 +7943,152 @@ EM_JS(void, set_title, (const char* str), {
 })
 #endif
 
+#ifdef GLI_LINUX
+static bool create_headless_context(GLitchWindow* window) {
+  // Mesa's surfaceless platform needs neither a display server nor a surface. Otherwise, let EGL pick.
+  const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  const PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if (client_extensions && strstr(client_extensions, "EGL_MESA_platform_surfaceless") && eglGetPlatformDisplayEXT) {
+    window->egl_display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if (!window->egl_display) {
+    window->egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  if (!window->egl_display || !eglInitialize(window->egl_display, NULL, NULL)) {
+    fprintf(stderr, "Cannot initialize EGL.\n");
+    return false;
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    fprintf(stderr, "EGL doesn't support desktop OpenGL.\n");
+    return false;
+  }
+
+  const char* extensions = eglQueryString(window->egl_display, EGL_EXTENSIONS);
+  const bool surfaceless = extensions && strstr(extensions, "EGL_KHR_surfaceless_context");
+
+  // We never draw to the surface, only to our framebuffer object, so any color format will do.
+  EGLConfig config;
+  EGLint config_count;
+  if (!eglChooseConfig(
+    window->egl_display,
+    (EGLint[]){
+      EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE,
+    },
+    &config,
+    1,
+    &config_count
+  ) || config_count == 0) {
+    fprintf(stderr, "Failed to retrieve an EGL configuration.\n");
+    return false;
+  }
+
+  window->egl_context = eglCreateContext(
+    window->egl_display,
+    config,
+    EGL_NO_CONTEXT,
+    (EGLint[]){
+      EGL_CONTEXT_MAJOR_VERSION, 3,
+      EGL_CONTEXT_MINOR_VERSION, 3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK,
+      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE,
+    }
+  );
+  if (!window->egl_context) {
+    fprintf(stderr, "Failed to create OpenGL 3.3 context.\n");
+    return false;
+  }
+
+  // Without surfaceless contexts, a tiny pbuffer gives the context something to be current with.
+  window->egl_surface = EGL_NO_SURFACE;
+  if (!surfaceless) {
+    window->egl_surface =
+      eglCreatePbufferSurface(window->egl_display, config, (EGLint[]){ EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE });
+    if (!window->egl_surface) {
+      fprintf(stderr, "Failed to create a pbuffer.\n");
+      return false;
+    }
+  }
+
+  if (!eglMakeCurrent(window->egl_display, window->egl_surface, window->egl_surface, window->egl_context)) {
+    fprintf(stderr, "Failed to make the OpenGL context current.\n");
+    return false;
+  }
+
+  egl_context = true;
+  return true;
+}
+#endif
+
+#ifndef GLI_EMSCRIPTEN
+// Headless windows have nothing to present to, so they render into a framebuffer object of their size instead.
+static void resize_offscreen_framebuffer(GLitchWindow* window) {
+  if (vkm_eq(&window->framebuffer_size, &window->size)) {
+    return;
+  }
+
+  glBindRenderbuffer(GL_RENDERBUFFER, window->color_renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, window->size.x, window->size.y);
+  glBindRenderbuffer(GL_RENDERBUFFER, window->depth_renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window->size.x, window->size.y);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glViewport(0, 0, window->size.x, window->size.y);
+
+  window->framebuffer_size = window->size;
+}
+
+static bool create_offscreen_framebuffer(GLitchWindow* window) {
+  glGenRenderbuffers(1, &window->color_renderbuffer);
+  glGenRenderbuffers(1, &window->depth_renderbuffer);
+  resize_offscreen_framebuffer(window);
+
+  // It stays bound for the lifetime of the window.
+  glGenFramebuffers(1, &window->framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, window->framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, window->color_renderbuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, window->depth_renderbuffer);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "The offscreen framebuffer is incomplete.\n");
+    return false;
+  }
+
+  return true;
+}
+#endif
+
 static void OnSetWindow(ecs_iter_t* it) {
   GLitchWindow* window = ecs_field(it, GLitchWindow, 0);
+  redraw_requested = true;
+  swap_interval_outdated = true;
 
   static const char* default_window_name = "GLitch";
 
-  if (window->context) {
+#ifdef GLI_LINUX
+  const bool initialized = window->context || window->egl_context || null_backend;
+#elif defined(GLI_WINDOWS)
+  const bool initialized = window->context || null_backend;
+#else
+  const bool initialized = window->context;
+#endif
+
+  if (initialized) {
+    acquire_context();
+#ifndef GLI_EMSCRIPTEN
+    if (window->backend == GLI_BACKEND_HEADLESS) {
+      resize_offscreen_framebuffer(window);
+      return;
+    }
+    if (window->backend == GLI_BACKEND_NULL) {
+      return;
+    }
+#endif
+
 #ifdef GLI_LINUX
     XTextProperty text_property;
     if (XStringListToTextProperty(&window->name, 1, &text_property) != 0) {
@@ -1116,215 +8132,225 @@ static void OnSetWindow(ecs_iter_t* it) {
 #endif
   } else {
 #ifdef GLI_LINUX
-    window->display = XOpenDisplay(NULL);
-    if (!window->display) {
-      fprintf(stderr, "Cannot open display.\n");
-      return;
-    }
-
-    // Attributes for the framebuffer configuration
-    static int visual_attribs[] = {
-      GLX_X_RENDERABLE, True,
-      GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT,
-      GLX_RENDER_TYPE, GLX_RGBA_BIT,
-      GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
-      GLX_RED_SIZE, 8,
-      GLX_GREEN_SIZE, 8,
-      GLX_BLUE_SIZE, 8,
-      GLX_ALPHA_SIZE, 8,
-      GLX_DEPTH_SIZE, 24,
-      GLX_STENCIL_SIZE, 0,
-      GLX_DOUBLEBUFFER, True,
-      None
-    };
-
-    int framebuffer_count;
-    GLXFBConfig* framebuffer_config = glXChooseFBConfig(
-      window->display,
-      DefaultScreen(window->display),
-      visual_attribs,
-      &framebuffer_count
-    );
-    if (!framebuffer_config) {
-      fprintf(stderr, "Failed to retrieve a framebuffer configuration.\n");
-      return;
-    }
-    // Pick the first suitable framebuffer configuration.
-    GLXFBConfig best_config = framebuffer_config[0];
-    XFree(framebuffer_config);
+    if (window->backend == GLI_BACKEND_HEADLESS) {
+      if (!create_headless_context(window)) {
+        return;
+      }
+    } else if (window->backend == GLI_BACKEND_WINDOW) {
+      // A RenderThread swaps while the main thread polls events on the same display.
+      XInitThreads();
+      window->display = XOpenDisplay(NULL);
+      if (!window->display) {
+        fprintf(stderr, "Cannot open display.\n");
+        return;
+      }
 
-    // Get visual info from the framebuffer configuration.
-    XVisualInfo* visual_info = glXGetVisualFromFBConfig(window->display, best_config);
-    if (!visual_info) {
-      fprintf(stderr, "No appropriate visual found.\n");
-      return;
-    }
+      // Attributes for the framebuffer configuration
+      static int visual_attribs[] = {
+        GLX_X_RENDERABLE, True,
+        GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT,
+        GLX_RENDER_TYPE, GLX_RGBA_BIT,
+        GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
+        GLX_RED_SIZE, 8,
+        GLX_GREEN_SIZE, 8,
+        GLX_BLUE_SIZE, 8,
+        GLX_ALPHA_SIZE, 8,
+        GLX_DEPTH_SIZE, 24,
+        GLX_STENCIL_SIZE, 0,
+        GLX_DOUBLEBUFFER, True,
+        None
+      };
 
-    const Window root_window = RootWindow(window->display, visual_info->screen);
+      int framebuffer_count;
+      GLXFBConfig* framebuffer_config = glXChooseFBConfig(
+        window->display,
+        DefaultScreen(window->display),
+        visual_attribs,
+        &framebuffer_count
+      );
+      if (!framebuffer_config) {
+        fprintf(stderr, "Failed to retrieve a framebuffer configuration.\n");
+        return;
+      }
+      // Pick the first suitable framebuffer configuration.
+      GLXFBConfig best_config = framebuffer_config[0];
+      XFree(framebuffer_config);
+
+      // Get visual info from the framebuffer configuration.
+      XVisualInfo* visual_info = glXGetVisualFromFBConfig(window->display, best_config);
+      if (!visual_info) {
+        fprintf(stderr, "No appropriate visual found.\n");
+        return;
+      }
 
-    // Create a colormap and set window attributes.
-    XSetWindowAttributes set_window_attributes = {
-      .background_pixmap = None,
-      .event_mask = StructureNotifyMask | ExposureMask | KeyPressMask,
-      .colormap = XCreateColormap(window->display, root_window, visual_info->visual, AllocNone),
-    };
+      const Window root_window = RootWindow(window->display, visual_info->screen);
 
-    window->window = XCreateWindow(
-      window->display,
-      root_window,
-      0,
-      0,
-      window->size.x,
-      window->size.y,
-      0,
-      visual_info->depth,
-      InputOutput,
-      visual_info->visual,
-      CWBorderPixel | CWColormap | CWEventMask,
-      &set_window_attributes
-    );
-    XFree(visual_info);
+      // Create a colormap and set window attributes.
+      XSetWindowAttributes set_window_attributes = {
+        .background_pixmap = None,
+        .event_mask = StructureNotifyMask | ExposureMask | KeyPressMask,
+        .colormap = XCreateColormap(window->display, root_window, visual_info->visual, AllocNone),
+      };
 
-    if (!window->window) {
-      fprintf(stderr, "Failed to create window.\n");
-      return;
-    }
+      window->window = XCreateWindow(
+        window->display,
+        root_window,
+        0,
+        0,
+        window->size.x,
+        window->size.y,
+        0,
+        visual_info->depth,
+        InputOutput,
+        visual_info->visual,
+        CWBorderPixel | CWColormap | CWEventMask,
+        &set_window_attributes
+      );
+      XFree(visual_info);
 
-    window->wm_delete = XInternAtom(window->display, "WM_DELETE_WINDOW", False);
-    XSetWMProtocols(window->display, window->window, &window->wm_delete, 1);
+      if (!window->window) {
+        fprintf(stderr, "Failed to create window.\n");
+        return;
+      }
 
-    XStoreName(window->display, window->window, window->name ? window->name : default_window_name);
-    XMapWindow(window->display, window->window);
+      window->wm_delete = XInternAtom(window->display, "WM_DELETE_WINDOW", False);
+      XSetWMProtocols(window->display, window->window, &window->wm_delete, 1);
 
-    // Get the pointer to glXCreateContextAttribsARB for modern context creation
-    const glXCreateContextAttribsARBProc glXCreateContextAttribsARB =
-      (glXCreateContextAttribsARBProc)glXGetProcAddressARB((const GLubyte*)"glXCreateContextAttribsARB");
+      XStoreName(window->display, window->window, window->name ? window->name : default_window_name);
+      XMapWindow(window->display, window->window);
 
-    if (!glXCreateContextAttribsARB) {
-      fprintf(stderr, "Failed to get the address of glXCreateContextAttribsARB.\n");
-      return;
-    }
+      // Get the pointer to glXCreateContextAttribsARB for modern context creation
+      const glXCreateContextAttribsARBProc glXCreateContextAttribsARB =
+        (glXCreateContextAttribsARBProc)glXGetProcAddressARB((const GLubyte*)"glXCreateContextAttribsARB");
 
-    // Create a OpenGL context version 3.3
-    window->context = glXCreateContextAttribsARB(
-      window->display,
-      best_config,
-      0,
-      True,
-      (int[]){
-        GLX_CONTEXT_MAJOR_VERSION_ARB, 3,
-        GLX_CONTEXT_MINOR_VERSION_ARB, 3,
-        GLX_CONTEXT_PROFILE_MASK_ARB,
-        GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
-        None,
+      if (!glXCreateContextAttribsARB) {
+        fprintf(stderr, "Failed to get the address of glXCreateContextAttribsARB.\n");
+        return;
       }
-    );
-    if (!window->context) {
-      fprintf(stderr, "Failed to create OpenGL 3.3 context.\n");
-      return;
-    }
 
-    // Make the context current
-    glXMakeCurrent(window->display, window->window, window->context);
-#elif defined(GLI_WINDOWS)
-    static const char* class_name = "GLitchWindowClass";
-
-    if (!RegisterClass(
-      &(WNDCLASS){
-        .style = CS_OWNDC,
-        .lpfnWndProc = window_proc,
-        .hInstance = GetModuleHandle(NULL),
-        .hCursor = LoadCursor(NULL, IDC_ARROW),
-        .lpszClassName = class_name,
-      }
-    )) {
-      MessageBox(NULL, "Failed to register window class.", "Error", MB_OK);
-      return;
-    }
+      // Create a OpenGL context version 3.3
+      window->context = glXCreateContextAttribsARB(
+        window->display,
+        best_config,
+        0,
+        True,
+        (int[]){
+          GLX_CONTEXT_MAJOR_VERSION_ARB, 3,
+          GLX_CONTEXT_MINOR_VERSION_ARB, 3,
+          GLX_CONTEXT_PROFILE_MASK_ARB,
+          GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
+          None,
+        }
+      );
+      if (!window->context) {
+        fprintf(stderr, "Failed to create OpenGL 3.3 context.\n");
+        return;
+      }
 
-    window->window_handle = CreateWindowEx(
-      0,
-      class_name,
-      window->name ? window->name : default_window_name,
-      WS_OVERLAPPEDWINDOW | WS_VISIBLE,
-      CW_USEDEFAULT,
-      CW_USEDEFAULT,
-      window->size.x,
-      window->size.y,
-      NULL,
-      NULL,
-      GetModuleHandle(NULL),
-      NULL
-    );
-    if (!window->window_handle) {
-      MessageBox(NULL, "Failed to create window.", "Error", MB_OK);
-      return;
+      // Make the context current
+      glXMakeCurrent(window->display, window->window, window->context);
     }
-    SetWindowLongPtr(window->window_handle, GWLP_USERDATA, (LONG_PTR)it->world);
-
-    window->device_context_handle = GetDC(window->window_handle);
+#elif defined(GLI_WINDOWS)
+    if (window->backend != GLI_BACKEND_NULL) {
+      static const char* class_name = "GLitchWindowClass";
+
+      if (!RegisterClass(
+        &(WNDCLASS){
+          .style = CS_OWNDC,
+          .lpfnWndProc = window_proc,
+          .hInstance = GetModuleHandle(NULL),
+          .hCursor = LoadCursor(NULL, IDC_ARROW),
+          .lpszClassName = class_name,
+        }
+      )) {
+        MessageBox(NULL, "Failed to register window class.", "Error", MB_OK);
+        return;
+      }
 
-    // Set up the pixel format descriptor.
-    const PIXELFORMATDESCRIPTOR pixel_format_descriptor = {
-      .nSize = sizeof(PIXELFORMATDESCRIPTOR),
-      .nVersion = 1,
-      .dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER,
-      .iPixelType = PFD_TYPE_RGBA,
-      .cColorBits = 32,
-      .cDepthBits = 24,
-      .cStencilBits = 0,
-      .iLayerType = PFD_MAIN_PLANE,
-    };
+      window->window_handle = CreateWindowEx(
+        0,
+        class_name,
+        window->name ? window->name : default_window_name,
+        WS_OVERLAPPEDWINDOW | (window->backend == GLI_BACKEND_HEADLESS ? 0 : WS_VISIBLE),
+        CW_USEDEFAULT,
+        CW_USEDEFAULT,
+        window->size.x,
+        window->size.y,
+        NULL,
+        NULL,
+        GetModuleHandle(NULL),
+        NULL
+      );
+      if (!window->window_handle) {
+        MessageBox(NULL, "Failed to create window.", "Error", MB_OK);
+        return;
+      }
+      SetWindowLongPtr(window->window_handle, GWLP_USERDATA, (LONG_PTR)it->world);
+
+      window->device_context_handle = GetDC(window->window_handle);
+
+      // Set up the pixel format descriptor.
+      const PIXELFORMATDESCRIPTOR pixel_format_descriptor = {
+        .nSize = sizeof(PIXELFORMATDESCRIPTOR),
+        .nVersion = 1,
+        .dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER,
+        .iPixelType = PFD_TYPE_RGBA,
+        .cColorBits = 32,
+        .cDepthBits = 24,
+        .cStencilBits = 0,
+        .iLayerType = PFD_MAIN_PLANE,
+      };
 
-    const int pixel_format = ChoosePixelFormat(window->device_context_handle, &pixel_format_descriptor);
-    if (pixel_format == 0) {
-      MessageBox(NULL, "Failed to choose pixel format.", "Error", MB_OK);
-      return;
-    }
+      const int pixel_format = ChoosePixelFormat(window->device_context_handle, &pixel_format_descriptor);
+      if (pixel_format == 0) {
+        MessageBox(NULL, "Failed to choose pixel format.", "Error", MB_OK);
+        return;
+      }
 
-    if (!SetPixelFormat(window->device_context_handle, pixel_format, &pixel_format_descriptor)) {
-      MessageBox(NULL, "Failed to set pixel format.", "Error", MB_OK);
-      return;
-    }
+      if (!SetPixelFormat(window->device_context_handle, pixel_format, &pixel_format_descriptor)) {
+        MessageBox(NULL, "Failed to set pixel format.", "Error", MB_OK);
+        return;
+      }
 
-    const HGLRC dummy_context_handle = wglCreateContext(window->device_context_handle);
-    if (!dummy_context_handle) {
-      MessageBox(NULL, "Failed to create dummy OpenGL context.", "Error", MB_OK);
-      return;
-    }
+      const HGLRC dummy_context_handle = wglCreateContext(window->device_context_handle);
+      if (!dummy_context_handle) {
+        MessageBox(NULL, "Failed to create dummy OpenGL context.", "Error", MB_OK);
+        return;
+      }
 
-    if (!wglMakeCurrent(window->device_context_handle, dummy_context_handle)) {
-      MessageBox(NULL, "Failed to activate dummy OpenGL context.", "Error", MB_OK);
-      return;
-    }
+      if (!wglMakeCurrent(window->device_context_handle, dummy_context_handle)) {
+        MessageBox(NULL, "Failed to activate dummy OpenGL context.", "Error", MB_OK);
+        return;
+      }
 
-    const PFNWGLCREATECONTEXTATTRIBSARBPROC wglCreateContextAttribsARB =
-      (PFNWGLCREATECONTEXTATTRIBSARBPROC)wglGetProcAddress("wglCreateContextAttribsARB");
+      const PFNWGLCREATECONTEXTATTRIBSARBPROC wglCreateContextAttribsARB =
+        (PFNWGLCREATECONTEXTATTRIBSARBPROC)wglGetProcAddress("wglCreateContextAttribsARB");
 
-    if (!wglCreateContextAttribsARB) {
-      MessageBox(NULL, "Failed to get the address of wglCreateContextAttribsARB", "Error", MB_OK);
-      return;
-    }
+      if (!wglCreateContextAttribsARB) {
+        MessageBox(NULL, "Failed to get the address of wglCreateContextAttribsARB", "Error", MB_OK);
+        return;
+      }
 
-    window->context = wglCreateContextAttribsARB(
-      window->device_context_handle,
-      0,
-      (int[]){
-        WGL_CONTEXT_MAJOR_VERSION_ARB, 3,
-        WGL_CONTEXT_MINOR_VERSION_ARB, 3,
-        WGL_CONTEXT_PROFILE_MASK_ARB,
-        WGL_CONTEXT_CORE_PROFILE_BIT_ARB,
+      window->context = wglCreateContextAttribsARB(
+        window->device_context_handle,
         0,
+        (int[]){
+          WGL_CONTEXT_MAJOR_VERSION_ARB, 3,
+          WGL_CONTEXT_MINOR_VERSION_ARB, 3,
+          WGL_CONTEXT_PROFILE_MASK_ARB,
+          WGL_CONTEXT_CORE_PROFILE_BIT_ARB,
+          0,
+        }
+      );
+
+      if (!window->context) {
+        MessageBox(NULL, "Failed to create OpenGL 3.3 context.", "Error", MB_OK);
+        return;
       }
-    );
 
-    if (!window->context) {
-      MessageBox(NULL, "Failed to create OpenGL 3.3 context.", "Error", MB_OK);
-      return;
+      wglMakeCurrent(window->device_context_handle, window->context);
+      wglDeleteContext(dummy_context_handle);
     }
-
-    wglMakeCurrent(window->device_context_handle, window->context);
-    wglDeleteContext(dummy_context_handle);
 #elif defined(GLI_EMSCRIPTEN)
     window->context = emscripten_webgl_create_context(GLI_CANVAS_SELECTOR, &(EmscriptenWebGLContextAttributes){
       .alpha = 0,
@@ -1349,8 +8375,29 @@ static void OnSetWindow(ecs_iter_t* it) {
     set_title(window->name ? window->name : default_window_name);
     emscripten_set_canvas_element_size(GLI_CANVAS_SELECTOR, window->size.x, window->size.y);
     glViewport(0, 0, window->size.x, window->size.y);
+#else
+    null_backend = window->backend == GLI_BACKEND_NULL;
 #endif
 
+    GLI_LOAD_CORE_PROC(glClear);
+    GLI_LOAD_CORE_PROC(glClearColor);
+    GLI_LOAD_CORE_PROC(glViewport);
+    GLI_LOAD_CORE_PROC(glEnable);
+    GLI_LOAD_CORE_PROC(glDisable);
+    GLI_LOAD_CORE_PROC(glDepthMask);
+    GLI_LOAD_CORE_PROC(glDepthFunc);
+    GLI_LOAD_CORE_PROC(glColorMask);
+    GLI_LOAD_CORE_PROC(glDrawArrays);
+    GLI_LOAD_CORE_PROC(glDrawElements);
+    GLI_LOAD_CORE_PROC(glGetIntegerv);
+    GLI_LOAD_CORE_PROC(glReadPixels);
+    GLI_LOAD_CORE_PROC(glGetError);
+    GLI_LOAD_CORE_PROC(glFinish);
+    GLI_LOAD_CORE_PROC(glGenTextures);
+    GLI_LOAD_CORE_PROC(glDeleteTextures);
+    GLI_LOAD_CORE_PROC(glBindTexture);
+    GLI_LOAD_CORE_PROC(glTexParameteri);
+
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
 #ifndef GLI_EMSCRIPTEN
@@ -1371,6 +8418,7 @@ static void OnSetWindow(ecs_iter_t* it) {
     GLI_LOAD_PROC_ADDRESS(glGetProgramInfoLog);
     GLI_LOAD_PROC_ADDRESS(glGetActiveAttrib);
     GLI_LOAD_PROC_ADDRESS(glGetActiveUniform);
+    GLI_LOAD_PROC_ADDRESS(glGetAttachedShaders);
     GLI_LOAD_PROC_ADDRESS(glGetAttribLocation);
     GLI_LOAD_PROC_ADDRESS(glGetUniformLocation);
     GLI_LOAD_PROC_ADDRESS(glGenVertexArrays);
@@ -1384,6 +8432,7 @@ static void OnSetWindow(ecs_iter_t* it) {
     GLI_LOAD_PROC_ADDRESS(glVertexAttribIPointer);
     GLI_LOAD_PROC_ADDRESS(glEnableVertexAttribArray);
     GLI_LOAD_PROC_ADDRESS(glBufferData);
+    GLI_LOAD_PROC_ADDRESS(glBufferSubData);
     GLI_LOAD_PROC_ADDRESS(glUseProgram);
     GLI_LOAD_PROC_ADDRESS(glUniform1fv);
     GLI_LOAD_PROC_ADDRESS(glUniform2fv);
@@ -1398,6 +8447,68 @@ static void OnSetWindow(ecs_iter_t* it) {
     GLI_LOAD_PROC_ADDRESS(glUniform3uiv);
     GLI_LOAD_PROC_ADDRESS(glUniform4uiv);
     GLI_LOAD_PROC_ADDRESS(glUniformMatrix4fv);
+    GLI_LOAD_PROC_ADDRESS(glGenQueries);
+    GLI_LOAD_PROC_ADDRESS(glDeleteQueries);
+    GLI_LOAD_PROC_ADDRESS(glBeginQuery);
+    GLI_LOAD_PROC_ADDRESS(glEndQuery);
+    GLI_LOAD_PROC_ADDRESS(glGetQueryObjectuiv);
+    GLI_LOAD_PROC_ADDRESS(glQueryCounter);
+    GLI_LOAD_PROC_ADDRESS(glGetQueryObjectui64v);
+    GLI_LOAD_PROC_ADDRESS(glBeginConditionalRender);
+    GLI_LOAD_PROC_ADDRESS(glEndConditionalRender);
+    GLI_LOAD_PROC_ADDRESS(glGetStringi);
+    GLI_LOAD_PROC_ADDRESS(glGenFramebuffers);
+    GLI_LOAD_PROC_ADDRESS(glDeleteFramebuffers);
+    GLI_LOAD_PROC_ADDRESS(glBindFramebuffer);
+    GLI_LOAD_PROC_ADDRESS(glCheckFramebufferStatus);
+    GLI_LOAD_PROC_ADDRESS(glFramebufferRenderbuffer);
+    GLI_LOAD_PROC_ADDRESS(glGenRenderbuffers);
+    GLI_LOAD_PROC_ADDRESS(glDeleteRenderbuffers);
+    GLI_LOAD_PROC_ADDRESS(glBindRenderbuffer);
+    GLI_LOAD_PROC_ADDRESS(glRenderbufferStorage);
+    GLI_LOAD_PROC_ADDRESS(glMapBufferRange);
+    GLI_LOAD_PROC_ADDRESS(glUnmapBuffer);
+    GLI_LOAD_PROC_ADDRESS(glFenceSync);
+    GLI_LOAD_PROC_ADDRESS(glClientWaitSync);
+    GLI_LOAD_PROC_ADDRESS(glDeleteSync);
+    GLI_LOAD_PROC_ADDRESS(glGenerateMipmap);
+    GLI_LOAD_RENAMED_PROC_ADDRESS(glTexImage3D);
+    GLI_LOAD_RENAMED_PROC_ADDRESS(glTexSubImage3D);
+    GLI_LOAD_RENAMED_PROC_ADDRESS(glCompressedTexImage3D);
+
+#ifndef GLI_EMSCRIPTEN
+    if (window->backend == GLI_BACKEND_HEADLESS && !create_offscreen_framebuffer(window)) {
+      return;
+    }
+#endif
+
+    parallel_shader_compile =
+      has_extension("GL_KHR_parallel_shader_compile") || has_extension("GL_ARB_parallel_shader_compile");
+    // Desktop drivers name the extensions one way, browsers another. RGBA8 is everywhere.
+    texture_families_supported[GLI_TEXTURE_UNCOMPRESSED] = true;
+    texture_families_supported[GLI_TEXTURE_S3TC] =
+      has_extension("GL_EXT_texture_compression_s3tc") || has_extension("GL_WEBGL_compressed_texture_s3tc");
+    texture_families_supported[GLI_TEXTURE_S3TC_SRGB] = texture_families_supported[GLI_TEXTURE_S3TC] &&
+      (has_extension("GL_EXT_texture_sRGB") || has_extension("GL_WEBGL_compressed_texture_s3tc_srgb"));
+    texture_families_supported[GLI_TEXTURE_BPTC] =
+      has_extension("GL_ARB_texture_compression_bptc") || has_extension("GL_EXT_texture_compression_bptc");
+    texture_families_supported[GLI_TEXTURE_ETC2] =
+      has_extension("GL_ARB_ES3_compatibility") || has_extension("GL_WEBGL_compressed_texture_etc");
+#ifndef GLI_EMSCRIPTEN
+    if (parallel_shader_compile) {
+      // Both extensions share the entry point, just with a different suffix.
+      glMaxShaderCompilerThreadsKHR =
+        (glMaxShaderCompilerThreadsKHRProc)gli_get_proc_address(glMaxShaderCompilerThreadsKHR);
+      if (!glMaxShaderCompilerThreadsKHR) {
+        glMaxShaderCompilerThreadsKHR =
+          (glMaxShaderCompilerThreadsKHRProc)gli_get_proc_address(glMaxShaderCompilerThreadsARB);
+      }
+      if (glMaxShaderCompilerThreadsKHR) {
+        // Let the driver decide.
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+      }
+    }
+#endif
 
     glGenBuffers(1, &built_ins_uniform_buffer);
     glBindBuffer(GL_UNIFORM_BUFFER, built_ins_uniform_buffer);
@@ -1410,7 +8521,39 @@ static void OnSetWindow(ecs_iter_t* it) {
 
 static void OnRemoveWindow(ecs_iter_t* it) {
   const GLitchWindow* window = ecs_field(it, GLitchWindow, 0);
+  stop_render_thread();
+  free_frame_commands();
+  image_upload_buffer = 0;
+#ifndef GLI_EMSCRIPTEN
+  if (window->framebuffer) {
+    glDeleteFramebuffers(1, &window->framebuffer);
+    glDeleteRenderbuffers(1, &window->color_renderbuffer);
+    glDeleteRenderbuffers(1, &window->depth_renderbuffer);
+  }
+#endif
+
+#ifndef GLI_EMSCRIPTEN
+  if (null_backend) {
+    null_reset();
+    null_backend = false;
+    return;
+  }
+#endif
+
 #ifdef GLI_LINUX
+  if (window->egl_display) {
+    eglMakeCurrent(window->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (window->egl_context) {
+      eglDestroyContext(window->egl_display, window->egl_context);
+    }
+    if (window->egl_surface) {
+      eglDestroySurface(window->egl_display, window->egl_surface);
+    }
+    eglTerminate(window->egl_display);
+    egl_context = false;
+    return;
+  }
+
   glXMakeCurrent(window->display, None, NULL);
   glXDestroyContext(window->display, window->context);
   XDestroyWindow(window->display, window->window);
@@ -1444,8 +8587,66 @@ void glitchImport(ecs_world_t* world) {
   });
   ECS_COMPONENT_DEFINE(world, MeshData);
   ECS_COMPONENT_DEFINE(world, Mesh);
+  ECS_COMPONENT_DEFINE(world, ModelFile);
+  ecs_add_pair(world, ecs_id(ModelFile), EcsOnInstantiate, EcsDontInherit);
+  ECS_COMPONENT_DEFINE(world, MeshFile);
+  ecs_add_pair(world, ecs_id(MeshFile), EcsOnInstantiate, EcsDontInherit);
+  ECS_COMPONENT_DEFINE(world, DynamicMesh);
+  ecs_add_pair(world, ecs_id(DynamicMesh), EcsOnInstantiate, EcsDontInherit);
   ECS_COMPONENT_DEFINE(world, ShaderProgramSource);
   ECS_COMPONENT_DEFINE(world, ShaderProgram);
+  ECS_COMPONENT_DEFINE(world, TextureAtlas);
+  ecs_struct(world, {
+    .entity = ecs_id(TextureAtlas),
+    .members = {
+      { .name = "size", .type = ecs_id(vkm_ivec2), .offset = offsetof(TextureAtlas, size) },
+      { .name = "layers", .type = ecs_id(ecs_i32_t), .offset = offsetof(TextureAtlas, layers) },
+      { .name = "texture", .type = ecs_id(ecs_u32_t), .offset = offsetof(TextureAtlas, texture) },
+      { .name = "layer", .type = ecs_id(ecs_i32_t), .offset = offsetof(TextureAtlas, layer) },
+      { .name = "shelf_x", .type = ecs_id(ecs_i32_t), .offset = offsetof(TextureAtlas, shelf_x) },
+      { .name = "shelf_y", .type = ecs_id(ecs_i32_t), .offset = offsetof(TextureAtlas, shelf_y) },
+      { .name = "shelf_height", .type = ecs_id(ecs_i32_t), .offset = offsetof(TextureAtlas, shelf_height) },
+    },
+  });
+  // Instances of a loaded TextureFile would copy its texture, and delete it along with themselves.
+  ecs_add_pair(world, ecs_id(TextureAtlas), EcsOnInstantiate, EcsDontInherit);
+  ECS_COMPONENT_DEFINE(world, ImageData);
+  // Instances would copy the pixels, which only the image itself needs until they're uploaded.
+  ecs_add_pair(world, ecs_id(ImageData), EcsOnInstantiate, EcsDontInherit);
+  ECS_COMPONENT_DEFINE(world, TextureRegion);
+  ecs_add_pair(world, ecs_id(TextureRegion), EcsIsA, ecs_id(vkm_vec4));
+  ecs_add_pair(world, ecs_id(TextureRegion), EcsOnInstantiate, EcsInherit);
+  ECS_COMPONENT_DEFINE(world, TextureLayer);
+  ecs_primitive(world, { .entity = ecs_id(TextureLayer), .kind = EcsF32 });
+  ecs_add_pair(world, ecs_id(TextureLayer), EcsOnInstantiate, EcsInherit);
+  ECS_COMPONENT_DEFINE(world, TextureFile);
+  ecs_add_pair(world, ecs_id(TextureFile), EcsOnInstantiate, EcsDontInherit);
+  ECS_COMPONENT_DEFINE(world, TextureStreaming);
+  ecs_struct(world, {
+    .entity = ecs_id(TextureStreaming),
+    .members = {
+      { .name = "budget", .type = ecs_id(ecs_i64_t), .offset = offsetof(TextureStreaming, budget), .unit = EcsBytes },
+      { .name = "textures", .type = ecs_id(ecs_i32_t), .offset = offsetof(TextureStreaming, textures) },
+      {
+        .name = "resident_bytes",
+        .type = ecs_id(ecs_i64_t),
+        .offset = offsetof(TextureStreaming, resident_bytes),
+        .unit = EcsBytes,
+      },
+      {
+        .name = "wanted_bytes",
+        .type = ecs_id(ecs_i64_t),
+        .offset = offsetof(TextureStreaming, wanted_bytes),
+        .unit = EcsBytes,
+      },
+      { .name = "bias", .type = ecs_id(ecs_i32_t), .offset = offsetof(TextureStreaming, bias) },
+      { .name = "pending_levels", .type = ecs_id(ecs_i32_t), .offset = offsetof(TextureStreaming, pending_levels) },
+      { .name = "loaded_levels", .type = ecs_id(ecs_i32_t), .offset = offsetof(TextureStreaming, loaded_levels) },
+      { .name = "evicted_levels", .type = ecs_id(ecs_i32_t), .offset = offsetof(TextureStreaming, evicted_levels) },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, StreamedTexture);
+  ecs_add_pair(world, ecs_id(StreamedTexture), EcsOnInstantiate, EcsDontInherit);
   ECS_COMPONENT_DEFINE(world, Camera2D);
   ecs_add_pair(world, ecs_id(Camera2D), EcsWith, ecs_id(Position2D));
   ecs_struct(world, {
@@ -1505,8 +8706,247 @@ void glitchImport(ecs_world_t* world) {
   ecs_add_pair(world, ecs_id(Color), EcsIsA, ecs_id(vkm_vec4));
   ECS_COMPONENT_DEFINE(world, ClearColor);
   ecs_add_pair(world, ecs_id(ClearColor), EcsIsA, ecs_id(Color));
+  ECS_COMPONENT_DEFINE(world, LevelOfDetail);
+  ecs_struct(world, {
+    .entity = ecs_id(LevelOfDetail),
+    .members = {
+      {
+        .name = "max_screen_error",
+        .type = ecs_id(ecs_f32_t),
+        .offset = offsetof(LevelOfDetail, max_screen_error),
+      },
+      {
+        .name = "level",
+        .type = ecs_id(ecs_u8_t),
+        .offset = offsetof(LevelOfDetail, level),
+      },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, OcclusionCulling);
+  ecs_struct(world, {
+    .entity = ecs_id(OcclusionCulling),
+    .members = {
+      {
+        .name = "tested",
+        .type = ecs_id(ecs_i32_t),
+        .offset = offsetof(OcclusionCulling, tested),
+      },
+      {
+        .name = "culled",
+        .type = ecs_id(ecs_i32_t),
+        .offset = offsetof(OcclusionCulling, culled),
+      },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, OcclusionQuery);
+  ecs_struct(world, {
+    .entity = ecs_id(OcclusionQuery),
+    .members = {
+      {
+        .name = "query",
+        .type = ecs_id(ecs_u32_t),
+        .offset = offsetof(OcclusionQuery, query),
+      },
+      {
+        .name = "pending",
+        .type = ecs_id(ecs_bool_t),
+        .offset = offsetof(OcclusionQuery, pending),
+      },
+      {
+        .name = "visible",
+        .type = ecs_id(ecs_bool_t),
+        .offset = offsetof(OcclusionQuery, visible),
+      },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, OccluderGeometry);
+  ECS_COMPONENT_DEFINE(world, SoftwareOcclusion);
+  ecs_struct(world, {
+    .entity = ecs_id(SoftwareOcclusion),
+    .members = {
+      {
+        .name = "width",
+        .type = ecs_id(ecs_i32_t),
+        .offset = offsetof(SoftwareOcclusion, width),
+      },
+      {
+        .name = "occluder_triangles",
+        .type = ecs_id(ecs_i32_t),
+        .offset = offsetof(SoftwareOcclusion, occluder_triangles),
+      },
+      {
+        .name = "tested",
+        .type = ecs_id(ecs_i32_t),
+        .offset = offsetof(SoftwareOcclusion, tested),
+      },
+      {
+        .name = "culled",
+        .type = ecs_id(ecs_i32_t),
+        .offset = offsetof(SoftwareOcclusion, culled),
+      },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, OcclusionBand);
+  ECS_COMPONENT_DEFINE(world, CaptureBand);
+  ECS_COMPONENT_DEFINE(world, FrameCapture);
+  ECS_COMPONENT_DEFINE(world, GpuFrameTime);
+  ecs_struct(world, {
+    .entity = ecs_id(GpuFrameTime),
+    .members = {
+      {
+        .name = "clear",
+        .type = ecs_id(ecs_f32_t),
+        .offset = offsetof(GpuFrameTime, clear),
+        .unit = EcsMilliSeconds,
+      },
+      {
+        .name = "frame",
+        .type = ecs_id(ecs_f32_t),
+        .offset = offsetof(GpuFrameTime, frame),
+        .unit = EcsMilliSeconds,
+      },
+      {
+        .name = "clear_queries",
+        .type = ecs_id(ecs_u32_t),
+        .count = GLI_GPU_TIMER_FRAMES,
+        .offset = offsetof(GpuFrameTime, clear_queries),
+      },
+      {
+        .name = "start_queries",
+        .type = ecs_id(ecs_u32_t),
+        .count = GLI_GPU_TIMER_FRAMES,
+        .offset = offsetof(GpuFrameTime, start_queries),
+      },
+      {
+        .name = "end_queries",
+        .type = ecs_id(ecs_u32_t),
+        .count = GLI_GPU_TIMER_FRAMES,
+        .offset = offsetof(GpuFrameTime, end_queries),
+      },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, RenderStats);
+  render_stats_struct(world, ecs_id(RenderStats));
+  ECS_COMPONENT_DEFINE(world, ShaderProgramStats);
+  render_stats_struct(world, ecs_id(ShaderProgramStats));
+  ECS_COMPONENT_DEFINE(world, FramePacing);
+  ecs_struct(world, {
+    .entity = ecs_id(FramePacing),
+    .members = {
+      { .name = "target_fps", .type = ecs_id(ecs_f32_t), .offset = offsetof(FramePacing, target_fps) },
+      { .name = "swap_interval", .type = ecs_id(ecs_i32_t), .offset = offsetof(FramePacing, swap_interval) },
+      { .name = "finish", .type = ecs_id(ecs_bool_t), .offset = offsetof(FramePacing, finish) },
+      {
+        .name = "predicted_cost",
+        .type = ecs_id(ecs_f32_t),
+        .offset = offsetof(FramePacing, predicted_cost),
+        .unit = EcsMilliSeconds,
+      },
+      {
+        .name = "frame_time",
+        .type = ecs_id(ecs_f32_t),
+        .offset = offsetof(FramePacing, frame_time),
+        .unit = EcsMilliSeconds,
+      },
+      {
+        .name = "frame_time_variance",
+        .type = ecs_id(ecs_f32_t),
+        .offset = offsetof(FramePacing, frame_time_variance),
+      },
+      { .name = "missed", .type = ecs_id(ecs_i64_t), .offset = offsetof(FramePacing, missed) },
+      {
+        .name = "costs",
+        .type = ecs_id(ecs_i64_t),
+        .count = GLI_PACING_FRAMES,
+        .offset = offsetof(FramePacing, costs),
+      },
+      {
+        .name = "frame_times",
+        .type = ecs_id(ecs_i64_t),
+        .count = GLI_PACING_FRAMES,
+        .offset = offsetof(FramePacing, frame_times),
+      },
+      { .name = "frames", .type = ecs_id(ecs_i64_t), .offset = offsetof(FramePacing, frames) },
+      { .name = "frame_start", .type = ecs_id(ecs_i64_t), .offset = offsetof(FramePacing, frame_start) },
+      { .name = "last_frame_end", .type = ecs_id(ecs_i64_t), .offset = offsetof(FramePacing, last_frame_end) },
+      { .name = "deadline", .type = ecs_id(ecs_i64_t), .offset = offsetof(FramePacing, deadline) },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, RenderThread);
+  ecs_struct(world, {
+    .entity = ecs_id(RenderThread),
+    .members = {
+      { .name = "wait", .type = ecs_id(ecs_f32_t), .offset = offsetof(RenderThread, wait), .unit = EcsMilliSeconds },
+      { .name = "draw", .type = ecs_id(ecs_f32_t), .offset = offsetof(RenderThread, draw), .unit = EcsMilliSeconds },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, CommandStream);
+  ecs_struct(world, {
+    .entity = ecs_id(CommandStream),
+    .members = {
+      { .name = "replays", .type = ecs_id(ecs_i32_t), .offset = offsetof(CommandStream, replays) },
+      { .name = "commands", .type = ecs_id(ecs_i64_t), .offset = offsetof(CommandStream, commands) },
+      { .name = "bytes", .type = ecs_id(ecs_i64_t), .offset = offsetof(CommandStream, bytes), .unit = EcsBytes },
+      {
+        .name = "execute",
+        .type = ecs_id(ecs_f32_t),
+        .offset = offsetof(CommandStream, execute),
+        .unit = EcsMilliSeconds,
+      },
+      { .name = "uniform_calls", .type = ecs_id(ecs_i32_t), .offset = offsetof(CommandStream, uniform_calls) },
+      {
+        .name = "skipped_uniform_calls",
+        .type = ecs_id(ecs_i32_t),
+        .offset = offsetof(CommandStream, skipped_uniform_calls),
+      },
+      { .name = "texture_binds", .type = ecs_id(ecs_i32_t), .offset = offsetof(CommandStream, texture_binds) },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, RenderOnDemand);
+  ecs_struct(world, {
+    .entity = ecs_id(RenderOnDemand),
+    .members = {
+      {
+        .name = "max_wait",
+        .type = ecs_id(ecs_i32_t),
+        .offset = offsetof(RenderOnDemand, max_wait),
+        .unit = EcsMilliSeconds,
+      },
+      { .name = "redraw", .type = ecs_id(ecs_bool_t), .offset = offsetof(RenderOnDemand, redraw) },
+      { .name = "drawn", .type = ecs_id(ecs_i64_t), .offset = offsetof(RenderOnDemand, drawn) },
+      { .name = "skipped", .type = ecs_id(ecs_i64_t), .offset = offsetof(RenderOnDemand, skipped) },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, NullBackendStats);
+  ecs_struct(world, {
+    .entity = ecs_id(NullBackendStats),
+    .members = {
+      { .name = "calls", .type = ecs_id(ecs_i32_t), .offset = offsetof(NullBackendStats, calls) },
+      { .name = "draw_calls", .type = ecs_id(ecs_i32_t), .offset = offsetof(NullBackendStats, draw_calls) },
+      { .name = "objects", .type = ecs_id(ecs_i32_t), .offset = offsetof(NullBackendStats, objects) },
+    },
+  });
+  ECS_COMPONENT_DEFINE(world, GpuTime);
+  ecs_struct(world, {
+    .entity = ecs_id(GpuTime),
+    .members = {
+      {
+        .name = "milliseconds",
+        .type = ecs_id(ecs_f32_t),
+        .offset = offsetof(GpuTime, milliseconds),
+        .unit = EcsMilliSeconds,
+      },
+      {
+        .name = "queries",
+        .type = ecs_id(ecs_u32_t),
+        .count = GLI_GPU_TIMER_FRAMES,
+        .offset = offsetof(GpuTime, queries),
+      },
+    },
+  });
 
   ECS_TAG_DEFINE(world, Uses);
+  ECS_TAG_DEFINE(world, Occluder);
 
 #define GLI_SET_HOOKS(component) ecs_set_hooks(\
   world,\
@@ -1526,17 +8966,78 @@ void glitchImport(ecs_world_t* world) {
   });
   GLI_SET_HOOKS(MeshData);
   GLI_SET_HOOKS(Mesh);
+  GLI_SET_HOOKS(ModelFile);
+  GLI_SET_HOOKS(MeshFile);
+  GLI_SET_HOOKS(DynamicMesh);
+  GLI_SET_HOOKS(TextureAtlas);
+  GLI_SET_HOOKS(ImageData);
+  GLI_SET_HOOKS(TextureFile);
+  GLI_SET_HOOKS(StreamedTexture);
   GLI_SET_HOOKS(ShaderProgramSource);
   GLI_SET_HOOKS(ShaderProgram);
+  GLI_SET_HOOKS(OcclusionQuery);
+  GLI_SET_HOOKS(OccluderGeometry);
+  GLI_SET_HOOKS(GpuFrameTime);
+  GLI_SET_HOOKS(GpuTime);
+  ecs_set_hooks(world, FrameCapture, {
+    .ctor = ecs_ctor(FrameCapture),
+    .copy = ecs_copy(FrameCapture),
+    .move = ecs_move(FrameCapture),
+    .dtor = ecs_dtor(FrameCapture),
+  });
   ecs_set_hooks(world, Camera2D, { .ctor = ecs_ctor(Camera2D) });
   ecs_set_hooks(world, Camera3D, { .ctor = ecs_ctor(Camera3D) });
   ecs_set_hooks(world, Color, { .ctor = ecs_ctor(Color) });
   ecs_set_hooks(world, ClearColor, { .ctor = ecs_ctor(ClearColor) });
+  ecs_set_hooks(world, LevelOfDetail, { .ctor = ecs_ctor(LevelOfDetail) });
 
   ECS_OBSERVER(world, OnSetWindow, EcsOnSet, [inout] Window($));
   ECS_OBSERVER(world, OnRemoveWindow, EcsOnRemove, [in] Window($));
+  ECS_OBSERVER(world, OnSetShaderProgramSource, EcsOnSet, [in] ShaderProgramSource);
+  ECS_OBSERVER(world, OnRemoveRenderStats, EcsOnRemove, [none] RenderStats($));
+  ECS_OBSERVER(world, OnRemoveGpuFrameTime, EcsOnRemove, [none] GpuFrameTime($));
+  ECS_OBSERVER(world, OnAddSoftwareOcclusion, EcsOnAdd, [none] SoftwareOcclusion($));
+  ECS_OBSERVER(world, OnRemoveSoftwareOcclusion, EcsOnRemove, [none] SoftwareOcclusion($));
+  ECS_OBSERVER(world, OnAddFrameCapture, EcsOnAdd, [none] FrameCapture($));
+  ECS_OBSERVER(world, OnRemoveFrameCapture, EcsOnRemove, [none] FrameCapture($));
+  ECS_OBSERVER(world, OnAddRenderOnDemand, EcsOnAdd, [none] RenderOnDemand($));
+  ECS_OBSERVER(world, OnRemoveRenderOnDemand, EcsOnRemove, [none] RenderOnDemand($));
+  ECS_OBSERVER(world, OnAddTextureStreaming, EcsOnAdd, [none] TextureStreaming($));
+  ECS_OBSERVER(world, OnRemoveTextureStreaming, EcsOnRemove, [none] TextureStreaming($));
+  ECS_OBSERVER(world, OnSetFramePacing, EcsOnSet, [none] FramePacing($));
+#ifndef GLI_EMSCRIPTEN
+  ECS_OBSERVER(world, OnAddRenderThread, EcsOnAdd, [none] RenderThread($));
+  ECS_OBSERVER(world, OnRemoveRenderThread, EcsOnRemove, [none] RenderThread($));
+#endif
+#ifdef GLI_LINUX
+  ECS_OBSERVER(world, OnRemoveShaderProgramSource, EcsOnRemove, [none] ShaderProgramSource);
+#endif
 
+#ifndef GLI_EMSCRIPTEN
+  // Before every other system, so that the frame starts as late as it can.
+  ECS_SYSTEM(world, PaceFrame, EcsOnLoad, [inout] FramePacing(FramePacing), [in] Window($));
+#endif
+#ifdef GLI_LINUX
+  // After PaceFrame, to see the changes made to the files while it waited.
+  ecs_system(world, {
+    .entity = ecs_entity(world, {
+      .name = "WatchShaderFiles",
+      .add = ecs_ids(ecs_dependson(EcsOnLoad)),
+    }),
+    .callback = WatchShaderFiles,
+  });
+#endif
+  // Before MakeMeshes, which makes the meshes of the file in the same frame, as the write lets the pipeline know.
+  ECS_SYSTEM(world, LoadModelFiles, EcsOnLoad, [in] ModelFile, [out] MeshData());
   ECS_SYSTEM(world, MakeMeshes, EcsOnLoad, [in] MeshData, [out] !Mesh);
+  ECS_SYSTEM(world, LoadMeshFiles, EcsOnLoad, [in] MeshFile, [out] !Mesh);
+  ECS_SYSTEM(world, MakeDynamicMeshes, EcsOnLoad, [inout] DynamicMesh, [out] !Mesh);
+  ECS_SYSTEM(world, UploadImages, EcsOnLoad, [in] ImageData, [none] (Uses, $atlas), [inout] TextureAtlas($atlas));
+  ECS_SYSTEM(world, LoadTextureFiles, EcsOnLoad,
+    [in] TextureFile,
+    [out] !TextureAtlas,
+    [none] ?TextureStreaming(TextureStreaming),
+  );
   ecs_system(world, {
     .entity = ecs_entity(world, {
       .name = "CompileShaders",
@@ -1546,6 +9047,28 @@ void glitchImport(ecs_world_t* world) {
     .callback = CompileShaders,
     .immediate = true,
   });
+  ecs_system(world, {
+    .entity = ecs_entity(world, {
+      .name = "FinishShaderReloads",
+      .add = ecs_ids(ecs_dependson(EcsOnLoad)),
+    }),
+    .query.expr = "[inout] ShaderProgram",
+    .callback = FinishShaderReloads,
+    .immediate = true,
+  });
+  // Before CheckForChanges, which must know about the uploads.
+  ECS_SYSTEM(world, UpdateDynamicMeshes, EcsPreStore, [inout] DynamicMesh, [inout] Mesh);
+  // Before every other system of the phase, which skip the frame if nothing changed.
+  ECS_SYSTEM(world, CheckForChanges, EcsPreStore,
+    [inout] RenderOnDemand(RenderOnDemand),
+    [in] Window($),
+    [in] ?ClearColor(ClearColor),
+    [in] ?Camera2D(Camera2D),
+    [in] ?cvkm.Position2D(Camera2D),
+    [in] ?Camera3D(Camera3D),
+    [in] ?cvkm.Position3D(Camera3D),
+    [in] ?cvkm.Rotation3D(Camera3D),
+  );
   ECS_SYSTEM(world, PreRenderFrame, EcsPreStore,
     [in] ?ClearColor(ClearColor),
     [inout] ?Camera2D($),
@@ -1554,14 +9077,130 @@ void glitchImport(ecs_world_t* world) {
     [in] ?cvkm.Position3D(Camera3D),
     [in] ?cvkm.Rotation3D(Camera3D),
     [inout] Window($),
+    [out] ?OcclusionCulling(OcclusionCulling),
+    [inout] ?SoftwareOcclusion(SoftwareOcclusion),
+    [inout] ?GpuFrameTime(GpuFrameTime),
   );
-  ECS_SYSTEM(world, Render, EcsOnStore,
-    [in] ShaderProgram,
-    [in] ?Camera2D(Camera2D),
-    [in] ?Camera3D(Camera3D),
+  ECS_SYSTEM(world, SelectLevelsOfDetail, EcsPreStore,
+    [inout] LevelOfDetail,
+    [in] cvkm.Position3D,
+    [in] ?cvkm.Scale3D,
+    [none] (Uses, $mesh),
+    [in] Mesh($mesh),
+    [in] Camera3D(Camera3D),
+    [in] cvkm.Position3D(Camera3D),
+    [in] Window($),
+  );
+  ECS_SYSTEM(world, MeasureStreamedTextures2D, EcsPreStore,
+    [none] TextureStreaming(TextureStreaming),
+    [none] cvkm.Position2D,
+    [in] ?cvkm.Scale2D,
+    [in] TextureRegion,
+    [none] (IsA, $texture),
+    [inout] StreamedTexture($texture),
+    [in] Camera2D(Camera2D),
+  );
+  ECS_SYSTEM(world, MeasureStreamedTextures3D, EcsPreStore,
+    [none] TextureStreaming(TextureStreaming),
+    [in] cvkm.Position3D,
+    [in] ?cvkm.Scale3D,
+    [in] TextureRegion,
+    [none] (IsA, $texture),
+    [inout] StreamedTexture($texture),
+    [in] Camera3D(Camera3D),
+    [in] cvkm.Position3D(Camera3D),
+    [in] Window($),
+  );
+  ECS_SYSTEM(world, StreamTextures, EcsPreStore, [inout] TextureStreaming(TextureStreaming));
+  ECS_SYSTEM(world, TransformOccluders, EcsPreStore,
+    [in] cvkm.Position3D,
+    [in] ?cvkm.Rotation3D,
+    [in] ?cvkm.Scale3D,
+    [none] (Uses, $mesh),
+    [in] OccluderGeometry($mesh),
+    [in] Camera3D(Camera3D),
+    [inout] SoftwareOcclusion(SoftwareOcclusion),
+  );
+  ecs_system(world, {
+    .entity = ecs_entity(world, { .name = "RasterizeOccluders", .add = ecs_ids(ecs_dependson(EcsPreStore)) }),
+    .query.expr = "[in] OcclusionBand, [none] SoftwareOcclusion(SoftwareOcclusion)",
+    .callback = RasterizeOccluders,
+    .multi_threaded = true,
+  });
+  ECS_SYSTEM(world, BuildHierarchicalDepth, EcsPreStore, [none] SoftwareOcclusion(SoftwareOcclusion));
+  ECS_SYSTEM(world, AddShaderProgramStats, EcsOnLoad,
+    [none] ShaderProgram,
+    [none] RenderStats(RenderStats),
+    [out] !ShaderProgramStats,
+  );
+  ECS_SYSTEM(world, AddGpuTimes, EcsOnLoad,
+    [none] ShaderProgram,
+    [none] GpuFrameTime(GpuFrameTime),
+    [out] !GpuTime,
+  );
+#ifndef GLI_EMSCRIPTEN
+  ECS_SYSTEM(world, ReadGpuTimes, EcsPreStore, [inout] GpuTime);
+#endif
+  ECS_SYSTEM(world, AddOcclusionQueries, EcsOnLoad,
+    [none] cvkm.Position3D,
+    [none] (Uses, $mesh),
+    [none] Mesh($mesh),
+    [none] OcclusionCulling(OcclusionCulling),
+    [out] !OcclusionQuery,
+  );
+  ECS_SYSTEM(world, ReadOcclusionQueries, EcsPreStore,
+    [inout] OcclusionQuery,
+    [none] OcclusionCulling(OcclusionCulling),
+  );
+  // Each worker thread records its share of the programs.
+  ecs_system(world, {
+    .entity = ecs_entity(world, { .name = "Render", .add = ecs_ids(ecs_dependson(EcsOnStore)) }),
+    .query.expr = "[in] ShaderProgram, [in] ?Camera2D(Camera2D), [in] ?Camera3D(Camera3D), [in] Window($), "
+      "[in] ?OcclusionCulling(OcclusionCulling), [in] ?SoftwareOcclusion(SoftwareOcclusion), [in] ?GpuTime, "
+      "[out] ?ShaderProgramStats",
+    .callback = Render,
+    .multi_threaded = true,
+  });
+  ECS_SYSTEM(world, ExecuteCommands, EcsOnStore,
+    [inout] ?CommandStream(CommandStream),
+    [in] Window($),
+    [inout] ?OcclusionCulling(OcclusionCulling),
+    [inout] ?SoftwareOcclusion(SoftwareOcclusion),
+  );
+  ECS_SYSTEM(world, IssueOcclusionQueries, EcsOnStore,
+    [inout] OcclusionQuery,
+    [in] cvkm.Position3D,
+    [in] ?cvkm.Rotation3D,
+    [in] ?cvkm.Scale3D,
+    [none] (Uses, $mesh),
+    [in] Mesh($mesh),
+    [in] Camera3D(Camera3D),
+    [in] cvkm.Position3D(Camera3D),
+    [inout] OcclusionCulling(OcclusionCulling),
     [in] Window($),
   );
-  ECS_SYSTEM(world, PostRenderFrame, EcsPostFrame, [in] Window($));
+#ifndef GLI_EMSCRIPTEN
+  ECS_SYSTEM(world, ReadFrameCapture, EcsPreStore, [inout] FrameCapture(FrameCapture));
+  ecs_system(world, {
+    .entity = ecs_entity(world, { .name = "ConvertFrameCapture", .add = ecs_ids(ecs_dependson(EcsPreStore)) }),
+    .query.expr = "[in] CaptureBand, [inout] FrameCapture(FrameCapture)",
+    .callback = ConvertFrameCapture,
+    .multi_threaded = true,
+  });
+  ECS_SYSTEM(world, DeliverFrameCapture, EcsPreStore, [inout] FrameCapture(FrameCapture));
+  ECS_SYSTEM(world, IssueFrameCapture, EcsOnStore, [inout] FrameCapture(FrameCapture), [in] Window($));
+#endif
+  ECS_SYSTEM(world, PostRenderFrame, EcsPostFrame,
+    [in] Window($),
+    [inout] ?GpuFrameTime(GpuFrameTime),
+    [out] ?RenderStats(RenderStats),
+    [out] ?NullBackendStats(NullBackendStats),
+    [out] ?RenderThread(RenderThread),
+  );
+#ifndef GLI_EMSCRIPTEN
+  ECS_SYSTEM(world, FinishFramePacing, EcsPostFrame, [inout] FramePacing(FramePacing));
+#endif
+  ECS_SYSTEM(world, WaitForChanges, EcsPostFrame, [in] RenderOnDemand(RenderOnDemand), [in] Window($));
 
   ecs_singleton_add(world, ClearColor);
   ecs_singleton_add(world, Camera2D);
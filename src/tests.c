@@ -133,8 +133,6 @@ int main(const int argc, char** argv) {
     0.5f,
     0.0f,
   };
-  void* triangle_mesh_buffer = malloc(sizeof(triangle_vertices));
-  memcpy(triangle_mesh_buffer, triangle_vertices, sizeof(triangle_vertices));
 
   static const float square_vertices[] = {
     // Position
@@ -153,8 +151,6 @@ int main(const int argc, char** argv) {
     0.2f,
     0.0f,
   };
-  void* square_mesh_buffer = malloc(sizeof(square_vertices));
-  memcpy(square_mesh_buffer, square_vertices, sizeof(square_vertices));
 
   static const float cube_vertices[] = {
     // Position
@@ -233,7 +229,7 @@ int main(const int argc, char** argv) {
     0.0f, 0.0f, 0.1f, 1.0f,
     0.0f, 0.0f, 0.1f, 1.0f,
   };
-  static unsigned cube_indices[] = {
+  static const unsigned cube_indices[] = {
      0,  1,  2,
      2,  3,  0,
     
@@ -252,19 +248,17 @@ int main(const int argc, char** argv) {
     20, 21, 22,
     20, 22, 23,
   };
-  void* cube_mesh_buffer = malloc(sizeof(cube_vertices));
-  memcpy(cube_mesh_buffer, cube_vertices, sizeof(cube_vertices));
-  void* cube_indices_buffer = malloc(sizeof(cube_indices));
-  memcpy(cube_indices_buffer, cube_indices, sizeof(cube_indices));
   
+  // The meshes borrow those arrays instead of copying them.
   const ecs_entity_t triangle_mesh = ecs_entity(world, {
     .set = ecs_values(
       {
         .type = ecs_id(MeshData),
         .ptr = &(MeshData) {
-          .data = triangle_mesh_buffer,
+          .data = triangle_vertices,
           .vertices_count = 3,
           .primitive = GLI_TRIANGLES,
+          .release = gli_keep_mesh_data,
           .vertex_attributes = {
             { .type = GLI_VEC2 },
             { .type = GLI_FLOAT },
@@ -279,9 +273,10 @@ int main(const int argc, char** argv) {
       {
         .type = ecs_id(MeshData),
         .ptr = &(MeshData) {
-          .data = square_mesh_buffer,
+          .data = square_vertices,
           .vertices_count = 6,
           .primitive = GLI_TRIANGLES,
+          .release = gli_keep_mesh_data,
           .vertex_attributes = {
             { .type = GLI_VEC2 },
             { .type = GLI_FLOAT },
@@ -296,11 +291,12 @@ int main(const int argc, char** argv) {
       {
         .type = ecs_id(MeshData),
         .ptr = &(MeshData) {
-          .data = cube_mesh_buffer,
-          .indices = cube_indices_buffer,
+          .data = cube_vertices,
+          .indices = cube_indices,
           .vertices_count = 24,
           .indices_count = 36,
           .primitive = GLI_TRIANGLES,
+          .release = gli_keep_mesh_data,
           .vertex_attributes = {
             { .type = GLI_VEC3 },
             { .type = GLI_VEC4 },